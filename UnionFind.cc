@@ -0,0 +1,90 @@
+// Growable union-find with path compression over provisional labels.
+// To be used in Computer Vision class.
+
+#include "UnionFind.h"
+#include <cstdlib>
+#include <utility>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+// Roots are the smallest label of their set, so a label's root is
+// always numbered before the label itself.
+template <typename Table>
+uint32_t FlattenTable(Table *table, vector<uint32_t> *relabel) {
+  relabel->assign(table->size() + 1, 0);
+  uint32_t count = 0;
+  for (uint32_t label = 1; label <= table->size(); ++label) {
+    const uint32_t root = table->Find(label);
+    (*relabel)[label] = (root == label) ? ++count : (*relabel)[root];
+  }
+  return count;
+}
+
+}  // namespace
+
+/**
+ * Start over with num_labels singleton sets.
+ */
+void UnionFind::Reset(size_t num_labels) {
+  CV_METRIC(counters_ = UnionFindCounters());
+  parent_.resize(num_labels + 1);
+  for (size_t label = 0; label <= num_labels; ++label)
+    parent_[label] = label;
+}
+
+uint32_t UnionFind::Flatten(vector<uint32_t> *relabel) {
+  if (relabel == nullptr) abort();
+  return FlattenTable(this, relabel);
+}
+
+ConcurrentUnionFind::ConcurrentUnionFind(size_t num_labels)
+    : size_{num_labels}, parent_{new atomic<uint32_t>[num_labels + 1]} {
+  for (size_t label = 0; label <= num_labels; ++label)
+    parent_[label].store(label, memory_order_relaxed);
+}
+
+/**
+ * Perform a find with path halving. Another thread may replace a parent
+ * with a smaller ancestor at any time, which keeps every path valid.
+ */
+uint32_t ConcurrentUnionFind::Find(uint32_t label) {
+  uint32_t parent = parent_[label].load(memory_order_acquire);
+  while (parent != label) {
+    const uint32_t grandparent = parent_[parent].load(memory_order_acquire);
+    if (grandparent != parent)
+      parent_[label].compare_exchange_weak(parent, grandparent,
+                                           memory_order_acq_rel);
+    label = parent;
+    parent = parent_[label].load(memory_order_acquire);
+  }
+  return label;
+}
+
+/**
+ * Union two sets by linking the larger root under the smaller one.
+ * The link only succeeds while that root is still a root; otherwise
+ * another thread got there first and the roots are looked up again.
+ */
+uint32_t ConcurrentUnionFind::Union(uint32_t first, uint32_t second) {
+  while (true) {
+    first = Find(first);
+    second = Find(second);
+    if (first == second) return first;
+    if (first > second) swap(first, second);
+    uint32_t expected = second;
+    if (parent_[second].compare_exchange_strong(expected, first,
+                                                memory_order_acq_rel))
+      return first;
+  }
+}
+
+uint32_t ConcurrentUnionFind::Flatten(vector<uint32_t> *relabel) {
+  if (relabel == nullptr) abort();
+  return FlattenTable(this, relabel);
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,129 @@
+// Growable union-find with path compression over provisional labels.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_UNIONFIND_H_
+#define COMPUTER_VISION_UNIONFIND_H_
+
+#include "metrics.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Equivalence table over provisional labels 1..size(); label 0 is the
+// background and is never joined with anything.
+// Unlike DisjSets it grows as labels are created, compresses paths in
+// Find() and can be flattened into a relabel table in one pass.
+// The root of a set is always its smallest label, so flattening numbers
+// the sets in the order their first label was created.
+// Sample usage:
+//   UnionFind equivalences;
+//   uint32_t a = equivalences.MakeSet(), b = equivalences.MakeSet();
+//   equivalences.Union(a, b);
+//   std::vector<uint32_t> relabel;
+//   equivalences.Flatten(&relabel);  // relabel[a] == relabel[b] == 1
+class UnionFind {
+ public:
+  UnionFind(): parent_(1, 0) { }
+
+  // Starts over with the singleton sets 1..num_labels.
+  void Reset(size_t num_labels);
+  void Reserve(size_t num_labels) { parent_.reserve(num_labels + 1); }
+
+  uint32_t size() const { return parent_.size() - 1; }
+
+  // Creates a new singleton set and returns its label.
+  uint32_t MakeSet() {
+    parent_.push_back(parent_.size());
+    return parent_.size() - 1;
+  }
+
+  // Returns the root of label, halving the path on the way up.
+  uint32_t Find(uint32_t label) {
+    CV_METRIC(uint64_t depth = 0);
+    while (parent_[label] != label) {
+      parent_[label] = parent_[parent_[label]];
+      label = parent_[label];
+      CV_METRIC(++depth);
+    }
+    CV_METRIC(CountFind(depth));
+    return label;
+  }
+
+  // Joins the sets of first and second and returns the new root.
+  uint32_t Union(uint32_t first, uint32_t second) {
+    first = Find(first);
+    second = Find(second);
+    CV_METRIC(if (first != second) ++counters_.unions);
+    if (first < second) {
+      parent_[second] = first;
+      return first;
+    }
+    parent_[first] = second;
+    return second;
+  }
+
+  /**
+   * Flatten( ) numbers the sets 1..count in the order of their smallest
+   * label and fills relabel so that relabel[label] is the number of the
+   * set of label (relabel[0] is 0). A relabel pass over an image is then
+   * one table lookup per pixel instead of a Find( ).
+   *
+   * @param {vector} relabel: the resulting table, size() + 1 entries
+   * @return the number of sets
+   */
+  uint32_t Flatten(std::vector<uint32_t> *relabel);
+
+#ifdef CV_METRICS
+  // Work done since the last Reset( ), Flatten( ) included.
+  UnionFindCounters counters() const {
+    UnionFindCounters counters = counters_;
+    counters.labels = size();
+    return counters;
+  }
+#endif
+
+ private:
+#ifdef CV_METRICS
+  void CountFind(uint64_t depth) {
+    ++counters_.finds;
+    counters_.find_steps += depth;
+    if (depth > counters_.max_find_depth) counters_.max_find_depth = depth;
+  }
+
+  UnionFindCounters counters_;
+#endif
+  std::vector<uint32_t> parent_;
+};
+
+// Lock-free equivalence table of fixed size that several threads can
+// Find( ) and Union( ) on at the same time. Links are made with
+// compare-and-swap from the larger root to the smaller one, so roots are
+// again the smallest label of their set and Flatten( ) numbers sets the
+// same way as UnionFind, once all threads are done.
+class ConcurrentUnionFind {
+ public:
+  explicit ConcurrentUnionFind(size_t num_labels);
+  ConcurrentUnionFind(const ConcurrentUnionFind &a_table) = delete;
+  ConcurrentUnionFind& operator=(const ConcurrentUnionFind &a_table) = delete;
+
+  uint32_t size() const { return size_; }
+
+  uint32_t Find(uint32_t label);
+  uint32_t Union(uint32_t first, uint32_t second);
+
+  // Same as UnionFind::Flatten( ); not safe to run concurrently with
+  // Union( ).
+  uint32_t Flatten(std::vector<uint32_t> *relabel);
+
+ private:
+  size_t size_;
+  std::unique_ptr<std::atomic<uint32_t>[]> parent_;
+};
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_UNIONFIND_H_
@@ -0,0 +1,153 @@
+// Background reading ahead of and writing behind a sequential consumer
+// of images, so that disk and CPU work overlap.
+// To be used in Computer Vision class.
+
+#include "async_io.h"
+#include <chrono>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+double SecondsSince(Clock::time_point start) {
+  return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Asks the kernel to start reading filename into the page cache.
+void AdviseWillNeed(const string &filename) {
+  const int descriptor = open(filename.c_str(), O_RDONLY);
+  if (descriptor < 0) return;
+  posix_fadvise(descriptor, 0, 0, POSIX_FADV_WILLNEED);
+  close(descriptor);
+}
+
+}  // namespace
+
+ImagePrefetcher::ImagePrefetcher(const vector<string> &inputs,
+                                 bool with_histogram, size_t depth)
+    : inputs_(inputs), with_histogram_{with_histogram},
+      slots_(depth == 0 ? 1 : depth) {
+  reader_ = thread(&ImagePrefetcher::ReadLoop, this);
+}
+
+ImagePrefetcher::~ImagePrefetcher() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  reader_.join();
+}
+
+void ImagePrefetcher::ReadLoop() {
+  for (size_t k = 0; k < inputs_.size(); ++k) {
+    {
+      unique_lock<mutex> lock(mutex_);
+      changed_.wait(lock, [this, k] {
+        return stop_ || k - num_taken_ < slots_.size();
+      });
+      if (stop_) return;
+    }
+    if (k + 1 < inputs_.size()) AdviseWillNeed(inputs_[k + 1]);
+    // The slot is the reader's until num_read_ moves past it.
+    Slot &slot = slots_[k % slots_.size()];
+    slot.read = ReadImage(inputs_[k], &slot.image,
+                          with_histogram_ ? &slot.histogram : nullptr);
+    if (!slot.read)
+      cout << "ImagePrefetcher: can't open " << inputs_[k] << endl;
+    {
+      lock_guard<mutex> lock(mutex_);
+      ++num_read_;
+    }
+    changed_.notify_all();
+  }
+}
+
+bool ImagePrefetcher::Next(Image *an_image, GrayHistogram *histogram,
+                           bool *read) {
+  if (an_image == nullptr || read == nullptr) abort();
+  unique_lock<mutex> lock(mutex_);
+  if (num_taken_ == inputs_.size()) return false;
+  const Clock::time_point start = Clock::now();
+  changed_.wait(lock, [this] { return num_read_ > num_taken_; });
+  wait_seconds_ += SecondsSince(start);
+  Slot &slot = slots_[num_taken_ % slots_.size()];
+  an_image->Swap(slot.image);
+  if (histogram != nullptr && with_histogram_) *histogram = slot.histogram;
+  *read = slot.read;
+  ++num_taken_;
+  lock.unlock();
+  changed_.notify_all();
+  return true;
+}
+
+WriteBehindQueue::WriteBehindQueue(size_t depth)
+    : slots_(depth == 0 ? 1 : depth) {
+  writer_ = thread(&WriteBehindQueue::WriteLoop, this);
+}
+
+WriteBehindQueue::~WriteBehindQueue() {
+  Finish();
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  writer_.join();
+}
+
+void WriteBehindQueue::Write(const string &filename, Image *an_image) {
+  if (an_image == nullptr) abort();
+  unique_lock<mutex> lock(mutex_);
+  const Clock::time_point start = Clock::now();
+  changed_.wait(lock, [this] {
+    return num_queued_ - num_written_ < slots_.size();
+  });
+  wait_seconds_ += SecondsSince(start);
+  Slot &slot = slots_[num_queued_ % slots_.size()];
+  slot.filename = filename;
+  slot.image.Swap(*an_image);
+  ++num_queued_;
+  lock.unlock();
+  changed_.notify_all();
+}
+
+bool WriteBehindQueue::Finish() {
+  unique_lock<mutex> lock(mutex_);
+  changed_.wait(lock, [this] { return num_written_ == num_queued_; });
+  return num_failed_ == 0;
+}
+
+void WriteBehindQueue::WriteLoop() {
+  for (;;) {
+    size_t k;
+    {
+      unique_lock<mutex> lock(mutex_);
+      changed_.wait(lock, [this] {
+        return stop_ || num_queued_ > num_written_;
+      });
+      if (num_queued_ == num_written_) return;  // stopped and drained
+      k = num_written_;
+    }
+    // The slot is the writer's until num_written_ moves past it.
+    Slot &slot = slots_[k % slots_.size()];
+    const bool written = WriteImage(slot.filename, slot.image);
+    if (!written)
+      cout << "WriteBehindQueue: can't write " << slot.filename << endl;
+    {
+      lock_guard<mutex> lock(mutex_);
+      if (!written) ++num_failed_;
+      ++num_written_;
+    }
+    changed_.notify_all();
+  }
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,138 @@
+// Background reading ahead of and writing behind a sequential consumer
+// of images, so that disk and CPU work overlap.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_ASYNC_IO_H_
+#define COMPUTER_VISION_ASYNC_IO_H_
+
+#include "histogram.h"
+#include "image.h"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Reads a list of images in order on a background thread, up to depth
+// images ahead of the consumer (two: double buffering). Next( ) hands
+// an image over by swapping buffers, and the buffer it gets back is
+// read into again, so after the first depth images nothing is
+// allocated. The file after the one being read is announced to the
+// kernel with posix_fadvise(WILLNEED) to start its readahead early.
+//
+// Example:
+//   ImagePrefetcher prefetcher(inputs, false);
+//   Image an_image;
+//   bool read;
+//   while (prefetcher.Next(&an_image, nullptr, &read)) if (read) ...
+class ImagePrefetcher {
+ public:
+  // inputs must outlive the prefetcher. With with_histogram the gray
+  // level histogram of each image is gathered while it is read.
+  ImagePrefetcher(const std::vector<std::string> &inputs,
+                  bool with_histogram, size_t depth = 2);
+  ~ImagePrefetcher();
+
+  ImagePrefetcher(const ImagePrefetcher &) = delete;
+  ImagePrefetcher &operator=(const ImagePrefetcher &) = delete;
+
+  /**
+   * Next( ) waits for the next image of the list.
+   *
+   * @param {Image} an_image: receives the image; its old buffer goes
+   *                back to the prefetcher
+   * @param {GrayHistogram} histogram: receives the histogram when the
+   *                        prefetcher gathers them, may be null
+   * @param {bool} read: false when the image could not be read
+   * @return false once every image of the list has been handed over
+   */
+  bool Next(Image *an_image, GrayHistogram *histogram, bool *read);
+
+  // Time Next( ) spent waiting for reads, i.e. the I/O not hidden.
+  double wait_seconds() const { return wait_seconds_; }
+
+ private:
+  struct Slot {
+    Image image;
+    GrayHistogram histogram;
+    bool read = false;
+  };
+
+  void ReadLoop();
+
+  const std::vector<std::string> &inputs_;
+  const bool with_histogram_;
+  std::vector<Slot> slots_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  // Images read so far and images handed over so far.
+  size_t num_read_ = 0;
+  size_t num_taken_ = 0;
+  bool stop_ = false;
+  double wait_seconds_ = 0;
+  std::thread reader_;
+};
+
+// Writes images on a background thread, in the order they are queued.
+// Write( ) swaps the image into one of depth slots and returns at once
+// unless all slots are still being written; the caller gets an earlier
+// buffer back, and images are written without a copy (see FilePgmSink
+// in pgm_io.h), so a steady stream of same-sized images allocates
+// nothing.
+//
+// Example:
+//   WriteBehindQueue writer;
+//   writer.Write("out_1.pgm", &an_image);  // an_image is now scratch
+//   ...
+//   if (!writer.Finish()) ...
+class WriteBehindQueue {
+ public:
+  explicit WriteBehindQueue(size_t depth = 2);
+  // Waits for the queued writes.
+  ~WriteBehindQueue();
+
+  WriteBehindQueue(const WriteBehindQueue &) = delete;
+  WriteBehindQueue &operator=(const WriteBehindQueue &) = delete;
+
+  /**
+   * Write( ) queues an_image to be written to filename.
+   *
+   * @param {string} filename: output file
+   * @param {Image} an_image: the image; receives a recycled buffer of
+   *                unspecified size and contents
+   */
+  void Write(const std::string &filename, Image *an_image);
+
+  // Waits for every queued write. Returns false when any one failed.
+  bool Finish();
+
+  size_t num_failed() const { return num_failed_; }
+  // Time Write( ) spent waiting for a free slot.
+  double wait_seconds() const { return wait_seconds_; }
+
+ private:
+  struct Slot {
+    std::string filename;
+    Image image;
+  };
+
+  void WriteLoop();
+
+  std::vector<Slot> slots_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  // Images queued so far and images written so far.
+  size_t num_queued_ = 0;
+  size_t num_written_ = 0;
+  size_t num_failed_ = 0;
+  bool stop_ = false;
+  double wait_seconds_ = 0;
+  std::thread writer_;
+};
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_ASYNC_IO_H_
@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Title          : batch.cc
+ * Description    : recognizes the objects of every image of a directory
+ *                  (its .pgm files) or of a file list, on a pool of
+ *                  worker threads, and writes the records of all the
+ *                  objects found to one file: image, object, center,
+ *                  minimum moment of inertia, orientation, roundness,
+ *                  area, bounding box aspect, matched model, distance.
+ *                  With an output directory the overlay of each image
+ *                  is written there, as the pipeline program would.
+ *                  With one thread, reading the next image and writing
+ *                  the previous overlay overlap the processing
+ * Purpose        : 
+ * Usage          : ./batch frames/ 125 two_objects_database.txt
+ *                           records.txt [overlay directory] [threads]
+ * Build with     : make all
+ */
+#include "batch_recognition.h"
+#include "histogram.h"
+#include "model_database.h"
+#include "recognition_pipeline.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace ComputerVisionProjects;
+
+int main(int argc, char **argv){  
+  if (argc < 5 || argc > 7) {
+    printf("Usage: %s {input directory | input file list} {input gray–level threshold | auto | otsu | triangle} {input database} {output records} [output directory] [threads]\n", argv[0]);
+    return 0;
+  }
+  const string input_path(argv[1]);
+  const string value(argv[2]);
+  const string input_database(argv[3]);
+  const string output_records(argv[4]);
+
+  PipelineOptions options;
+  options.automatic_threshold =
+      ParseThresholdMethod(value, &options.threshold_method);
+  if (!options.automatic_threshold)
+    options.threshold_value = stoi(value);  // convert string to int
+  BatchOptions batch_options;
+  if (argc > 5) batch_options.output_directory = argv[5];
+  if (argc > 6) batch_options.num_threads = stoi(argv[6]);
+
+  vector<string> inputs;
+  if (!ListBatchInputs(input_path, &inputs)) return 0;
+
+  ModelDatabase database;
+  if (!LoadModelDatabase(input_database, &database)) {
+    cout << "Can't read database " << input_database << endl;
+    return 0;
+  }
+
+  ofstream records(output_records);
+  if (records.fail()) {
+    cout << "Can't write " << output_records << endl;
+    return 0;
+  }
+
+  RecognitionPipeline pipeline(options);
+  pipeline.SetModels(database);
+  BatchStats stats;
+  if (!RunBatch(pipeline, database, inputs, batch_options, records, &stats))
+    return 0;
+
+  cout << stats.images << " images (" << stats.failed << " failed), "
+       << stats.objects << " objects, " << stats.matched << " matched in "
+       << stats.seconds << " s";
+  if (stats.seconds > 0)
+    cout << ", " << stats.images / stats.seconds << " images/s";
+  cout << endl;
+  if (stats.io_wait_seconds > 0)
+    cout << "waited " << stats.io_wait_seconds << " s for I/O" << endl;
+}
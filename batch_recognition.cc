@@ -0,0 +1,266 @@
+// Recognition of many images on a work-stealing thread pool, with the
+// records of every object written to one output.
+// To be used in Computer Vision class.
+
+#include "batch_recognition.h"
+#include "async_io.h"
+#include "metrics.h"
+#include "parallel.h"
+#include "work_stealing_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+const char kBatchRecordHeader[] =
+    "image | object | row position of the center | column position of the "
+    "center | minimum moment of inertia | orientation | roundness | area | "
+    "bounding box aspect | matched model | distance";
+
+namespace {
+
+// Images per worker between two flushes of the records. Enough for
+// stealing to even out uneven frames, few enough to bound the records
+// kept in memory.
+const size_t kFramesPerWorker = 32;
+
+// Everything a worker reuses from one image to the next.
+struct BatchWorker {
+  Image image;
+  GrayHistogram histogram;
+  PipelineResult result;
+  RasterScanWorkspace workspace;
+  string output_name;
+  BatchStats stats;
+};
+
+bool EndsWith(const string &name, const string &suffix) {
+  return name.size() >= suffix.size() &&
+         name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Appends the records of the objects of one image to text.
+void AppendRecords(const string &input, const PipelineResult &result,
+                   const ModelDatabase &database, string *text) {
+  const InertiaBatch &batch = result.inertia;
+  char line[256];
+  for (size_t i = 1; i < batch.size(); ++i) {
+    const vector<ObjectMatch> &matches = result.matches[i];
+    const int model =
+        matches.empty() ? -1 : database.models[matches[0].model].label;
+    const double distance = matches.empty() ? 0 : matches[0].distance;
+    snprintf(line, sizeof line, " %zu %g %g %g %g %g %lld %g %d %g\n", i,
+             batch.row_center[i], batch.column_center[i],
+             batch.min_inertia[i],
+             InertiaOrientation(batch.a[i], batch.b[i], batch.c[i]),
+             Roundness(batch, i),
+             static_cast<long long>(result.objects[i].moments.area),
+             BoundingBoxAspect(result.objects[i]), model, distance);
+    text->append(input);
+    text->append(line);
+  }
+}
+
+// Name of the overlay of input in the output directory, into name.
+void OutputName(const BatchOptions &options, const string &input,
+                string *name) {
+  *name = options.output_directory;
+  *name += '/';
+  name->append(input, input.find_last_of('/') + 1, string::npos);
+}
+
+// Counts the objects of an image that went through the pipeline and
+// appends their records to text.
+void FinishImage(const ModelDatabase &database, const string &input,
+                 const PipelineResult &result, BatchStats *stats,
+                 string *text) {
+  for (size_t i = 1; i < result.matches.size(); ++i) {
+    ++stats->objects;
+    if (!result.matches[i].empty()) ++stats->matched;
+  }
+  AppendRecords(input, result, database, text);
+}
+
+// Runs the pipeline on one image, leaving its records in text.
+void ProcessImage(const RecognitionPipeline &pipeline,
+                  const ModelDatabase &database, const string &input,
+                  const BatchOptions &options, BatchWorker *worker,
+                  string *text) {
+  ScopedFrameMetrics frame_metrics(input);
+  text->clear();
+  ++worker->stats.images;
+  const bool automatic = pipeline.options().automatic_threshold;
+  GrayHistogram *histogram = automatic ? &worker->histogram : nullptr;
+  if (!ReadImage(input, &worker->image, histogram)) {
+    cout << "RunBatch: can't open " << input << endl;
+    ++worker->stats.failed;
+    return;
+  }
+  if (!pipeline.Run(&worker->image, histogram, &worker->result,
+                    &worker->workspace)) {
+    ++worker->stats.failed;
+    return;
+  }
+  if (!options.output_directory.empty()) {
+    OutputName(options, input, &worker->output_name);
+    if (!WriteImage(worker->output_name, worker->image)) {
+      cout << "RunBatch: can't write " << worker->output_name << endl;
+      ++worker->stats.failed;
+      return;
+    }
+  }
+  FinishImage(database, input, worker->result, &worker->stats, text);
+}
+
+// RunBatch( ) on the calling thread alone: the next image is read and
+// the previous overlay written in the background while one is processed.
+bool RunSequentialBatch(const RecognitionPipeline &pipeline,
+                        const ModelDatabase &database,
+                        const vector<string> &inputs,
+                        const BatchOptions &options, ostream &records,
+                        BatchStats *stats) {
+  const bool automatic = pipeline.options().automatic_threshold;
+  BatchWorker worker;
+  string text;
+  {
+    ImagePrefetcher prefetcher(inputs, automatic);
+    WriteBehindQueue writer;
+    bool read;
+    for (size_t k = 0; k < inputs.size(); ++k) {
+      ScopedFrameMetrics frame_metrics(inputs[k]);
+      {
+        // the read happened in the background; the frame is charged
+        // with the time it waited for it
+        CV_METRIC_STAGE(kMetricRead);
+        if (!prefetcher.Next(&worker.image, &worker.histogram, &read)) break;
+      }
+      ++worker.stats.images;
+      if (!read || !pipeline.Run(&worker.image,
+                                 automatic ? &worker.histogram : nullptr,
+                                 &worker.result, &worker.workspace)) {
+        ++worker.stats.failed;
+        continue;
+      }
+      if (!options.output_directory.empty()) {
+        OutputName(options, inputs[k], &worker.output_name);
+        CV_METRIC_STAGE(kMetricWrite);
+        writer.Write(worker.output_name, &worker.image);
+      }
+      text.clear();
+      FinishImage(database, inputs[k], worker.result, &worker.stats, &text);
+      records.write(text.data(), text.size());
+    }
+    writer.Finish();
+    worker.stats.failed += writer.num_failed();
+    worker.stats.io_wait_seconds =
+        prefetcher.wait_seconds() + writer.wait_seconds();
+  }
+  *stats = worker.stats;
+  return static_cast<bool>(records);
+}
+
+}  // namespace
+
+void BatchStats::Add(const BatchStats &other) {
+  images += other.images;
+  failed += other.failed;
+  objects += other.objects;
+  matched += other.matched;
+  io_wait_seconds += other.io_wait_seconds;
+}
+
+bool ListBatchInputs(const string &path, vector<string> *inputs) {
+  if (inputs == nullptr) abort();
+  inputs->clear();
+  struct stat status;
+  if (stat(path.c_str(), &status) == 0 && S_ISDIR(status.st_mode)) {
+    DIR *directory = opendir(path.c_str());
+    if (directory == nullptr) {
+      cout << "ListBatchInputs: can't open directory " << path << endl;
+      return false;
+    }
+    while (const dirent *entry = readdir(directory)) {
+      const string name(entry->d_name);
+      if (EndsWith(name, ".pgm")) inputs->push_back(path + "/" + name);
+    }
+    closedir(directory);
+    sort(inputs->begin(), inputs->end());
+    return true;
+  }
+  ifstream list(path);
+  if (list.fail()) {
+    cout << "ListBatchInputs: can't open " << path << endl;
+    return false;
+  }
+  string line;
+  while (getline(list, line))
+    if (!line.empty()) inputs->push_back(line);
+  return true;
+}
+
+bool RunBatch(const RecognitionPipeline &pipeline,
+              const ModelDatabase &database, const vector<string> &inputs,
+              const BatchOptions &options, ostream &records,
+              BatchStats *stats) {
+  if (stats == nullptr) abort();
+  const auto start = chrono::steady_clock::now();
+  const size_t num_threads =
+      options.num_threads == 0 ? DefaultThreadCount() : options.num_threads;
+  if (num_threads == 1) {
+    records << kBatchRecordHeader << endl;
+    const bool written =
+        RunSequentialBatch(pipeline, database, inputs, options, records,
+                           stats) && records.flush();
+    if (!written) {
+      cout << "RunBatch: can't write the records" << endl;
+      return false;
+    }
+    stats->seconds = chrono::duration<double>(chrono::steady_clock::now() -
+                                              start).count();
+    return true;
+  }
+  WorkStealingPool pool(num_threads);
+  vector<unique_ptr<BatchWorker>> workers(pool.num_threads());
+  for (unique_ptr<BatchWorker> &worker : workers)
+    worker.reset(new BatchWorker);
+
+  // Records of the images of the current window, flushed in input order
+  // once the whole window is done. The strings keep their capacity.
+  const size_t window = kFramesPerWorker * pool.num_threads();
+  vector<string> texts(min(window, inputs.size()));
+
+  records << kBatchRecordHeader << endl;
+  bool written = static_cast<bool>(records);
+  for (size_t first = 0; first < inputs.size() && written; first += window) {
+    const size_t count = min(window, inputs.size() - first);
+    pool.Run(count, [&](size_t worker, size_t task) {
+      ProcessImage(pipeline, database, inputs[first + task], options,
+                   workers[worker].get(), &texts[task]);
+    });
+    for (size_t task = 0; task < count; ++task)
+      records.write(texts[task].data(), texts[task].size());
+    written = static_cast<bool>(records);
+  }
+  records.flush();
+  if (!records) {
+    cout << "RunBatch: can't write the records" << endl;
+    return false;
+  }
+
+  *stats = BatchStats();
+  for (const unique_ptr<BatchWorker> &worker : workers)
+    stats->Add(worker->stats);
+  stats->seconds = chrono::duration<double>(chrono::steady_clock::now() -
+                                            start).count();
+  return true;
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,83 @@
+// Recognition of many images on a work-stealing thread pool, with the
+// records of every object written to one output.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_BATCH_RECOGNITION_H_
+#define COMPUTER_VISION_BATCH_RECOGNITION_H_
+
+#include "model_database.h"
+#include "recognition_pipeline.h"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Header line of the records RunBatch( ) writes, one line per object.
+extern const char kBatchRecordHeader[];
+
+/**
+ * ListBatchInputs( ) lists the images of a batch: the .pgm files of a
+ * directory in name order, or the lines of a file list.
+ *
+ * @param {string} path: a directory, or a file with one image per line
+ * @param {vector} inputs: the image filenames
+ * @return false (with a message) when path cannot be read
+ */
+bool ListBatchInputs(const std::string &path, std::vector<std::string> *inputs);
+
+struct BatchOptions {
+  // Zero means DefaultThreadCount( ).
+  size_t num_threads = 0;
+  // When not empty, the overlay of each image is written there under
+  // the name of the image.
+  std::string output_directory;
+};
+
+struct BatchStats {
+  size_t images = 0;
+  // Images that could not be read or written.
+  size_t failed = 0;
+  size_t objects = 0;
+  // Objects that matched at least one model.
+  size_t matched = 0;
+  double seconds = 0;
+  // Time the processing thread of a sequential batch waited for reads
+  // and queued writes: the I/O the background threads did not hide.
+  double io_wait_seconds = 0;
+
+  void Add(const BatchStats &other);
+};
+
+/**
+ * RunBatch( ) recognizes every image of inputs with pipeline. Images are
+ * spread over a WorkStealingPool; each worker keeps its own image,
+ * labeling workspace and result, so once they have grown to the largest
+ * frame seen, labeling, measuring, matching and writing the overlay
+ * allocate nothing.
+ * With a single thread the images are instead processed in order while
+ * an ImagePrefetcher reads the next one and a WriteBehindQueue writes
+ * the previous overlay, so that I/O overlaps the computation.
+ * Records are written in the order of inputs, whatever the order the
+ * images complete in: "image object row column min_inertia orientation
+ * roundness area aspect model distance", with model -1 and distance 0
+ * for objects that match nothing.
+ *
+ * @param {RecognitionPipeline} pipeline: pipeline with its models set
+ * @param {ModelDatabase} database: the models, for their labels
+ * @param {vector} inputs: image filenames
+ * @param {BatchOptions} options: threads and overlay output
+ * @param {ostream} records: receives kBatchRecordHeader and the records
+ * @param {BatchStats} stats: counts and wall-clock time of the batch
+ * @return false (with a message) when records cannot be written
+ */
+bool RunBatch(const RecognitionPipeline &pipeline,
+              const ModelDatabase &database,
+              const std::vector<std::string> &inputs,
+              const BatchOptions &options, std::ostream &records,
+              BatchStats *stats);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_BATCH_RECOGNITION_H_
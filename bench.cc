@@ -0,0 +1,267 @@
+/******************************************************************************
+ * Title          : bench.cc
+ * Description    : generates a synthetic gray-level scene and times every
+ *                  stage of the recognition chain on it, and every
+ *                  alternative engine of a stage: reading, thresholding,
+ *                  labeling, attributes, matching, writing and the whole
+ *                  pipeline. Each stage runs once to warm up and then
+ *                  the given number of times; the median and the fastest
+ *                  run are reported with the throughput in megapixels
+ *                  and objects per second. Inputs are prepared outside
+ *                  the timed region. format=json writes one JSON object
+ *                  per stage per line, for diffing between builds
+ * Purpose        : 
+ * Usage          : ./bench rows=1080 columns=1920 objects=200
+ *                          shape=mixed noise=8 runs=20 format=json
+ *                  keys: rows columns objects shape (ellipse | rectangle
+ *                  | mixed) min_size max_size density noise seed margin
+ *                  runs threshold format (text | json) scene output
+ * Build with     : make bench
+ */
+#include "image.h"
+#include "binary_mask.h"
+#include "frame_arena.h"
+#include "histogram.h"
+#include "labeling_kernels.h"
+#include "labeling_workspace.h"
+#include "object_matcher.h"
+#include "object_moments.h"
+#include "overlay.h"
+#include "parallel_labeling.h"
+#include "recognition_pipeline.h"
+#include "run_labeling.h"
+#include "scene_generator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace ComputerVisionProjects;
+
+namespace {
+
+struct StageTiming {
+  string stage;
+  double median_seconds;
+  double min_seconds;
+};
+
+// Runs setup and then work, once to warm up and num_runs more times;
+// only work is timed.
+StageTiming TimeStage(const string &stage, size_t num_runs,
+                      const function<void()> &setup,
+                      const function<void()> &work) {
+  vector<double> seconds;
+  for (size_t run = 0; run <= num_runs; ++run) {
+    setup();
+    const auto start = chrono::steady_clock::now();
+    work();
+    const chrono::duration<double> elapsed =
+        chrono::steady_clock::now() - start;
+    if (run > 0) seconds.push_back(elapsed.count());
+  }
+  sort(seconds.begin(), seconds.end());
+  return {stage, seconds[seconds.size() / 2], seconds.front()};
+}
+
+}  // namespace
+
+int main(int argc, char **argv){  
+  map<string, string> arguments;
+  for (int k = 1; k < argc; ++k) {
+    const string argument(argv[k]);
+    const size_t equals = argument.find('=');
+    if (equals == string::npos) {
+      printf("Usage: %s [rows=480] [columns=640] [objects=20] [shape=ellipse | rectangle | mixed] [min_size=8] [max_size=40] [density=0] [noise=0] [seed=1] [margin=50] [runs=10] [threshold=125] [format=text | json] [scene=bench_scene.pgm] [output=bench_out.pgm]\n", argv[0]);
+      return 0;
+    }
+    arguments[argument.substr(0, equals)] = argument.substr(equals + 1);
+  }
+  auto value = [&arguments](const string &key, const string &fallback) {
+    auto found = arguments.find(key);
+    return found == arguments.end() ? fallback : found->second;
+  };
+
+  SceneOptions scene;
+  scene.num_rows = stoul(value("rows", "480"));
+  scene.num_columns = stoul(value("columns", "640"));
+  scene.num_objects = stoul(value("objects", "20"));
+  scene.min_size = stod(value("min_size", "8"));
+  scene.max_size = stod(value("max_size", "40"));
+  scene.density = stod(value("density", "0"));
+  scene.noise = stod(value("noise", "0"));
+  scene.seed = stoul(value("seed", "1"));
+  // The orientation lines p3 and p4 draw are 50 pixels long and must
+  // stay within the image.
+  scene.margin = stoul(value("margin", "50"));
+  const string shape_name = value("shape", "ellipse");
+  if (!ParseSceneShape(shape_name, &scene.shape)) {
+    cout << "Unknown shape " << shape_name << endl;
+    return 0;
+  }
+  const size_t num_runs = max<size_t>(1, stoul(value("runs", "10")));
+  const int threshold_value = stoi(value("threshold", "125"));
+  const bool json = value("format", "text") == "json";
+  const string scene_file = value("scene", "bench_scene.pgm");
+  const string output_file = value("output", "bench_out.pgm");
+
+  Image gray;
+  const size_t num_placed = GenerateScene(scene, &gray);
+  if (!WriteImage(scene_file, gray)) {
+    cout << "Can't write scene " << scene_file << endl;
+    return 0;
+  }
+
+  // Reference results each stage starts from.
+  Image binary(gray);
+  ConvertToBinary(threshold_value, &binary);
+  BinaryMask mask;
+  ThresholdToMask(gray, threshold_value, &mask);
+  Image labels(binary);
+  RasterScan(&labels);
+  const size_t num_objects = labels.num_gray_levels();
+  ostringstream attributes;
+  {
+    Image attributes_image(labels);
+    ComputeObjectAttributes(attributes, &attributes_image);
+  }
+  // The scene is its own model database, so every object is matched.
+  const string database_text = attributes.str();
+  vector<ModelRecord> models;
+  {
+    istringstream database_file(database_text);
+    ReadObjectDatabase(database_file, &models);
+  }
+  ObjectIndex index;
+  index.Build(models, MatchOptions());
+  CascadeMatcher matcher;
+  matcher.Build(models, CascadeOptions());
+  ModelDatabase database;
+  database.models = models;
+  database.tree_order = ObjectIndex::TreeOrder(models);
+  database.area_order = CascadeMatcher::AreaOrder(models);
+  PipelineOptions pipeline_options;
+  pipeline_options.threshold_value = threshold_value;
+  RecognitionPipeline pipeline(pipeline_options);
+  pipeline.SetModels(database);
+
+  // Buffers reused across runs, as the batch paths do.
+  Image work;
+  Image overlay;
+  GrayHistogram histogram;
+  ComputeHistogram(gray, &histogram);
+  BinaryMask work_mask;
+  vector<ObjectFeatures> objects;
+  RasterScanWorkspace workspace;
+  FrameArena arena;
+  InertiaBatch inertia;
+  MeasureOptions measure;
+  measure.features = MomentFeatures::kSecondMoments | MomentFeatures::kBoundingBox;
+  vector<vector<ObjectMatch>> matches;
+  CascadeCounters counters;
+  PipelineResult result;
+  ostringstream sink;
+  istringstream database_file;
+
+  auto none = [] { };
+  // Copy assignment keeps the buffer of work across runs.
+  auto copy_gray = [&] { work = gray; };
+  auto copy_binary = [&] { work = binary; };
+  auto copy_labels = [&] { work = labels; };
+  vector<StageTiming> timings;
+  auto add = [&](const string &stage, const function<void()> &setup,
+                 const function<void()> &run) {
+    timings.push_back(TimeStage(stage, num_runs, setup, run));
+  };
+
+  add("read", none, [&] { ReadImage(scene_file, &work); });
+  add("read_histogram", none,
+      [&] { ReadImage(scene_file, &work, &histogram); });
+  add("histogram", none, [&] { ComputeHistogram(gray, &histogram); });
+  add("otsu", none,
+      [&] { SelectThreshold(histogram, ThresholdMethod::kOtsu); });
+  add("threshold", copy_gray,
+      [&] { ConvertToBinary(threshold_value, &work); });
+  add(string("threshold_mask_") + ThresholdKernelName(), none,
+      [&] { ThresholdToMask(gray, threshold_value, &work_mask); });
+  add("raster_scan", copy_binary, [&] { RasterScan(&work); });
+  add("raster_scan_fused", copy_binary,
+      [&] { RasterScan(&work, &objects, &workspace); });
+  add("run_length", copy_binary, [&] { RunLengthLabeling(&work); });
+  add("run_length_arena", copy_binary,
+      [&] { RunLengthLabeling(&work, &arena.runs, &arena.labeling); });
+  add("parallel_raster_scan", copy_binary,
+      [&] { ParallelRasterScan(&work); });
+  for (const string engine : {"pixel4", "pixel8", "block"}) {
+    LabelingMode mode;
+    ParseLabelingMode(engine, &mode);
+    add("label_" + engine, none,
+        [&, mode] { LabelBinaryImage(binary, mode, &work); });
+    add("label_" + engine + "_mask", none,
+        [&, mode] { LabelBinaryImage(mask, mode, &work); });
+  }
+  add("compute_attributes", [&] { copy_labels(); sink.str(""); },
+      [&] { ComputeObjectAttributes(sink, &work); });
+  add("compute_attributes_arena", [&] { copy_labels(); sink.str(""); },
+      [&] { ComputeObjectAttributes(sink, &work, &arena); });
+  add("measure_objects", none,
+      [&] { MeasureObjects(labels, measure, &objects); });
+  add(string("inertia_") + InertiaKernelName(), none, [&] {
+    LoadInertiaBatch(objects, &inertia);
+    ComputeInertia(&inertia, true);
+  });
+  add("compare_stream", [&] {
+        copy_labels();
+        database_file.clear();
+        database_file.str(database_text);
+      },
+      [&] { CompareObjectAttributes(database_file, &work); });
+  add("compare_index", copy_labels,
+      [&] { CompareObjectAttributes(index, &work, &matches); });
+  add("compare_index_arena", copy_labels,
+      [&] { CompareObjectAttributes(index, &work, &matches, &arena); });
+  add("compare_cascade", copy_labels, [&] {
+    CompareObjectAttributes(matcher, &work, &matches, &counters);
+  });
+  add("annotate", [&] { ResetOverlayPlane(labels, &overlay); }, [&] {
+    arena.annotations.Clear();
+    AnnotateObjects(objects, 255, &arena.annotations);
+    arena.annotations.Render(&overlay);
+  });
+  add("write", none, [&] { WriteImage(output_file, labels); });
+  add("write_overlay", none,
+      [&] { WriteImage(output_file, labels, overlay); });
+  add("pipeline", copy_gray,
+      [&] { pipeline.Run(&work, nullptr, &result, &workspace); });
+
+  const double megapixels = scene.num_rows * scene.num_columns / 1e6;
+  if (!json) {
+    printf("scene %zux%zu, %zu objects placed, %zu labeled, %zu runs\n",
+           scene.num_rows, scene.num_columns, num_placed, num_objects,
+           num_runs);
+    printf("%-28s %12s %12s %10s %14s\n", "stage", "median ms", "min ms",
+           "MP/s", "objects/s");
+  }
+  for (const StageTiming &timing : timings) {
+    const double seconds = max(timing.median_seconds, 1e-9);
+    if (json)
+      printf("{\"stage\":\"%s\",\"rows\":%zu,\"columns\":%zu,"
+             "\"objects\":%zu,\"noise\":%g,\"runs\":%zu,"
+             "\"median_ms\":%.4f,\"min_ms\":%.4f,"
+             "\"megapixels_per_second\":%.2f,\"objects_per_second\":%.0f}\n",
+             timing.stage.c_str(), scene.num_rows, scene.num_columns,
+             num_objects, scene.noise, num_runs,
+             1e3 * timing.median_seconds, 1e3 * timing.min_seconds,
+             megapixels / seconds, num_objects / seconds);
+    else
+      printf("%-28s %12.4f %12.4f %10.2f %14.0f\n", timing.stage.c_str(),
+             1e3 * timing.median_seconds, 1e3 * timing.min_seconds,
+             megapixels / seconds, num_objects / seconds);
+  }
+}
@@ -0,0 +1,259 @@
+// Bit-packed binary images and the thresholding kernel producing them.
+// To be used in Computer Vision class.
+
+#include "binary_mask.h"
+#include "metrics.h"
+#include "pgm_io.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COMPUTER_VISION_HAVE_X86_KERNELS 1
+#endif
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+// Thresholds the first num_columns pixels of row into words.
+// A pixel is foreground when it is >= lower_bound (threshold + 1).
+typedef void (*ThresholdRowKernel)(const uint8_t *row, size_t num_columns,
+                                   uint8_t lower_bound, uint64_t *words);
+
+void ThresholdTail(const uint8_t *row, size_t first, size_t num_columns,
+                   uint8_t lower_bound, uint64_t *words) {
+  for (size_t j = first; j < num_columns; j += BinaryMask::kBitsPerWord) {
+    const size_t end = min(j + BinaryMask::kBitsPerWord, num_columns);
+    uint64_t word = 0;
+    for (size_t k = j; k < end; ++k)
+      word |= static_cast<uint64_t>(row[k] >= lower_bound) << (k - j);
+    words[j / BinaryMask::kBitsPerWord] = word;
+  }
+}
+
+void ThresholdRowScalar(const uint8_t *row, size_t num_columns,
+                        uint8_t lower_bound, uint64_t *words) {
+  ThresholdTail(row, 0, num_columns, lower_bound, words);
+}
+
+#ifdef COMPUTER_VISION_HAVE_X86_KERNELS
+
+// max(x, bound) == x exactly when x >= bound, for unsigned bytes.
+__attribute__((target("sse2")))
+void ThresholdRowSse2(const uint8_t *row, size_t num_columns,
+                      uint8_t lower_bound, uint64_t *words) {
+  const __m128i bound = _mm_set1_epi8(static_cast<char>(lower_bound));
+  const size_t full = num_columns / BinaryMask::kBitsPerWord;
+  for (size_t w = 0; w < full; ++w) {
+    const uint8_t *pixels = row + w * BinaryMask::kBitsPerWord;
+    uint64_t word = 0;
+    for (int part = 0; part < 4; ++part) {
+      const __m128i x = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(pixels + 16 * part));
+      const __m128i above = _mm_cmpeq_epi8(_mm_max_epu8(x, bound), x);
+      word |= static_cast<uint64_t>(
+                  static_cast<uint16_t>(_mm_movemask_epi8(above)))
+              << (16 * part);
+    }
+    words[w] = word;
+  }
+  ThresholdTail(row, full * BinaryMask::kBitsPerWord, num_columns,
+                lower_bound, words);
+}
+
+__attribute__((target("avx2")))
+void ThresholdRowAvx2(const uint8_t *row, size_t num_columns,
+                      uint8_t lower_bound, uint64_t *words) {
+  const __m256i bound = _mm256_set1_epi8(static_cast<char>(lower_bound));
+  const size_t full = num_columns / BinaryMask::kBitsPerWord;
+  for (size_t w = 0; w < full; ++w) {
+    const uint8_t *pixels = row + w * BinaryMask::kBitsPerWord;
+    const __m256i low = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(pixels));
+    const __m256i high = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(pixels + 32));
+    const uint32_t low_bits = _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_max_epu8(low, bound), low));
+    const uint32_t high_bits = _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_max_epu8(high, bound), high));
+    words[w] = low_bits | (static_cast<uint64_t>(high_bits) << 32);
+  }
+  ThresholdTail(row, full * BinaryMask::kBitsPerWord, num_columns,
+                lower_bound, words);
+}
+
+#endif  // COMPUTER_VISION_HAVE_X86_KERNELS
+
+struct ThresholdKernel {
+  ThresholdRowKernel row_kernel;
+  const char *name;
+};
+
+const ThresholdKernel &SelectedKernel() {
+  static const ThresholdKernel kernel = []() -> ThresholdKernel {
+#ifdef COMPUTER_VISION_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {ThresholdRowAvx2, "avx2"};
+    if (__builtin_cpu_supports("sse2")) return {ThresholdRowSse2, "sse2"};
+#endif
+    return {ThresholdRowScalar, "scalar"};
+  }();
+  return kernel;
+}
+
+// PBM stores the leftmost pixel in the most significant bit of a byte,
+// the mask in the least significant one.
+unsigned char ReverseBits(unsigned char byte) {
+  static const struct ReverseTable {
+    unsigned char values[256];
+    ReverseTable() {
+      for (int i = 0; i < 256; ++i) {
+        unsigned char reversed = 0;
+        for (int bit = 0; bit < 8; ++bit)
+          if (i & (1 << bit)) reversed |= 0x80 >> bit;
+        values[i] = reversed;
+      }
+    }
+  } table;
+  return table.values[byte];
+}
+
+}  // namespace
+
+void BinaryMask::AllocateSpaceAndSetSize(size_t num_rows,
+                                         size_t num_columns) {
+  num_rows_ = num_rows;
+  num_columns_ = num_columns;
+  words_per_row_ = (num_columns + kBitsPerWord - 1) / kBitsPerWord;
+  words_.assign(num_rows_ * words_per_row_, 0);
+}
+
+void ThresholdToMask(const ImagePlane<const uint8_t> &plane,
+                     int threshold_value, BinaryMask *mask) {
+  if (mask == nullptr) abort();
+  CV_METRIC_STAGE(kMetricThreshold);
+  mask->AllocateSpaceAndSetSize(plane.num_rows(), plane.num_columns());
+  // Everything or nothing is above thresholds outside the byte range.
+  if (threshold_value >= 255) return;
+  if (threshold_value < 0) {
+    for (size_t i = 0; i < plane.num_rows(); ++i)
+      ThresholdTail(plane.Row(i), 0, plane.num_columns(), 0, mask->Row(i));
+    return;
+  }
+  const ThresholdRowKernel kernel = SelectedKernel().row_kernel;
+  const uint8_t lower_bound = static_cast<uint8_t>(threshold_value + 1);
+  for (size_t i = 0; i < plane.num_rows(); ++i)
+    kernel(plane.Row(i), plane.num_columns(), lower_bound, mask->Row(i));
+}
+
+void ThresholdToMask(const Image &an_image, int threshold_value,
+                     BinaryMask *mask) {
+  if (mask == nullptr) abort();
+  if (an_image.depth() == PixelDepth::kUint8) {
+    ThresholdToMask(an_image.Plane<uint8_t>(), threshold_value, mask);
+    return;
+  }
+  CV_METRIC_STAGE(kMetricThreshold);
+  mask->AllocateSpaceAndSetSize(an_image.num_rows(), an_image.num_columns());
+  VisitPlane(an_image, [threshold_value, mask](auto plane) {
+    for (size_t i = 0; i < plane.num_rows(); ++i) {
+      const auto row = plane.Span(i);
+      for (size_t j = 0; j < row.size(); ++j)
+        if (static_cast<int64_t>(row[j]) > threshold_value)
+          mask->SetPixel(i, j, true);
+    }
+  });
+}
+
+const char *ThresholdKernelName() {
+  return SelectedKernel().name;
+}
+
+void MaskToImage(const BinaryMask &mask, Image *an_image) {
+  if (an_image == nullptr) abort();
+  an_image->AllocateSpaceAndSetSize(mask.num_rows(), mask.num_columns(),
+                                    PixelDepth::kUint8);
+  an_image->SetNumberGrayLevels(1);
+  ImagePlane<uint8_t> plane = an_image->Plane<uint8_t>();
+  for (size_t i = 0; i < mask.num_rows(); ++i) {
+    const uint64_t *words = mask.Row(i);
+    uint8_t *row = plane.Row(i);
+    for (size_t j = 0; j < mask.num_columns(); ++j)
+      row[j] = (words[j / BinaryMask::kBitsPerWord] >>
+                (j % BinaryMask::kBitsPerWord)) & 1;
+  }
+}
+
+bool EncodePbm(const BinaryMask &mask, PgmSink *sink) {
+  if (sink == nullptr) abort();
+  const size_t row_bytes = (mask.num_columns() + 7) / 8;
+  char header[64];
+  const int header_size = snprintf(header, sizeof header, "P4\n#\n%zu %zu\n",
+                                   mask.num_columns(), mask.num_rows());
+  if (!sink->Reserve(header_size + mask.num_rows() * row_bytes) ||
+      !sink->Write(header, header_size))
+    return false;
+
+  vector<unsigned char> bytes(row_bytes);
+  for (size_t i = 0; i < mask.num_rows(); ++i) {
+    const uint64_t *words = mask.Row(i);
+    for (size_t k = 0; k < row_bytes; ++k)
+      bytes[k] = ReverseBits(static_cast<unsigned char>(
+          words[k / 8] >> (8 * (k % 8))));
+    if (!sink->Write(bytes.data(), row_bytes)) return false;
+  }
+  return true;
+}
+
+bool ReadMask(const string &filename, BinaryMask *mask) {
+  if (mask == nullptr) abort();
+  CV_METRIC_STAGE(kMetricRead);
+  MappedPgm input;
+  if (!input.Open(filename) || input.header().format != '4') {
+    cout << "ReadMask: Expected .pbm file" << endl;
+    return false;
+  }
+  const PgmHeader &header = input.header();
+  const size_t row_bytes = (header.num_columns + 7) / 8;
+  if (input.size() - header.raster_offset < header.raster_size) {
+    cout << "ReadMask: short file" << endl;
+    return false;
+  }
+
+  mask->AllocateSpaceAndSetSize(header.num_rows, header.num_columns);
+  const unsigned char *raster = input.data() + header.raster_offset;
+  // Bits past the last column are padding and must stay 0 in the mask.
+  const size_t tail = header.num_columns % BinaryMask::kBitsPerWord;
+  const uint64_t last_word_mask = tail == 0 ? ~uint64_t{0}
+                                            : (uint64_t{1} << tail) - 1;
+  for (size_t i = 0; i < header.num_rows; ++i) {
+    const unsigned char *bytes = raster + i * row_bytes;
+    uint64_t *words = mask->Row(i);
+    for (size_t k = 0; k < row_bytes; ++k)
+      words[k / 8] |= static_cast<uint64_t>(ReverseBits(bytes[k]))
+                      << (8 * (k % 8));
+    if (mask->words_per_row() > 0)
+      words[mask->words_per_row() - 1] &= last_word_mask;
+  }
+  return true;
+}
+
+bool WriteMask(const string &filename, const BinaryMask &mask) {
+  CV_METRIC_STAGE(kMetricWrite);
+  FilePgmSink output;
+  if (!output.Open(filename)) {
+    cout << "WriteMask: cannot open file" << endl;
+    return false;
+  }
+  if (!EncodePbm(mask, &output) || !output.Finish()) {
+    cout << "WriteMask: could not write" << endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ComputerVisionProjects
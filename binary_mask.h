@@ -0,0 +1,114 @@
+// Bit-packed binary images and the thresholding kernel producing them.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_BINARY_MASK_H_
+#define COMPUTER_VISION_BINARY_MASK_H_
+
+#include "image.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+class PgmSink;
+
+// Binary image storing 64 pixels per word.
+// Pixel (i, j) is bit (j % 64) of word (j / 64) of row i, so the
+// leftmost pixel of a word is its least significant bit. Bits past the
+// last column of a row are always 0.
+// Sample usage:
+//   BinaryMask mask;
+//   ThresholdToMask(an_image, 125, &mask);
+//   if (mask.GetPixel(10, 20)) ...
+class BinaryMask {
+ public:
+  static const size_t kBitsPerWord = 64;
+
+  BinaryMask(): num_rows_{0}, num_columns_{0}, words_per_row_{0} { }
+
+  // Sets the size of the mask and clears every pixel.
+  void AllocateSpaceAndSetSize(size_t num_rows, size_t num_columns);
+
+  size_t num_rows() const { return num_rows_; }
+  size_t num_columns() const { return num_columns_; }
+  size_t words_per_row() const { return words_per_row_; }
+
+  uint64_t *Row(size_t i) { return words_.data() + i * words_per_row_; }
+  const uint64_t *Row(size_t i) const {
+    return words_.data() + i * words_per_row_;
+  }
+
+  void SetPixel(size_t i, size_t j, bool value) {
+    if (i >= num_rows_ || j >= num_columns_) abort();
+    const uint64_t bit = uint64_t{1} << (j % kBitsPerWord);
+    if (value)
+      Row(i)[j / kBitsPerWord] |= bit;
+    else
+      Row(i)[j / kBitsPerWord] &= ~bit;
+  }
+
+  bool GetPixel(size_t i, size_t j) const {
+    if (i >= num_rows_ || j >= num_columns_) abort();
+    return (Row(i)[j / kBitsPerWord] >> (j % kBitsPerWord)) & 1;
+  }
+
+ private:
+  size_t num_rows_;
+  size_t num_columns_;
+  size_t words_per_row_;
+  std::vector<uint64_t> words_;
+};
+
+/**
+ * ThresholdToMask( ) sets a mask pixel to 1 if the image pixel is above
+ * threshold and to 0 otherwise, like ConvertToBinary( ) but without
+ * modifying the image. 8-bit images are thresholded with AVX2 or SSE2
+ * when the processor supports them, chosen at run time.
+ *
+ * @param {Image} an_image: input image
+ * @param {int} threshold_value: the threshold value
+ * @param {BinaryMask} mask: the resulting mask
+ */
+void ThresholdToMask(const Image &an_image, int threshold_value,
+                     BinaryMask *mask);
+
+// Same as above for a raw 8-bit plane, such as MappedPgm::View().
+void ThresholdToMask(const ImagePlane<const uint8_t> &plane,
+                     int threshold_value, BinaryMask *mask);
+
+// Name of the threshold kernel selected for this processor:
+// "avx2", "sse2" or "scalar".
+const char *ThresholdKernelName();
+
+/**
+ * MaskToImage( ) expands a mask into an 8-bit image of 0s and 1s, the
+ * format ConvertToBinary( ) produces.
+ *
+ * @param {BinaryMask} mask: input mask
+ * @param {Image} an_image: the resulting image
+ */
+void MaskToImage(const BinaryMask &mask, Image *an_image);
+
+/**
+ * EncodePbm( ) serializes a mask as a binary (P4) pbm file into sink,
+ * eight pixels per byte. Foreground pixels are written as 1 bits.
+ *
+ * @param {BinaryMask} mask: input mask
+ * @param {PgmSink} sink: destination of the encoded bytes
+ * @return true if the sink accepted all the bytes
+ */
+bool EncodePbm(const BinaryMask &mask, PgmSink *sink);
+
+// Reads a binary (P4) pbm file into mask.
+// Returns true if  everyhing is OK, false otherwise.
+bool ReadMask(const std::string &input_filename, BinaryMask *mask);
+
+// Writes mask into the pbm file output_filename.
+// Returns true if  everyhing is OK, false otherwise.
+bool WriteMask(const std::string &output_filename, const BinaryMask &mask);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_BINARY_MASK_H_
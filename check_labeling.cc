@@ -0,0 +1,153 @@
+/******************************************************************************
+ * Title          : check_labeling.cc
+ * Description    : checks that every labeling engine numbers the objects
+ *                  of random binary images exactly as its reference
+ *                  does: the runs engine, ParallelRasterScan( ) on 1 to 8
+ *                  threads and the pixel4 kernel against RasterScan( ),
+ *                  the pixel8 and block kernels against an 8-connected
+ *                  flood fill. The kernels read both images and masks
+ * Purpose        :
+ * Usage          : ./check_labeling [number of images]
+ * Build with     : make check
+ */
+#include "binary_mask.h"
+#include "image.h"
+#include "labeling_kernels.h"
+#include "labeling_workspace.h"
+#include "parallel_labeling.h"
+#include "run_labeling.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace ComputerVisionProjects;
+
+namespace {
+
+void MakeBinaryImage(size_t num_rows, size_t num_columns,
+                     const vector<uint8_t> &pixels, Image *an_image) {
+  an_image->AllocateSpaceAndSetSize(num_rows, num_columns);
+  an_image->SetNumberGrayLevels(1);
+  for (size_t i = 0; i < num_rows; ++i)
+    for (size_t j = 0; j < num_columns; ++j)
+      an_image->SetPixel(i, j, pixels[i * num_columns + j]);
+}
+
+// Labels the 8-connected objects of pixels in the raster order of their
+// first pixel, one flood fill per object.
+void FloodFill8(size_t num_rows, size_t num_columns,
+                const vector<uint8_t> &pixels, Image *labels) {
+  labels->AllocateSpaceAndSetSize(num_rows, num_columns, PixelDepth::kUint32);
+  for (size_t i = 0; i < num_rows; ++i)
+    for (size_t j = 0; j < num_columns; ++j) labels->SetPixel(i, j, 0);
+  int num_objects = 0;
+  vector<pair<size_t, size_t>> stack;
+  for (size_t i = 0; i < num_rows; ++i) {
+    for (size_t j = 0; j < num_columns; ++j) {
+      if (!pixels[i * num_columns + j] || labels->GetPixel(i, j) != 0)
+        continue;
+      ++num_objects;
+      labels->SetPixel(i, j, num_objects);
+      stack.assign(1, make_pair(i, j));
+      while (!stack.empty()) {
+        const size_t row = stack.back().first;
+        const size_t column = stack.back().second;
+        stack.pop_back();
+        for (size_t x = row == 0 ? 0 : row - 1;
+             x <= row + 1 && x < num_rows; ++x) {
+          for (size_t y = column == 0 ? 0 : column - 1;
+               y <= column + 1 && y < num_columns; ++y) {
+            if (!pixels[x * num_columns + y] || labels->GetPixel(x, y) != 0)
+              continue;
+            labels->SetPixel(x, y, num_objects);
+            stack.push_back(make_pair(x, y));
+          }
+        }
+      }
+    }
+  }
+}
+
+bool SameLabels(const Image &an_image, const Image &other) {
+  for (size_t i = 0; i < an_image.num_rows(); ++i)
+    for (size_t j = 0; j < an_image.num_columns(); ++j)
+      if (an_image.GetPixel(i, j) != other.GetPixel(i, j)) return false;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv){
+  if (argc > 2) {
+    printf("Usage: %s [number of images]\n", argv[0]);
+    return 0;
+  }
+  const int num_images = argc > 1 ? atoi(argv[1]) : 100;
+  // fixed seed, so that a failure can be reproduced
+  mt19937 random(11);
+  // Kept across images, as a long-running process keeps them.
+  RunLabeling runs;
+  RasterScanWorkspace workspace;
+  Image expected4, expected8, labeled, labels;
+  vector<uint8_t> pixels;
+  BinaryMask mask;
+  int num_mismatches = 0;
+  for (int k = 0; k < num_images; ++k) {
+    // Every fourth image is tall, so that the parallel engine has bands
+    // of many rows to merge.
+    const size_t num_rows = 1 + random() % (k % 4 == 0 ? 400 : 70);
+    const size_t num_columns = 1 + random() % 150;
+    const unsigned density = random() % 100;
+    pixels.resize(num_rows * num_columns);
+    mask.AllocateSpaceAndSetSize(num_rows, num_columns);
+    for (size_t i = 0; i < num_rows; ++i) {
+      for (size_t j = 0; j < num_columns; ++j) {
+        pixels[i * num_columns + j] = random() % 100 < density;
+        mask.SetPixel(i, j, pixels[i * num_columns + j]);
+      }
+    }
+    MakeBinaryImage(num_rows, num_columns, pixels, &expected4);
+    RasterScan(&expected4);
+    FloodFill8(num_rows, num_columns, pixels, &expected8);
+
+    vector<string> differing;
+    MakeBinaryImage(num_rows, num_columns, pixels, &labeled);
+    RunLengthLabeling(&labeled, &runs, &workspace);
+    if (!SameLabels(expected4, labeled)) differing.push_back("runs");
+    for (size_t num_threads = 1; num_threads <= 8; ++num_threads) {
+      ParallelLabelingOptions options;
+      options.num_threads = num_threads;
+      MakeBinaryImage(num_rows, num_columns, pixels, &labeled);
+      ParallelRasterScan(&labeled, options);
+      if (!SameLabels(expected4, labeled))
+        differing.push_back("parallel/" + to_string(num_threads));
+    }
+    MakeBinaryImage(num_rows, num_columns, pixels, &labeled);
+    for (const char *name : {"pixel4", "pixel8", "block"}) {
+      LabelingMode mode;
+      if (!ParseLabelingMode(name, &mode)) abort();
+      const Image &expected =
+          mode.connectivity == Connectivity::kFour ? expected4 : expected8;
+      LabelBinaryImage(labeled, mode, &labels, &workspace);
+      if (!SameLabels(expected, labels)) differing.push_back(name);
+      LabelBinaryImage(mask, mode, &labels, &workspace);
+      if (!SameLabels(expected, labels))
+        differing.push_back(string(name) + " mask");
+    }
+    if (differing.empty()) continue;
+    ++num_mismatches;
+    cout << "check_labeling: " << num_rows << "x" << num_columns
+         << " image " << k << " at density " << density << "%:";
+    for (const string &engine : differing) cout << " " << engine;
+    cout << " differ" << endl;
+  }
+  cout << "check_labeling: " << num_mismatches << " of " << num_images
+       << " images differ" << endl;
+  return num_mismatches == 0 ? 0 : 1;
+}
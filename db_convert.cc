@@ -0,0 +1,49 @@
+/******************************************************************************
+ * Title          : db_convert.cc
+ * Description    : converts an object model database between the text
+ *                  format written by p3 and the binary format p4 maps
+ *                  without parsing. The direction is picked from the
+ *                  input: a binary database is written back as text,
+ *                  anything else is read as text and written as binary
+ * Purpose        : 
+ * Usage          : ./db_convert two_objects_database.txt 
+ *                               two_objects_database.cvdb
+ * Build with     : make all
+ */
+#include "image.h"
+#include "model_database.h"
+#include "object_matcher.h"
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <string>
+
+using namespace std;
+using namespace ComputerVisionProjects;
+
+int main(int argc, char **argv){  
+  if (argc!=3) {
+    printf("Usage: %s {input database} {output database}\n", argv[0]);
+    return 0;
+  }
+  const string input_database(argv[1]);
+  const string output_database(argv[2]);
+
+  ModelDatabase database;
+  if (!LoadModelDatabase(input_database, &database)) {
+    cout << "Can't read database " << input_database << endl;
+    return 0;
+  }
+
+  if (IsBinaryModelDatabase(input_database)) {
+    ofstream output_file(output_database);
+    if (output_file.fail()) {
+      cerr << "Could not open: {output database}\n";
+      exit(1); // 1 indicates an error occurred
+    }
+    WriteObjectDatabase(output_file, database.models);
+  } else if (!WriteModelDatabase(output_database, database.models)) {
+    cout << "Can't write to file " << output_database << endl;
+    return 0;
+  }
+}
@@ -0,0 +1,48 @@
+// Scratch arrays of a frame, kept for the frames after it.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_FRAME_ARENA_H_
+#define COMPUTER_VISION_FRAME_ARENA_H_
+
+#include "labeling_workspace.h"
+#include "object_matcher.h"
+#include "object_moments.h"
+#include "overlay.h"
+#include "run_labeling.h"
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Every array the labeling, measuring and matching stages fill and
+// throw away within one frame. A stage clears and refills its arrays
+// instead of allocating new ones, so they only grow, and once a
+// long-running process has seen the largest frame of its input the
+// stages run without touching the heap. Not shared between threads:
+// keep one per thread that handles frames.
+//
+// Example:
+//   FrameArena arena;
+//   for (each frame) {
+//     RunLengthLabeling(&frame, &arena.runs, &arena.labeling);
+//     CompareObjectAttributes(index, &frame, &matches, &arena);
+//   }
+struct FrameArena {
+  // Equivalence and relabel tables and the depth change scratch image.
+  RasterScanWorkspace labeling;
+  // Runs of the run-based labeling.
+  RunLabeling runs;
+  // Per object moment accumulators, index 0 unused.
+  std::vector<ObjectFeatures> objects;
+  std::vector<ObjectMoments> moments;
+  // Partial tables of the row bands MeasureObjects( ) sums in parallel.
+  std::vector<std::vector<ObjectFeatures>> partial_objects;
+  InertiaBatch inertia;
+  // Model records of the measured objects, as the databases hold them.
+  std::vector<ModelRecord> models;
+  // Lines and marks drawn at the end of a stage.
+  OverlayBatch annotations;
+};
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_FRAME_ARENA_H_
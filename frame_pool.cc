@@ -0,0 +1,70 @@
+// Pool of pixel buffers handed from one frame to the next.
+// To be used in Computer Vision class.
+
+#include "frame_pool.h"
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+FramePool::FramePool(size_t max_buffers): max_buffers_{max_buffers} {
+  // Release( ) never grows the vector past this.
+  buffers_.reserve(max_buffers_);
+}
+
+void FramePool::Acquire(size_t num_rows, size_t num_columns,
+                        PixelDepth depth, Image *an_image) {
+  if (an_image == nullptr) abort();
+  const size_t size = Image::BufferSize(num_rows, num_columns, depth);
+  if (an_image->capacity() < size) {
+    lock_guard<mutex> hold(mutex_);
+    size_t best = buffers_.size();
+    for (size_t k = 0; k < buffers_.size(); ++k) {
+      if (buffers_[k].capacity() < size) continue;
+      if (best == buffers_.size() ||
+          buffers_[k].capacity() < buffers_[best].capacity())
+        best = k;
+    }
+    if (best < buffers_.size()) {
+      // The buffer an_image had, if any, takes the place of the one it gets.
+      an_image->Swap(buffers_[best]);
+      if (buffers_[best].capacity() == 0) {
+        buffers_[best].Swap(buffers_.back());
+        buffers_.pop_back();
+      }
+    }
+  }
+  an_image->AllocateSpaceAndSetSize(num_rows, num_columns, depth);
+}
+
+void FramePool::Release(Image *an_image) {
+  if (an_image == nullptr) abort();
+  // Freed, if the pool does not keep it, after the lock is released.
+  Image released(move(*an_image));
+  if (released.capacity() == 0) return;
+  lock_guard<mutex> hold(mutex_);
+  if (buffers_.size() < max_buffers_) {
+    buffers_.push_back(move(released));
+    return;
+  }
+  if (buffers_.empty()) return;
+  auto smallest = min_element(buffers_.begin(), buffers_.end(),
+                              [](const Image &a, const Image &b) {
+                                return a.capacity() < b.capacity();
+                              });
+  if (smallest->capacity() < released.capacity()) smallest->Swap(released);
+}
+
+size_t FramePool::size() const {
+  lock_guard<mutex> hold(mutex_);
+  return buffers_.size();
+}
+
+FramePool &SharedFramePool() {
+  static FramePool pool;
+  return pool;
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,67 @@
+// Pool of pixel buffers handed from one frame to the next.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_FRAME_POOL_H_
+#define COMPUTER_VISION_FRAME_POOL_H_
+
+#include "image.h"
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Keeps the pixel buffers of images that are done with, up to
+// max_buffers of them, and gives them to the next image of a size they
+// hold. A process that handles frames of a few sizes stops allocating
+// pixel buffers once each size has gone through the pool. Safe to use
+// from several threads.
+//
+// Example:
+//   FramePool pool;
+//   Image scratch;
+//   pool.Acquire(num_rows, num_columns, PixelDepth::kUint32, &scratch);
+//   ...
+//   pool.Release(&scratch);  // the buffer waits for the next Acquire( )
+class FramePool {
+ public:
+  explicit FramePool(size_t max_buffers = 4);
+
+  FramePool(const FramePool &) = delete;
+  FramePool &operator=(const FramePool &) = delete;
+
+  /**
+   * Acquire( ) sizes an_image with the smallest kept buffer that holds
+   * num_rows x num_columns pixels of depth, or allocates one when none
+   * does. The pixel values are left as they were.
+   *
+   * @param {size_t} num_rows: rows of the image
+   * @param {size_t} num_columns: columns of the image
+   * @param {PixelDepth} depth: storage width of the pixels
+   * @param {Image} an_image: receives the buffer; its own buffer, if
+   *                any, goes back to the pool
+   */
+  void Acquire(size_t num_rows, size_t num_columns, PixelDepth depth,
+               Image *an_image);
+
+  // Takes the buffer of an_image, which is left empty. When the pool is
+  // full the buffer is freed, unless it is larger than the smallest
+  // kept one, which it replaces.
+  void Release(Image *an_image);
+
+  // Buffers kept.
+  size_t size() const;
+
+ private:
+  const size_t max_buffers_;
+  mutable std::mutex mutex_;
+  std::vector<Image> buffers_;
+};
+
+// The pool Image::SetDepth( ) converts through when it is not given a
+// scratch image.
+FramePool &SharedFramePool();
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_FRAME_POOL_H_
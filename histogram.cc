@@ -0,0 +1,212 @@
+// Gray-level histograms and automatic threshold selection.
+// To be used in Computer Vision class.
+
+#include "histogram.h"
+#include "metrics.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+void GrayHistogram::Clear() {
+  for (size_t bin = 0; bin < kNumBins; ++bin) counts_[bin] = 0;
+}
+
+uint64_t GrayHistogram::total() const {
+  uint64_t sum = 0;
+  for (size_t bin = 0; bin < kNumBins; ++bin) sum += counts_[bin];
+  return sum;
+}
+
+void GrayHistogram::Add(const GrayHistogram &other) {
+  for (size_t bin = 0; bin < kNumBins; ++bin) counts_[bin] += other.counts_[bin];
+}
+
+void HistogramAccumulator::Clear() {
+  memset(banks_, 0, sizeof banks_);
+  pending_ = 0;
+  spilled_.Clear();
+}
+
+void HistogramAccumulator::Add(const uint8_t *pixels, size_t count) {
+  // Each bank sees at most a quarter of the pixels plus the tail, so
+  // spilling every 2^31 pixels keeps the 32-bit counters safe.
+  if (pending_ + count >= (size_t{1} << 31)) Spill();
+  size_t k = 0;
+  for (; k + kNumBanks <= count; k += kNumBanks) {
+    ++banks_[0][pixels[k]];
+    ++banks_[1][pixels[k + 1]];
+    ++banks_[2][pixels[k + 2]];
+    ++banks_[3][pixels[k + 3]];
+  }
+  for (; k < count; ++k) ++banks_[0][pixels[k]];
+  pending_ += count;
+}
+
+void HistogramAccumulator::Spill() {
+  for (size_t bin = 0; bin < GrayHistogram::kNumBins; ++bin) {
+    uint64_t sum = 0;
+    for (size_t bank = 0; bank < kNumBanks; ++bank) {
+      sum += banks_[bank][bin];
+      banks_[bank][bin] = 0;
+    }
+    spilled_.AddToBin(bin, sum);
+  }
+  pending_ = 0;
+}
+
+void HistogramAccumulator::FlushTo(GrayHistogram *histogram) {
+  if (histogram == nullptr) abort();
+  Spill();
+  histogram->Add(spilled_);
+  spilled_.Clear();
+}
+
+int HistogramShiftForMaxValue(size_t max_value) {
+  int shift = 0;
+  while ((max_value >> shift) >= GrayHistogram::kNumBins) ++shift;
+  return shift;
+}
+
+void ComputeHistogram(const ImagePlane<const uint8_t> &plane,
+                      GrayHistogram *histogram) {
+  if (histogram == nullptr) abort();
+  histogram->Clear();
+  histogram->SetShift(0);
+  const size_t num_pixels = plane.num_rows() * plane.num_columns();
+  const size_t num_bands =
+      num_pixels >= kParallelHistogramPixels ? DefaultThreadCount() : 1;
+
+  vector<GrayHistogram> partials(num_bands);
+  ParallelForBands(plane.num_rows(), num_bands,
+                   [&plane, &partials](size_t band, size_t begin,
+                                       size_t end) {
+    HistogramAccumulator accumulator;
+    for (size_t i = begin; i < end; ++i)
+      accumulator.Add(plane.Row(i), plane.num_columns());
+    accumulator.FlushTo(&partials[band]);
+  });
+  for (const GrayHistogram &partial : partials) histogram->Add(partial);
+}
+
+void ComputeHistogram(const Image &an_image, GrayHistogram *histogram) {
+  if (histogram == nullptr) abort();
+  if (an_image.depth() == PixelDepth::kUint8) {
+    ComputeHistogram(an_image.Plane<uint8_t>(), histogram);
+    return;
+  }
+  histogram->Clear();
+  const int shift = HistogramShiftForMaxValue(an_image.num_gray_levels());
+  histogram->SetShift(shift);
+  const auto count_plane = [histogram, shift](auto plane) {
+    for (size_t i = 0; i < plane.num_rows(); ++i) {
+      const auto *row = plane.Row(i);
+      for (size_t j = 0; j < plane.num_columns(); ++j)
+        histogram->AddToBin(
+            min<size_t>(row[j] >> shift, GrayHistogram::kNumBins - 1), 1);
+    }
+  };
+  if (an_image.depth() == PixelDepth::kUint16)
+    count_plane(an_image.Plane<uint16_t>());
+  else
+    count_plane(an_image.Plane<uint32_t>());
+}
+
+namespace {
+
+// Returns the bin t maximizing the between-class variance of [0, t]
+// and [t + 1, 255].
+size_t OtsuBin(const GrayHistogram &histogram) {
+  double total = 0, sum = 0;
+  for (size_t bin = 0; bin < GrayHistogram::kNumBins; ++bin) {
+    total += histogram.count(bin);
+    sum += bin * static_cast<double>(histogram.count(bin));
+  }
+
+  double background_weight = 0, background_sum = 0;
+  double best_variance = -1;
+  size_t best_bin = GrayHistogram::kNumBins - 1;
+  for (size_t bin = 0; bin < GrayHistogram::kNumBins; ++bin) {
+    background_weight += histogram.count(bin);
+    if (background_weight == 0) continue;
+    const double foreground_weight = total - background_weight;
+    if (foreground_weight == 0) break;
+    background_sum += bin * static_cast<double>(histogram.count(bin));
+    const double background_mean = background_sum / background_weight;
+    const double foreground_mean = (sum - background_sum) / foreground_weight;
+    const double difference = background_mean - foreground_mean;
+    const double variance =
+        background_weight * foreground_weight * difference * difference;
+    if (variance > best_variance) {
+      best_variance = variance;
+      best_bin = bin;
+    }
+  }
+  return best_bin;
+}
+
+// Returns the bin farthest below the line joining the histogram peak to
+// the end of its longer tail.
+size_t TriangleBin(const GrayHistogram &histogram) {
+  size_t first = GrayHistogram::kNumBins, last = 0, peak = 0;
+  for (size_t bin = 0; bin < GrayHistogram::kNumBins; ++bin) {
+    if (histogram.count(bin) == 0) continue;
+    first = min(first, bin);
+    last = bin;
+    if (histogram.count(bin) > histogram.count(peak)) peak = bin;
+  }
+  if (first == GrayHistogram::kNumBins) return GrayHistogram::kNumBins - 1;
+
+  // The line ends on the first empty bin past the tail.
+  const bool tail_is_above = last - peak >= peak - first;
+  const long end = tail_is_above
+      ? min<long>(last + 1, GrayHistogram::kNumBins - 1)
+      : max<long>(static_cast<long>(first) - 1, 0);
+  const double peak_height = histogram.count(peak);
+  const long step = tail_is_above ? 1 : -1;
+
+  // Distance below the line is proportional to this cross product.
+  size_t best_bin = peak;
+  double best_distance = 0;
+  for (long bin = peak; bin != end + step; bin += step) {
+    const double distance =
+        step * (peak_height * (end - bin) -
+                static_cast<double>(histogram.count(bin)) *
+                    (end - static_cast<long>(peak)));
+    if (distance > best_distance) {
+      best_distance = distance;
+      best_bin = bin;
+    }
+  }
+  return best_bin;
+}
+
+}  // namespace
+
+int SelectThreshold(const GrayHistogram &histogram, ThresholdMethod method) {
+  CV_METRIC_STAGE(kMetricThreshold);
+  const size_t bin = method == ThresholdMethod::kTriangle
+                         ? TriangleBin(histogram)
+                         : OtsuBin(histogram);
+  return histogram.BinToThreshold(bin);
+}
+
+bool ParseThresholdMethod(const string &name, ThresholdMethod *method) {
+  if (method == nullptr) abort();
+  if (name == "auto" || name == "otsu") {
+    *method = ThresholdMethod::kOtsu;
+    return true;
+  }
+  if (name == "triangle") {
+    *method = ThresholdMethod::kTriangle;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,111 @@
+// Gray-level histograms and automatic threshold selection.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_HISTOGRAM_H_
+#define COMPUTER_VISION_HISTOGRAM_H_
+
+#include "image.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ComputerVisionProjects {
+
+// 256-bin histogram of the gray levels of an image.
+// Images with more than 256 gray levels are binned by dropping the
+// shift() low bits of each gray level.
+class GrayHistogram {
+ public:
+  static const size_t kNumBins = 256;
+
+  GrayHistogram(): counts_(), shift_{0} { }
+
+  void Clear();
+
+  uint64_t count(size_t bin) const { return counts_[bin]; }
+  uint64_t total() const;
+  int shift() const { return shift_; }
+  void SetShift(int shift) { shift_ = shift; }
+
+  void AddToBin(size_t bin, uint64_t count) { counts_[bin] += count; }
+  // Adds the counts of other, which must use the same shift().
+  void Add(const GrayHistogram &other);
+
+  // Largest gray level falling into bin: the threshold_value to pass to
+  // ConvertToBinary( ) to separate bins [0, bin] from the ones above.
+  int BinToThreshold(size_t bin) const {
+    return static_cast<int>(((bin + 1) << shift_) - 1);
+  }
+
+ private:
+  uint64_t counts_[kNumBins];
+  int shift_;
+};
+
+// Counts 8-bit pixels into a GrayHistogram.
+// Consecutive pixels go to four separate banks of counters, so runs of
+// equal gray levels (typical of background) do not stall on a
+// store-to-load dependency on one counter.
+class HistogramAccumulator {
+ public:
+  HistogramAccumulator() { Clear(); }
+
+  void Clear();
+  void Add(const uint8_t *pixels, size_t count);
+  // Adds the counts so far to histogram and clears the accumulator.
+  void FlushTo(GrayHistogram *histogram);
+
+ private:
+  static const size_t kNumBanks = 4;
+
+  // Moves the bank counts into spilled_ before they can overflow.
+  void Spill();
+
+  uint32_t banks_[kNumBanks][GrayHistogram::kNumBins];
+  size_t pending_;
+  GrayHistogram spilled_;
+};
+
+/**
+ * ComputeHistogram( ) builds the histogram of an 8-bit plane. Large
+ * planes are split into row bands counted on separate threads into
+ * partial histograms that are then summed.
+ *
+ * @param {ImagePlane} plane: input pixels
+ * @param {GrayHistogram} histogram: the resulting histogram
+ */
+void ComputeHistogram(const ImagePlane<const uint8_t> &plane,
+                      GrayHistogram *histogram);
+
+// Same as above for an image of any depth; the shift is chosen from
+// num_gray_levels() so that every gray level fits in 256 bins.
+void ComputeHistogram(const Image &an_image, GrayHistogram *histogram);
+
+// Shift needed to bin gray levels up to max_value into 256 bins.
+int HistogramShiftForMaxValue(size_t max_value);
+
+// Images with at least this many pixels get per-thread histograms.
+const size_t kParallelHistogramPixels = size_t{1} << 22;
+
+enum class ThresholdMethod { kOtsu, kTriangle };
+
+/**
+ * SelectThreshold( ) picks a threshold_value for ConvertToBinary( ) from
+ * a histogram. kOtsu maximizes the between-class variance of background
+ * and objects; kTriangle takes the bin farthest from the line joining
+ * the histogram peak to the far end of its longer tail, which suits
+ * small objects on a large background.
+ *
+ * @param {GrayHistogram} histogram: histogram of the image
+ * @param {ThresholdMethod} method: selection method
+ * @return the threshold value, in gray levels of the image
+ */
+int SelectThreshold(const GrayHistogram &histogram, ThresholdMethod method);
+
+// Parses the threshold argument of p1: "auto" or "otsu" select kOtsu,
+// "triangle" selects kTriangle. Returns false for anything else.
+bool ParseThresholdMethod(const std::string &name, ThresholdMethod *method);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_HISTOGRAM_H_
@@ -5,6 +5,16 @@
 
 #include "image.h"
 #include "DisjSets.h"
+#include "UnionFind.h"
+#include "frame_arena.h"
+#include "frame_pool.h"
+#include "labeling_workspace.h"
+#include "metrics.h"
+#include "object_matcher.h"
+#include "object_moments.h"
+#include "overlay.h"
+#include "pgm_io.h"
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -14,21 +24,73 @@
 #include <map>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 #include <array>
 #include <string>   // getline()
+#include <unistd.h> // access()
+#include <utility>  // swap()
 
 using namespace std;
 
 namespace ComputerVisionProjects {
 
-Image::Image(const Image &an_image){
-  AllocateSpaceAndSetSize(an_image.num_rows(), an_image.num_columns());
+namespace {
+
+// Rows are padded so that each one starts on a cache line.
+const size_t kRowAlignment = 64;
+
+// Bytes of the padded rows of an image of that size, or false when
+// they do not fit in a size_t.
+bool AlignedSize(size_t num_rows, size_t num_columns, PixelDepth depth,
+                 size_t *stride, size_t *size) {
+  const size_t bytes_per_pixel = static_cast<size_t>(depth);
+  if (num_columns > (SIZE_MAX - kRowAlignment) / bytes_per_pixel)
+    return false;
+  const size_t row_bytes = num_columns * bytes_per_pixel;
+  *stride = (row_bytes + kRowAlignment - 1) / kRowAlignment * kRowAlignment;
+  if (num_rows != 0 && *stride > SIZE_MAX / num_rows) return false;
+  *size = *stride * num_rows;
+  return true;
+}
+
+// Copies one plane into another of possibly different pixel type.
+template <typename SourceType, typename DestinationType>
+void CopyPlane(const ImagePlane<SourceType> &source,
+               const ImagePlane<DestinationType> &destination) {
+  for (size_t i = 0; i < source.num_rows(); ++i) {
+    const PixelSpan<const SourceType> from = source.Span(i);
+    const PixelSpan<DestinationType> to = destination.Span(i);
+    transform(from.begin(), from.end(), to.begin(), [](SourceType value) {
+      return static_cast<DestinationType>(value);
+    });
+  }
+}
+
+}  // namespace
+
+Image::Image(const Image &an_image): Image() {
+  *this = an_image;
+}
+
+Image::Image(Image &&an_image) noexcept: Image() {
+  Swap(an_image);
+}
+
+Image&
+Image::operator=(const Image &an_image) {
+  if (this == &an_image) return *this;
+  AllocateSpaceAndSetSize(an_image.num_rows(), an_image.num_columns(),
+                          an_image.depth());
   SetNumberGrayLevels(an_image.num_gray_levels());
+  if (pixels_ != nullptr)
+    memcpy(pixels_, an_image.pixels_, stride_ * num_rows_);
+  return *this;
+}
 
-  for (size_t i = 0; i < num_rows(); ++i)
-    for (size_t j = 0; j < num_columns(); ++j){
-      SetPixel(i,j, an_image.GetPixel(i,j));
-    }
+Image&
+Image::operator=(Image &&an_image) noexcept {
+  Swap(an_image);
+  return *this;
 }
 
 Image::~Image(){
@@ -36,254 +98,144 @@ Image::~Image(){
 }
 
 void
-Image::AllocateSpaceAndSetSize(size_t num_rows, size_t num_columns) {
-  if (pixels_ != nullptr) DeallocateSpace();
-  pixels_ = new int*[num_rows];
-  for (size_t i = 0; i < num_rows; ++i)
-    pixels_[i] = new int[num_columns];
+Image::AllocateSpaceAndSetSize(size_t num_rows, size_t num_columns,
+                               PixelDepth depth) {
+  size_t stride, size;
+  // A wrapped size would pass for a small buffer the image overruns.
+  if (!AlignedSize(num_rows, num_columns, depth, &stride, &size)) abort();
+  if (size > capacity_) {
+    DeallocateSpace();
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, kRowAlignment, size) != 0) abort();
+    pixels_ = static_cast<unsigned char *>(buffer);
+    capacity_ = size;
+  }
 
   num_rows_ = num_rows;
   num_columns_ = num_columns;
+  depth_ = depth;
+  stride_ = stride;
+}
+
+size_t
+Image::BufferSize(size_t num_rows, size_t num_columns, PixelDepth depth) {
+  size_t stride, size;
+  return AlignedSize(num_rows, num_columns, depth, &stride, &size)
+             ? size : SIZE_MAX;
+}
+
+void
+Image::SetDepth(PixelDepth depth) {
+  if (depth == depth_) return;
+  FramePool &pool = SharedFramePool();
+  Image scratch;
+  pool.Acquire(num_rows_, num_columns_, depth, &scratch);
+  SetDepth(depth, &scratch);
+  // the old buffer of this image
+  pool.Release(&scratch);
+}
+
+void
+Image::SetDepth(PixelDepth depth, Image *scratch) {
+  if (scratch == nullptr) abort();
+  if (depth == depth_) return;
+  scratch->AllocateSpaceAndSetSize(num_rows_, num_columns_, depth);
+  const Image &source = *this;
+  VisitPlane(scratch, [&source](auto to) {
+    switch (source.depth()) {
+      case PixelDepth::kUint8:
+        CopyPlane(source.Plane<uint8_t>(), to);
+        break;
+      case PixelDepth::kUint16:
+        CopyPlane(source.Plane<uint16_t>(), to);
+        break;
+      case PixelDepth::kUint32:
+        CopyPlane(source.Plane<uint32_t>(), to);
+        break;
+    }
+  });
+  swap(pixels_, scratch->pixels_);
+  swap(capacity_, scratch->capacity_);
+  swap(depth_, scratch->depth_);
+  swap(stride_, scratch->stride_);
+}
+
+void
+Image::Swap(Image &other) {
+  swap(num_rows_, other.num_rows_);
+  swap(num_columns_, other.num_columns_);
+  swap(num_gray_levels_, other.num_gray_levels_);
+  swap(depth_, other.depth_);
+  swap(stride_, other.stride_);
+  swap(capacity_, other.capacity_);
+  swap(pixels_, other.pixels_);
 }
 
 void
 Image::DeallocateSpace() {
-  for (size_t i = 0; i < num_rows_; i++)
-    delete pixels_[i];
-  delete pixels_;
+  free(pixels_);
   pixels_ = nullptr;
+  capacity_ = 0;
   num_rows_ = 0;
   num_columns_ = 0;
+  stride_ = 0;
+}
+
+PixelDepth DepthForMaxValue(size_t max_value) {
+  if (max_value <= UINT8_MAX) return PixelDepth::kUint8;
+  if (max_value <= UINT16_MAX) return PixelDepth::kUint16;
+  return PixelDepth::kUint32;
 }
 
 bool ReadImage(const string &filename, Image *an_image) {  
+  return ReadImage(filename, an_image, nullptr);
+}
+
+bool ReadImage(const string &filename, Image *an_image,
+               GrayHistogram *histogram) {
   if (an_image == nullptr) abort();
-  FILE *input = fopen(filename.c_str(),"rb");
-  if (input == 0) {
-    cout << "ReadImage: Cannot open file" << endl;
+  CV_METRIC_STAGE(kMetricRead);
+  MappedPgm input;
+  if (!input.Open(filename)) {
+    if (access(filename.c_str(), R_OK) != 0)
+      cout << "ReadImage: Cannot open file" << endl;
+    else
+      cout << "ReadImage: Expected .pgm file" << endl;
     return false;
   }
-  
-  // Check for the right "magic number".
-  char line[1024];
-  if (fread(line, 1, 3, input) != 3 || strncmp(line,"P5\n",3)) {
-    fclose(input);
-    cout << "ReadImage: Expected .pgm file" << endl;
+
+  // Parse the raster straight out of the mapped file.
+  if (!DecodePgmRaster(input, an_image, histogram)) {
+    cout << "ReadImage: short file or sample above maximum" << endl;
     return false;
   }
-  
-  // Skip comments.
-  do
-    fgets(line, sizeof line, input);
-  while(*line == '#');
-  
-  // Read the width and height.
-  int num_columns,num_rows;
-  sscanf(line,"%d %d\n", &num_columns, &num_rows);
-  an_image->AllocateSpaceAndSetSize(num_rows, num_columns);
-  
-
-  // Read # of gray levels.
-  fgets(line, sizeof line, input);
-  int levels;
-  sscanf(line,"%d\n", &levels);
-  an_image->SetNumberGrayLevels(levels);
-
-  // read pixel row by row.
-  for (int i = 0; i < num_rows; ++i) {
-    for (int j = 0;j < num_columns; ++j) {
-      const int byte=fgetc(input);
-      if (byte == EOF) {
-        fclose(input);
-        cout << "ReadImage: short file" << endl;
-        return false;
-      }
-      an_image->SetPixel(i, j, byte);
-    }
-  }
-  
-  fclose(input);
   return true; 
 }
 
 bool WriteImage(const string &filename, const Image &an_image) {  
-  FILE *output = fopen(filename.c_str(), "w");
-  if (output == 0) {
+  CV_METRIC_STAGE(kMetricWrite);
+  FilePgmSink output;
+  if (!output.Open(filename)) {
     cout << "WriteImage: cannot open file" << endl;
     return false;
   }
-  const int num_rows = an_image.num_rows();
-  const int num_columns = an_image.num_columns();
-  const int colors = an_image.num_gray_levels();
-
-  // Write the header.
-  fprintf(output, "P5\n"); // Magic number.
-  fprintf(output, "#\n");  // Empty comment.
-  fprintf(output, "%d %d\n%03d\n", num_columns, num_rows, colors);
-
-  for (int i = 0; i < num_rows; ++i) {
-    for (int j = 0; j < num_columns; ++j) {
-      const int byte = an_image.GetPixel(i , j);
-      if (fputc(byte,output) == EOF) {
-	    fclose(output);
-            cout << "WriteImage: could not write" << endl;
-	    return false;
-      }
-    }
-  }
 
-  fclose(output);
+  // The header and the pixels go out together, without a copy.
+  if (!EncodePgm(an_image, &output) || !output.Finish()) {
+    cout << "WriteImage: could not write" << endl;
+    return false;
+  }
   return true; 
 }
 
-// Implements the Bresenham's incremental midpoint algorithm;
-// (adapted from J.D.Foley, A. van Dam, S.K.Feiner, J.F.Hughes
-// "Computer Graphics. Principles and practice", 
-// 2nd ed., 1990, section 3.2.2);  
+// Draws the part of the midpoint line that is inside an_image; see
+// DrawSegment( ) in overlay.h.
 void
 DrawLine(int x0, int y0, int x1, int y1, int color,
   Image *an_image) {  
   if (an_image == nullptr) abort();
-
-  #ifdef SWAP
-  #undef SWAP
-  #endif
-  #define SWAP(a,b) {a^=b; b^=a; a^=b;}
-
-  const int DIR_X = 0;
-  const int DIR_Y = 1;
-  
-  // Increments: East, North-East, South, South-East, North.
-  int incrE, incrNE, incrS, incrSE, incrN;     
-  int d;         /* the D */
-  int x,y;       /* running coordinates */
-  int mpCase;    /* midpoint algorithm's case */
-  int done;      /* set to 1 when done */
-  
-  int xmin = x0;
-  int xmax = x1;
-  int ymin = y0;
-  int ymax = y1;
-  
-  int dx = xmax - xmin;
-  int dy = ymax - ymin;
-  int dir;
-
-  if (dx * dx > dy * dy) {  // Horizontal scan.
-    dir=DIR_X;
-    if (xmax < xmin) {
-      SWAP(xmin, xmax);
-      SWAP(ymin , ymax);
-    } 
-    dx = xmax - xmin;
-    dy = ymax - ymin;
-
-    if (dy >= 0) {
-      mpCase = 1;
-      d = 2 * dy - dx;      
-    } else {
-      mpCase = 2;
-      d = 2 * dy + dx;      
-    }
-
-    incrNE = 2 * (dy - dx);
-    incrE = 2 * dy;
-    incrSE = 2 * (dy + dx);
-  } else {// vertical scan.
-    dir = DIR_Y;
-    if (ymax < ymin) {
-      SWAP(xmin, xmax);
-      SWAP(ymin, ymax);
-    }
-    dx = xmax - xmin;
-    dy = ymax-ymin;    
-
-    if (dx >=0 ) {
-      mpCase = 1;
-      d = 2 * dx - dy;      
-    } else {
-      mpCase = 2;
-      d = 2 * dx + dy;      
-    }
-
-    incrNE = 2 * (dx - dy);
-    incrE = 2 * dx;
-    incrSE = 2 * (dx + dy);
-  }
-  
-  /// Start the scan.
-  x = xmin;
-  y = ymin;
-  done = 0;
-
-  while (!done) {
-    an_image->SetPixel(x,y,color);
-
-    // Move to the next point.
-    switch(dir) {
-      case DIR_X: 
-      if (x < xmax) {
-       switch(mpCase) {
-         case 1:
-         if (d <= 0) {
-          d += incrE;  
-          x++;
-        } else {
-          d += incrNE; 
-          x++; 
-          y++;
-        }
-        break;
-
-        case 2:
-        if (d <= 0) {
-          d += incrSE; 
-          x++; 
-          y--;
-        } else {
-          d += incrE;  
-          x++;
-        }
-        break;
-      } 
-    } else {
-     done=1;
-   }     
-   break;
-
-   case DIR_Y: 
-   if (y < ymax) {
-    switch(mpCase) {
-     case 1:
-     if (d <= 0) {
-       d += incrE;  
-       y++;
-     } else {
-       d += incrNE; 
-       y++; 
-       x++;
-     }
-     break;
-
-     case 2:
-     if (d <= 0) {
-      d += incrSE; 
-      y++; 
-      x--;
-    } else {
-      d += incrE;  
-      y++;
-    }
-    break;
-	  } // mpCase
-        } // y < ymin 
-        else {
-         done=1;
-       }
-       break;    
-     }
-   }
- }
+  DrawSegment(OverlaySegment{x0, y0, x1, y1, color}, an_image);
+}
 
 /**
  * ConvertToBinary( ) sets image pixels to 0 if its value is below threshold
@@ -294,18 +246,13 @@ DrawLine(int x0, int y0, int x1, int y1, int color,
  */
 void ConvertToBinary(const int threshold_value, Image *an_image) {
   if (an_image == nullptr) abort();
-  int pixel;
-  int row = an_image->GetNumberOfRows();
-  int column = an_image->GetNumberOfColumns();
-  for (int i = 0; i < row; ++i) {
-    for (int j = 0; j < column; ++j) {
-      pixel = an_image->GetPixel(i,j);
-      if (pixel <= threshold_value)
-        an_image->SetPixel(i,j,0);
-      else
-        an_image->SetPixel(i,j,1);
-    }
-  }
+  CV_METRIC_STAGE(kMetricThreshold);
+  VisitPlane(an_image, [threshold_value](auto plane) {
+    for (auto row : plane.Rows())
+      for (auto &pixel : row)
+        pixel = (static_cast<int64_t>(pixel) <= threshold_value) ? 0 : 1;
+  });
+  an_image->SetDepth(PixelDepth::kUint8);
   an_image->SetNumberGrayLevels(1);
 }
 
@@ -316,30 +263,61 @@ void ConvertToBinary(const int threshold_value, Image *an_image) {
  * @param {Image} an_image: input image
  */
 void RasterScan(Image *an_image) {
+  RasterScan(an_image, nullptr);
+}
+
+/**
+ * RasterScan( ) labels the image like above and, when objects is not
+ * null, also measures every object during the first pass: moments and
+ * bounding boxes are accumulated per provisional label and merged for
+ * equivalent labels once the equivalences are resolved, so no second
+ * scan is needed to measure the objects.
+ * 
+ * @param {Image} an_image: input image
+ * @param {vector} objects: features of objects 1..n, index 0 unused
+ */
+void RasterScan(Image *an_image, std::vector<ObjectFeatures> *objects) {
+  RasterScanWorkspace workspace;
+  RasterScan(an_image, objects, &workspace);
+}
+
+void RasterScan(Image *an_image, std::vector<ObjectFeatures> *objects,
+                RasterScanWorkspace *workspace) {
+  if (an_image == nullptr || workspace == nullptr) abort();
+  CV_METRIC_STAGE(kMetricLabel);
   // matrix dimensions
   int row = an_image->GetNumberOfRows();
   int column = an_image->GetNumberOfColumns();
 
-  DisjSets equivalence_table(1000);
+  // provisional labels do not fit in the 8-bit binary input
+  an_image->SetDepth(PixelDepth::kUint32, &workspace->scratch);
+  ImagePlane<uint32_t> labels = an_image->Plane<uint32_t>();
 
-  // create a region counter
-  int region_counter = 0;
+  // grow with the number of provisional labels; emptied, not freed
+  UnionFind &equivalence_table = workspace->equivalence_table;
+  equivalence_table.Reset(0);
+  std::vector<ObjectFeatures> &provisional_objects =
+      workspace->provisional_objects;
+  provisional_objects.assign(1, ObjectFeatures());
   for (int i = 0; i < row; ++i) {
+    uint32_t *current_row = labels.Row(i);
+    const uint32_t *previous_row = (i == 0) ? nullptr : labels.Row(i-1);
     for (int j = 0; j < column; ++j) {
       // pixel is the current pixel being looked at
-      int pixel = an_image->GetPixel(i,j);
+      int pixel = current_row[j];
       // found first foreground (non-zero) object
       if (pixel != 0) {
         // For every pixel check the north and west pixel
         // (when considering 4-connectivity)
         // condition ? value_if_true : value_if_false 
-        int north_pixel = (i == 0) ? 0 : an_image->GetPixel(i-1, j);  
-        int west_pixel = (j == 0) ? 0 : an_image->GetPixel(i, j-1); 
+        int north_pixel = (i == 0) ? 0 : previous_row[j];
+        int west_pixel = (j == 0) ? 0 : current_row[j-1];
         // If none of the neighbors fit the criterion 
         // then assign pixel to region value of the region counter. 
         // Increment region counter.
         if (north_pixel == 0 && west_pixel == 0) {
-          pixel = ++region_counter;
+          pixel = equivalence_table.MakeSet();
+          if (objects != nullptr) provisional_objects.emplace_back();
           //std::cout << pixel << " ";
         }
 
@@ -362,44 +340,39 @@ void RasterScan(Image *an_image) {
           // assign pixel to one of the regions (it doesn't matter which one).
           // Indicate that all of these regions are equivalent.
           else {
-            int west = equivalence_table.find(west_pixel);
-            int north = equivalence_table.find(north_pixel);
-            equivalence_table.unionSets(west, north); 
-            pixel = west;
+            pixel = equivalence_table.Union(west_pixel, north_pixel);
           }
         }
-        an_image->SetPixel(i,j,pixel);
+        current_row[j] = pixel;
+        if (objects != nullptr) {
+          provisional_objects[pixel].moments.Add(i, j);
+          provisional_objects[pixel].ExtendBoundingBox(i, j);
+        }
         //std::cout << pixel << " ";
       }
     }
   }
 
-  // scan image again, assigning all equivalent regions the same region value.
-  int region_value[255];
-  for (int i = 0; i < 256; ++i)
-  {
-    region_value[i] = -1;
-  }
-  int new_region = 0;
-  //int new_value;
-  for (int i = 0; i < row; ++i) {
-    for (int j = 0; j < column; ++j) {
-      int pixel = equivalence_table.find(an_image->GetPixel(i,j));
-      if (pixel != 0) {
-        if (region_value[pixel] != -1) {
-          an_image->SetPixel(i,j,region_value[pixel]);
-        }
-        else if (region_value[pixel] == -1)
-        {
-          region_value[pixel] = ++new_region;
-          an_image->SetPixel(i,j,new_region);
-        }
-      }
-    }
+  // Number the regions in the order of their first pixel: provisional
+  // labels were created in raster order and every set is rooted at its
+  // smallest label, so flattening the table gives that numbering.
+  std::vector<uint32_t> &region_value = workspace->region_value;
+  const int new_region = equivalence_table.Flatten(&region_value);
+  CV_METRIC(AddEquivalenceCounters(equivalence_table.counters()));
+  CV_METRIC_ADD(pixels, static_cast<uint64_t>(row) * column);
+  CV_METRIC_ADD(objects, new_region);
+  if (objects != nullptr) {
+    objects->assign(new_region + 1, ObjectFeatures());
+    for (size_t label = 1; label < provisional_objects.size(); ++label)
+      (*objects)[region_value[label]].Add(provisional_objects[label]);
   }
+
+  // scan image again, assigning all equivalent regions the same region value.
+  for (PixelSpan<uint32_t> current_row : labels.Rows())
+    for (uint32_t &pixel : current_row) pixel = region_value[pixel];
   //PrintImageToCout(an_image);
-  //equivalence_table.Print();
   //cout << "Number of objects: " << new_region << endl;
+  an_image->SetDepth(DepthForMaxValue(new_region), &workspace->scratch);
   an_image->SetNumberGrayLevels(new_region);
 }
 
@@ -407,154 +380,245 @@ void RasterScan(Image *an_image) {
  * ComputeObjectAttributes( ) computes attributes that serve as object model
  * database. Atrributes include object label, row position of the center,
  * column position of the center, the minimum moment of inertia,
- * and the orientation
+ * the orientation, the roundness, the area and the bounding box aspect
  * 
  * @param {ostream} output_file: the output database file containing attributes
  * @param {Image} an_image: input image
+ * @param {FrameArena} arena: optional buffers kept across frames
+ * @param {Image} overlay: optional image drawn on instead of an_image
  */
-void ComputeObjectAttributes(std::ostream &output_file, Image *an_image) {
-  size_t number_of_obects = an_image->GetNumberGrayLevels();
-  std::vector<int> area(number_of_obects+1, 0);
-  std::vector<int> x_axis(number_of_obects+1, 0);
-  std::vector<int> y_axis(number_of_obects+1, 0);
-  std::vector<int> x_axis_squared(number_of_obects+1, 0);
-  std::vector<int> y_axis_squared(number_of_obects+1, 0);
-  std::vector<int> xy(number_of_obects+1, 0);
-
-  int row = an_image->GetNumberOfRows();
-  int column = an_image->GetNumberOfColumns();
-  for (int i = 0; i < row; ++i) {
-    for (int j = 0; j < column; ++j) {
-      int pixel = an_image->GetPixel(i,j);
-      if (pixel != 0) {
-        area[pixel] += 1;
-        x_axis[pixel] += i;
-        y_axis[pixel] += j;
-        x_axis_squared[pixel] += i*i;
-        y_axis_squared[pixel] += j*j;
-        xy[pixel] += i*j;
-      }
-    }
+void ComputeObjectAttributes(std::ostream &output_file, Image *an_image,
+                             FrameArena *arena, Image *overlay) {
+  if (an_image == nullptr) abort();
+  if (arena == nullptr) {
+    FrameArena local_arena;
+    ComputeObjectAttributes(output_file, an_image, &local_arena, overlay);
+    return;
   }
-  // header
-  output_file << "object label | " 
-              << "row position of the center | " 
-              << "column position of the center | " 
-              << "minimum moment of inertia | " 
-              << "orientation" << endl;
-
-  for (int i = 1; i < number_of_obects+1; ++i) {
-    // get the area and center of objects
-    // center of the object (x, y)
-    // x = (1/A)∑∑i bij
-    // y = (1/A)∑∑j bij
-    double x_pos_of_center = x_axis[i] / area[i];
-    double y_pos_of_center = y_axis[i] / area[i];
-
-    // calculate a, b and c using the formulas from the slides
-    // a = ∫∫(x')^2 b(x, y)dx'dy'
-    double a = x_axis_squared[i] - (area[i] * x_pos_of_center * x_pos_of_center);
-    // 2∫∫(x'y') b(x, y)dx'dy'
-    double b = 2 * (xy[i] - (area[i] * x_pos_of_center * y_pos_of_center));
-    // c = ∫∫(y')2b(x, y)dx'dy'
-    double c = y_axis_squared[i] - (area[i] * y_pos_of_center * y_pos_of_center);
-    
-    // Arc tangent of two numbers
-    // The result is an angle expressed in radians. 
-    // To convert from radians to degrees, divide by 2
-    // 2 x Pi radians = 360 degrees.
-    double theta = atan2(b,a-c) / 2;
-    // calculate E by using all the information obtained above
-    // E = a sin^2(θ) − b sin(θ) cos(θ) + c cos^2(θ)
-    double min_moment_of_inertia = a*sin(theta)*sin(theta) - b*sin(theta)*cos(theta) + c*cos(theta)*cos(theta);
+  CV_METRIC_STAGE(kMetricMeasure);
+  MeasureOptions options;
+  options.features = MomentFeatures::kSecondMoments | MomentFeatures::kBoundingBox;
+  MeasureObjects(*an_image, options, &arena->objects, &arena->partial_objects);
+  WriteObjectAttributes(output_file, arena->objects,
+                        overlay != nullptr ? overlay : an_image, arena);
+}
 
-    int endpoint_x = x_pos_of_center + cos(theta)*50;
-    int endpoint_y = y_pos_of_center + sin(theta)*50; 
-    DrawLine(x_pos_of_center, y_pos_of_center, endpoint_x, endpoint_y, 200, an_image);
+/**
+ * WriteObjectAttributes( ) writes the database of objects whose moments
+ * and bounding boxes are already known, e.g. from the fused
+ * RasterScan( ), and draws their orientation on the image.
+ * 
+ * @param {ostream} output_file: the output database file containing attributes
+ * @param {vector} objects: features of objects 1..n, index 0 unused
+ * @param {Image} an_image: image to draw the orientation lines on
+ * @param {FrameArena} arena: optional buffers kept across frames
+ */
+void WriteObjectAttributes(std::ostream &output_file,
+                           const std::vector<ObjectFeatures> &objects,
+                           Image *an_image, FrameArena *arena) {
+  if (arena == nullptr) {
+    FrameArena local_arena;
+    WriteObjectAttributes(output_file, objects, an_image, &local_arena);
+    return;
+  }
+  ComputeObjectModels(objects, &arena->models, an_image, arena);
+  WriteObjectDatabase(output_file, arena->models);
+}
 
-    output_file << i << " " << x_pos_of_center << " " << y_pos_of_center << " " << min_moment_of_inertia << " " << theta << endl;
+/**
+ * ComputeObjectModels( ) computes the model record of each object and
+ * draws its orientation on the image.
+ * 
+ * @param {vector} objects: features of objects 1..n, index 0 unused
+ * @param {vector} models: receives the model of object i at i - 1
+ * @param {Image} an_image: image to draw the orientation lines on
+ * @param {FrameArena} arena: optional buffers kept across frames
+ */
+void ComputeObjectModels(const std::vector<ObjectFeatures> &objects,
+                         std::vector<ModelRecord> *models, Image *an_image,
+                         FrameArena *arena) {
+  if (models == nullptr) abort();
+  if (arena == nullptr) {
+    FrameArena local_arena;
+    ComputeObjectModels(objects, models, an_image, &local_arena);
+    return;
+  }
+  CV_METRIC_STAGE(kMetricMeasure);
+  InertiaBatch &batch = arena->inertia;
+  LoadInertiaBatch(objects, &batch);
+  ComputeInertia(&batch, true);
+  // the orientation lines are drawn together once the models are known
+  OverlayBatch &annotations = arena->annotations;
+  annotations.Clear();
+  models->clear();
+  for (size_t i = 1; i < batch.size(); ++i) {
+    ModelRecord model;
+    model.label = i;
+    model.row_center = batch.row_center[i];
+    model.column_center = batch.column_center[i];
+    model.min_inertia = batch.min_inertia[i];
+    model.orientation = batch.orientation[i];
+    model.roundness = Roundness(batch, i);
+    model.area = objects[i].moments.area;
+    model.aspect = BoundingBoxAspect(objects[i]);
+    models->push_back(model);
+
+    int endpoint_x = model.row_center + cos(model.orientation)*50;
+    int endpoint_y = model.column_center + sin(model.orientation)*50;
+    annotations.AddSegment(model.row_center, model.column_center, endpoint_x, endpoint_y, 200);
   }
+  annotations.Render(an_image);
 }
 
 /**
  * CompareObjectAttributes( ) compares the attributes of each object in a
- * labeled image file with those from the object model database.
+ * labeled image file with those from the object model database, with the
+ * default MatchOptions.
  * 
  * @param {istream} database_file: database file containing attributes
  * @param {Image} an_image: input image
  */
 void CompareObjectAttributes(istream &database_file, Image *an_image) {
-  size_t number_of_obects = an_image->GetNumberGrayLevels();
-  std::vector<int> area(number_of_obects+1, 0);
-  std::vector<int> x_axis(number_of_obects+1, 0);
-  std::vector<int> y_axis(number_of_obects+1, 0);
-  std::vector<int> x_axis_squared(number_of_obects+1, 0);
-  std::vector<int> y_axis_squared(number_of_obects+1, 0);
-  std::vector<int> xy(number_of_obects+1, 0);
+  CV_METRIC_STAGE(kMetricMatch);
+  std::vector<ModelRecord> models;
+  if (!ReadObjectDatabase(database_file, &models)) return;
+  ObjectIndex index;
+  index.Build(models, MatchOptions());
+  std::vector<std::vector<ObjectMatch>> matches;
+  CompareObjectAttributes(index, an_image, &matches);
+}
 
-  int row = an_image->GetNumberOfRows();
-  int column = an_image->GetNumberOfColumns();
-  for (int i = 0; i < row; ++i) {
-    for (int j = 0; j < column; ++j) {
-      int pixel = an_image->GetPixel(i,j);
-      if (pixel != 0) {
-        area[pixel] += 1;
-        x_axis[pixel] += i;
-        y_axis[pixel] += j;
-        x_axis_squared[pixel] += i*i;
-        y_axis_squared[pixel] += j*j;
-        xy[pixel] += i*j;
-      }
-    }
+/**
+ * CompareObjectAttributes( ) measures every object of a labeled image
+ * once, looks up its nearest models in index and draws the orientation
+ * of the objects that match at least one model.
+ * 
+ * @param {ObjectIndex} index: the object model database
+ * @param {Image} an_image: input image
+ * @param {vector} matches: matches[i] receives the matches of object i
+ * @param {FrameArena} arena: optional buffers kept across frames
+ * @param {Image} overlay: optional image drawn on instead of an_image
+ */
+void CompareObjectAttributes(const ObjectIndex &index, Image *an_image,
+                             std::vector<std::vector<ObjectMatch>> *matches,
+                             FrameArena *arena, Image *overlay) {
+  if (an_image == nullptr) abort();
+  if (arena == nullptr) {
+    FrameArena local_arena;
+    CompareObjectAttributes(index, an_image, matches, &local_arena, overlay);
+    return;
   }
+  CV_METRIC_STAGE(kMetricMatch);
+  AccumulateMoments(*an_image, &arena->moments, &arena->objects,
+                    &arena->partial_objects);
+  InertiaBatch &batch = arena->inertia;
+  LoadInertiaBatch(arena->moments, &batch);
+  // the orientation is only needed for the objects that match
+  ComputeInertia(&batch, false);
+  MatchObjects(index, batch, matches);
+  arena->annotations.Clear();
+  AnnotateMatchedObjects(batch, *matches, &arena->annotations);
+  arena->annotations.Render(overlay != nullptr ? overlay : an_image);
+}
 
-  string header;
-  getline(database_file, header);
-  int database_object_label, database_row_center, database_column_center;
-  double database_inertia, database_orientation;
-  while(database_file.good()) {
-    database_file >> database_object_label
-                  >> database_row_center 
-                  >> database_column_center
-                  >> database_inertia
-                  >> database_orientation;
-
-    for (int i = 1; i < number_of_obects+1; ++i) {
-      // get the area and center of objects
-      // center of the object (x, y)
-      // x = (1/A)∑∑i bij
-      // y = (1/A)∑∑j bij
-      double x_pos_of_center = x_axis[i] / area[i];
-      double y_pos_of_center = y_axis[i] / area[i];
-
-      // calculate a, b and c using the formulas from the slides
-      // a = ∫∫(x')^2 b(x, y)dx'dy'
-      double a = x_axis_squared[i] - (area[i] * x_pos_of_center * x_pos_of_center);
-      // 2∫∫(x'y') b(x, y)dx'dy'
-      double b = 2 * (xy[i] - (area[i] * x_pos_of_center * y_pos_of_center));
-      // c = ∫∫(y')2b(x, y)dx'dy'
-      double c = y_axis_squared[i] - (area[i] * y_pos_of_center * y_pos_of_center);
-      
-      // Arc tangent of two numbers
-      // The result is an angle expressed in radians. 
-      // To convert from radians to degrees, divide by 2
-      // 2 x Pi radians = 360 degrees.
-      double theta = atan2(b,a-c) / 2;
-      // calculate E by using all the information obtained above
-      // E = a sin^2(θ) − b sin(θ) cos(θ) + c cos^2(θ)
-      double min_moment_of_inertia = a*sin(theta)*sin(theta) - b*sin(theta)*cos(theta) + c*cos(theta)*cos(theta);
-
-      double smaller_number = min(min_moment_of_inertia, database_inertia);
-      double larger_number = max(min_moment_of_inertia, database_inertia);
-      double compare_inertia = smaller_number / larger_number;
-      double threshold = 0.8;
-
-      if (compare_inertia > 0.8) {
-        int endpoint_x = x_pos_of_center + cos(theta)*50;
-        int endpoint_y = y_pos_of_center + sin(theta)*50; 
-        DrawLine(x_pos_of_center, y_pos_of_center, endpoint_x, endpoint_y, 200, an_image);
-      }
-    }
+/**
+ * CompareObjectAttributes( ) matches every object of a labeled image
+ * against the models with the cascade of matcher, adds the number of
+ * candidates each stage rejected to counters, and draws the orientation
+ * of the objects that match at least one model.
+ * 
+ * @param {CascadeMatcher} matcher: the object model database
+ * @param {Image} an_image: input image
+ * @param {vector} matches: matches[i] receives the matches of object i
+ * @param {CascadeCounters} counters: per-stage rejection counters
+ * @param {FrameArena} arena: optional buffers kept across frames
+ * @param {Image} overlay: optional image drawn on instead of an_image
+ */
+void CompareObjectAttributes(const CascadeMatcher &matcher, Image *an_image,
+                             std::vector<std::vector<ObjectMatch>> *matches,
+                             CascadeCounters *counters, FrameArena *arena,
+                             Image *overlay) {
+  if (an_image == nullptr) abort();
+  if (arena == nullptr) {
+    FrameArena local_arena;
+    CompareObjectAttributes(matcher, an_image, matches, counters,
+                            &local_arena, overlay);
+    return;
+  }
+  CV_METRIC_STAGE(kMetricMatch);
+  MeasureOptions options;
+  options.features = MomentFeatures::kSecondMoments | MomentFeatures::kBoundingBox;
+  MeasureObjects(*an_image, options, &arena->objects, &arena->partial_objects);
+  InertiaBatch &batch = arena->inertia;
+  LoadInertiaBatch(arena->objects, &batch);
+  ComputeInertia(&batch, false);
+  MatchObjects(matcher, arena->objects, batch, matches, counters);
+  arena->annotations.Clear();
+  AnnotateMatchedObjects(batch, *matches, &arena->annotations);
+  arena->annotations.Render(overlay != nullptr ? overlay : an_image);
+}
+
+/**
+ * DrawMatchedObjects( ) draws the orientation of every object of a batch
+ * that matched at least one model.
+ * 
+ * @param {InertiaBatch} batch: the objects, entry 0 unused
+ * @param {vector} matches: matches[i] holds the matches of object i
+ * @param {Image} an_image: image to draw on
+ */
+void DrawMatchedObjects(const InertiaBatch &batch,
+                        const std::vector<std::vector<ObjectMatch>> &matches,
+                        Image *an_image) {
+  OverlayBatch annotations;
+  AnnotateMatchedObjects(batch, matches, &annotations);
+  annotations.Render(an_image);
+}
+
+/**
+ * AnnotateMatchedObjects( ) adds the orientation line of every object of
+ * a batch that matched at least one model to annotations, to be drawn
+ * with the rest of the frame's annotations.
+ * 
+ * @param {InertiaBatch} batch: the objects, entry 0 unused
+ * @param {vector} matches: matches[i] holds the matches of object i
+ * @param {OverlayBatch} annotations: receives the lines
+ */
+void AnnotateMatchedObjects(const InertiaBatch &batch,
+                            const std::vector<std::vector<ObjectMatch>> &matches,
+                            OverlayBatch *annotations) {
+  if (annotations == nullptr) abort();
+  for (size_t i = 1; i < batch.size(); ++i) {
+    if (matches[i].empty()) continue;
+    double x_pos_of_center = batch.row_center[i];
+    double y_pos_of_center = batch.column_center[i];
+    double theta = InertiaOrientation(batch.a[i], batch.b[i], batch.c[i]);
+    int endpoint_x = x_pos_of_center + cos(theta)*50;
+    int endpoint_y = y_pos_of_center + sin(theta)*50; 
+    annotations->AddSegment(x_pos_of_center, y_pos_of_center, endpoint_x, endpoint_y, 200);
+  }
+}
+
+/**
+ * AnnotateObjects( ) adds a centroid marker and the bounding box of
+ * every object to annotations.
+ * 
+ * @param {vector} objects: features of objects 1..n, index 0 unused,
+ *                 measured with kCentroid and kBoundingBox
+ * @param {int} color: gray level of the marks
+ * @param {OverlayBatch} annotations: receives the marks
+ */
+void AnnotateObjects(const std::vector<ObjectFeatures> &objects, int color,
+                     OverlayBatch *annotations) {
+  if (annotations == nullptr) abort();
+  for (size_t i = 1; i < objects.size(); ++i) {
+    const ObjectFeatures &object = objects[i];
+    if (object.moments.area == 0) continue;
+    // The centroid is rounded to the nearest pixel, not truncated.
+    const double area = object.moments.area;
+    annotations->AddMarker(lround(object.moments.sum_row / area),
+                           lround(object.moments.sum_column / area), 2, color);
+    annotations->AddBox(object.min_row, object.min_column, object.max_row,
+                        object.max_column, color);
   }
 }
 
@@ -5,13 +5,172 @@
 #ifndef COMPUTER_VISION_IMAGE_H_
 #define COMPUTER_VISION_IMAGE_H_
 
+#include <cstdint>
 #include <cstdlib>
 #include <string>
 #include <fstream>
+#include <vector>
 
 namespace ComputerVisionProjects {
- 
+
+class GrayHistogram;
+struct ObjectFeatures;
+class ObjectIndex;
+class CascadeMatcher;
+struct CascadeCounters;
+struct InertiaBatch;
+struct ObjectMatch;
+struct ModelRecord;
+struct RasterScanWorkspace;
+struct FrameArena;
+class OverlayBatch;
+
+// Storage width of a single pixel. Gray-level input is kept in 8 bits,
+// label images widen to 16 or 32 bits as the number of labels grows.
+enum class PixelDepth { kUint8 = 1, kUint16 = 2, kUint32 = 4 };
+
+// Bounds checking of the span accessors below, picked at compile time.
+// CheckedBounds aborts on an index out of range, UncheckedBounds
+// compiles to nothing. DefaultBounds checks unless NDEBUG is defined:
+// the -g programs of make all check, make all RELEASE=1 and make bench
+// do not. GetPixel( ) and SetPixel( ) check in every build.
+struct CheckedBounds {
+  static void Check(size_t index, size_t size) {
+    if (index >= size) abort();
+  }
+};
+
+struct UncheckedBounds {
+  static void Check(size_t, size_t) { }
+};
+
+#ifdef NDEBUG
+typedef UncheckedBounds DefaultBounds;
+#else
+typedef CheckedBounds DefaultBounds;
+#endif
+
+// Non-owning view of the pixels of one row. begin( ) and end( ) are
+// plain pointers, so a range-for over a span is a loop the compiler can
+// vectorize; operator[] checks the column with Bounds.
+//
+// Example:
+//   for (uint8_t &pixel : an_image->Span<uint8_t>(i)) pixel = pixel > 125;
+template <typename PixelType, typename Bounds = DefaultBounds>
+class PixelSpan {
+ public:
+  PixelSpan(): data_{nullptr}, size_{0} { }
+  PixelSpan(PixelType *data, size_t size): data_{data}, size_{size} { }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  PixelType *data() const { return data_; }
+  PixelType *begin() const { return data_; }
+  PixelType *end() const { return data_ + size_; }
+
+  PixelType &operator[](size_t j) const {
+    Bounds::Check(j, size_);
+    return data_[j];
+  }
+
+  // Pixels [begin, end) of the span.
+  PixelSpan Subspan(size_t begin, size_t end) const {
+    Bounds::Check(end, size_ + 1);
+    Bounds::Check(begin, end + 1);
+    return PixelSpan(data_ + begin, end - begin);
+  }
+
+ private:
+  PixelType *data_;
+  size_t size_;
+};
+
+// Non-owning typed view of a contiguous pixel buffer.
+// Rows are num_columns() pixels wide and start stride() pixels apart.
+template <typename PixelType>
+class ImagePlane {
+ public:
+  ImagePlane(): data_{nullptr}, num_rows_{0}, num_columns_{0}, stride_{0} { }
+  ImagePlane(PixelType *data, size_t num_rows, size_t num_columns,
+             size_t stride)
+      : data_{data}, num_rows_{num_rows}, num_columns_{num_columns},
+        stride_{stride} { }
+
+  size_t num_rows() const { return num_rows_; }
+  size_t num_columns() const { return num_columns_; }
+  size_t stride() const { return stride_; }
+  PixelType *data() const { return data_; }
+
+  PixelType *Row(size_t i) const { return data_ + i * stride_; }
+
+  // Row i as a span; the row, and the columns indexed through the
+  // span, are checked with Bounds.
+  template <typename Bounds = DefaultBounds>
+  PixelSpan<PixelType, Bounds> Span(size_t i) const {
+    Bounds::Check(i, num_rows_);
+    return PixelSpan<PixelType, Bounds>(Row(i), num_columns_);
+  }
+
+  // Pixel (i, j), both indices checked with Bounds.
+  template <typename Bounds = DefaultBounds>
+  PixelType &At(size_t i, size_t j) const {
+    Bounds::Check(i, num_rows_);
+    Bounds::Check(j, num_columns_);
+    return Row(i)[j];
+  }
+
+  // Iterates the rows of the plane as spans, skipping the padding at
+  // the end of each row:
+  //   for (auto row : plane.Rows()) for (auto &pixel : row) ...
+  class RowIterator {
+   public:
+    RowIterator(PixelType *row, size_t num_columns, size_t stride)
+        : row_{row}, num_columns_{num_columns}, stride_{stride} { }
+
+    PixelSpan<PixelType> operator*() const {
+      return PixelSpan<PixelType>(row_, num_columns_);
+    }
+    RowIterator &operator++() {
+      row_ += stride_;
+      return *this;
+    }
+    bool operator!=(const RowIterator &other) const {
+      return row_ != other.row_;
+    }
+
+   private:
+    PixelType *row_;
+    size_t num_columns_;
+    size_t stride_;
+  };
+
+  class RowRange {
+   public:
+    explicit RowRange(const ImagePlane &plane): plane_(plane) { }
+    RowIterator begin() const {
+      return RowIterator(plane_.data_, plane_.num_columns_, plane_.stride_);
+    }
+    RowIterator end() const {
+      return RowIterator(plane_.data_ + plane_.num_rows_ * plane_.stride_,
+                         plane_.num_columns_, plane_.stride_);
+    }
+
+   private:
+    ImagePlane plane_;
+  };
+
+  RowRange Rows() const { return RowRange(*this); }
+
+ private:
+  PixelType *data_;
+  size_t num_rows_;
+  size_t num_columns_;
+  size_t stride_;
+};
+
 // Class for representing a gray-scale image.
+// Pixels live in one 64-byte aligned buffer; each row is padded to a
+// multiple of 64 bytes so that rows start on a cache line.
 // Sample usage:
 //   Image one_image;
 //   one_image.AllocateSpaceAndSetSize(100, 200);
@@ -25,20 +184,57 @@ namespace ComputerVisionProjects {
 class Image {
  public:
   Image(): num_rows_{0}, num_columns_{0}, 
-	   num_gray_levels_{0}, pixels_{nullptr} { }
+	   num_gray_levels_{0}, depth_{PixelDepth::kUint32},
+           stride_{0}, capacity_{0}, pixels_{nullptr} { }
   
   Image(const Image &an_image);
-  Image& operator=(const Image &an_image) = delete;
+  // Takes the pixel buffer of an_image, which is left empty.
+  Image(Image &&an_image) noexcept;
+
+  // Copies the pixels of an_image into the buffer of this image, which
+  // is only reallocated when it is too small.
+  Image& operator=(const Image &an_image);
+  // Exchanges the buffers; an_image gets the old one of this image, to
+  // be reused or freed with it.
+  Image& operator=(Image &&an_image) noexcept;
 
   ~Image();
 
   // Sets the size of the image to the given
   // height (num_rows) and columns (num_columns).
-  void AllocateSpaceAndSetSize(size_t num_rows, size_t num_columns);
+  // depth is the storage width of each pixel; the default holds any int
+  // label, ReadImage() uses PixelDepth::kUint8 for gray-level input.
+  // The buffer is kept when it is large enough, so an image reused for
+  // frames of the same size allocates once. Aborts when the buffer
+  // cannot be allocated or its size does not fit in a size_t.
+  void AllocateSpaceAndSetSize(size_t num_rows, size_t num_columns,
+                               PixelDepth depth = PixelDepth::kUint32);
+
+  // Changes the storage width of the pixels, keeping their values.
+  // Narrowing truncates values that do not fit the new depth. The
+  // conversion goes through a buffer of SharedFramePool( ).
+  void SetDepth(PixelDepth depth);
+  // Same as above, converting into scratch and then trading buffers with
+  // it; a scratch image kept across calls makes the change allocation
+  // free once both buffers have grown to size.
+  void SetDepth(PixelDepth depth, Image *scratch);
+
+  // Exchanges the pixels, size and depth of the two images without
+  // copying, so that buffers can be handed between owners.
+  void Swap(Image &other);
 
   size_t num_rows() const { return num_rows_; }
   size_t num_columns() const { return num_columns_; }
   size_t num_gray_levels() const { return num_gray_levels_; }
+  PixelDepth depth() const { return depth_; }
+  // Distance between the starts of two consecutive rows, in bytes.
+  size_t stride() const { return stride_; }
+  // Bytes of the pixel buffer, which may be larger than the image.
+  size_t capacity() const { return capacity_; }
+  // Bytes of the buffer AllocateSpaceAndSetSize( ) needs for that size,
+  // SIZE_MAX when they do not fit in a size_t.
+  static size_t BufferSize(size_t num_rows, size_t num_columns,
+                           PixelDepth depth);
   void SetNumberGrayLevels(size_t gray_levels) {
     num_gray_levels_ = gray_levels;
   }
@@ -46,17 +242,70 @@ class Image {
   size_t GetNumberGrayLevels() {
     return num_gray_levels_;
   }
+
+  // Returns a typed view of the pixels. PixelType must match depth().
+  template <typename PixelType>
+  ImagePlane<PixelType> Plane() {
+    if (sizeof(PixelType) != static_cast<size_t>(depth_)) abort();
+    return ImagePlane<PixelType>(reinterpret_cast<PixelType *>(pixels_),
+                                 num_rows_, num_columns_,
+                                 stride_ / sizeof(PixelType));
+  }
+
+  template <typename PixelType>
+  ImagePlane<const PixelType> Plane() const {
+    if (sizeof(PixelType) != static_cast<size_t>(depth_)) abort();
+    return ImagePlane<const PixelType>(
+        reinterpret_cast<const PixelType *>(pixels_),
+        num_rows_, num_columns_, stride_ / sizeof(PixelType));
+  }
+
+  // Row i of the pixels as a span (see PixelSpan); PixelType must match
+  // depth() and i is checked with Bounds.
+  template <typename PixelType, typename Bounds = DefaultBounds>
+  PixelSpan<PixelType, Bounds> Span(size_t i) {
+    return Plane<PixelType>().template Span<Bounds>(i);
+  }
+
+  template <typename PixelType, typename Bounds = DefaultBounds>
+  PixelSpan<const PixelType, Bounds> Span(size_t i) const {
+    return Plane<PixelType>().template Span<Bounds>(i);
+  }
  
   // Sets the pixel in the image at row i and column j
-  // to a particular gray_level.
+  // to a particular gray_level. Always bounds checked, for callers
+  // that can not vouch for their coordinates; loops over whole rows
+  // are better written over Span( ).
   void SetPixel(size_t i, size_t j, int gray_level) {
     if (i >= num_rows_ || j >= num_columns_) abort();
-    pixels_[i][j] = gray_level;
+    unsigned char *row = pixels_ + i * stride_;
+    switch (depth_) {
+      case PixelDepth::kUint8:
+        row[j] = static_cast<uint8_t>(gray_level);
+        break;
+      case PixelDepth::kUint16:
+        reinterpret_cast<uint16_t *>(row)[j] =
+            static_cast<uint16_t>(gray_level);
+        break;
+      case PixelDepth::kUint32:
+        reinterpret_cast<uint32_t *>(row)[j] =
+            static_cast<uint32_t>(gray_level);
+        break;
+    }
   }
 
   int GetPixel(size_t i, size_t j) const {
     if (i >= num_rows_ || j >= num_columns_) abort();
-    return pixels_[i][j];
+    const unsigned char *row = pixels_ + i * stride_;
+    switch (depth_) {
+      case PixelDepth::kUint8:
+        return row[j];
+      case PixelDepth::kUint16:
+        return reinterpret_cast<const uint16_t *>(row)[j];
+      case PixelDepth::kUint32:
+        return reinterpret_cast<const uint32_t *>(row)[j];
+    }
+    return 0;
   }
 
   int GetNumberOfRows() {
@@ -73,22 +322,67 @@ class Image {
   size_t num_rows_; 
   size_t num_columns_; 
   size_t num_gray_levels_;  
-  int **pixels_;
+  PixelDepth depth_;
+  size_t stride_;
+  // Bytes allocated at pixels_, at least stride_ * num_rows_.
+  size_t capacity_;
+  unsigned char *pixels_;
 };
 
+// Calls function(plane) with the typed plane matching the depth of
+// an_image, so that a scan can be written once as a generic lambda and
+// run directly over the contiguous buffer. Returns what function returns.
+template <typename Function>
+auto VisitPlane(Image *an_image, Function function)
+    -> decltype(function(an_image->Plane<uint8_t>())) {
+  switch (an_image->depth()) {
+    case PixelDepth::kUint8:
+      return function(an_image->Plane<uint8_t>());
+    case PixelDepth::kUint16:
+      return function(an_image->Plane<uint16_t>());
+    default:
+      return function(an_image->Plane<uint32_t>());
+  }
+}
+
+// Read-only variant of the above, passing an ImagePlane<const T>.
+template <typename Function>
+auto VisitPlane(const Image &an_image, Function function)
+    -> decltype(function(an_image.Plane<uint8_t>())) {
+  switch (an_image.depth()) {
+    case PixelDepth::kUint8:
+      return function(an_image.Plane<uint8_t>());
+    case PixelDepth::kUint16:
+      return function(an_image.Plane<uint16_t>());
+    default:
+      return function(an_image.Plane<uint32_t>());
+  }
+}
+
+// Returns the narrowest depth able to hold values up to max_value.
+PixelDepth DepthForMaxValue(size_t max_value);
+
 // Reads a pgm image from file input_filename.
+// Accepts binary (P5) files with 8- or 16-bit samples and ASCII (P2)
+// files; the image depth follows the maximum gray value of the file.
 // an_image is the resulting image.
 // Returns true if  everyhing is OK, false otherwise.
 bool ReadImage(const std::string &input_filename, Image *an_image);
 
+// Same as above, also filling histogram with the gray-level histogram
+// of the image in the same pass over the pixels (see histogram.h).
+bool ReadImage(const std::string &input_filename, Image *an_image,
+               GrayHistogram *histogram);
+
 // Writes image an_iamge into the pgm file output_filename.
+// See EncodePgm() in pgm_io.h for writing to memory or other sinks.
 // Returns true if  everyhing is OK, false otherwise.
 bool WriteImage(const std::string &output_filename, const Image &an_image);
 
 //  Draws a line of given gray-level color from (x0,y0) to (x1,y1);
-//  an_image is the output_image.
-// IMPORTANT: (x0,y0) and (x1,y1) can lie outside the image 
-//   boundaries, so SetPixel() should check the coordinates passed to it.
+//  an_image is the output_image. x is the row and y the column.
+// (x0,y0) and (x1,y1) can lie outside the image boundaries: the line is
+//   clipped to the image, see DrawSegment() in overlay.h.
 void DrawLine(int x0, int y0, int x1, int y1, int color,
 	      Image *an_image);
 
@@ -109,26 +403,158 @@ void ConvertToBinary(const int threshold_value, Image *an_image);
  */
 void RasterScan(Image *an_image);
 
+/**
+ * RasterScan( ) labels the image like above and also fills objects with
+ * the raw moments and bounding box of every object, accumulated during
+ * the first pass.
+ * 
+ * @param {Image} an_image: input image
+ * @param {vector} objects: features of objects 1..n, index 0 unused
+ */
+void RasterScan(Image *an_image, std::vector<ObjectFeatures> *objects);
+
+/**
+ * RasterScan( ) labels and measures the image like above, taking every
+ * buffer it needs from workspace instead of allocating it.
+ * 
+ * @param {Image} an_image: input image
+ * @param {vector} objects: features of objects 1..n, index 0 unused
+ * @param {RasterScanWorkspace} workspace: buffers reused across calls
+ */
+void RasterScan(Image *an_image, std::vector<ObjectFeatures> *objects,
+                RasterScanWorkspace *workspace);
+
 /**
  * ComputeObjectAttributes( ) computes attributes that serve as object model
  * database. Atrributes include object label, row position of the center,
  * column position of the center, the minimum moment of inertia,
- * and the orientation
+ * the orientation, the roundness, the area and the bounding box aspect
  * 
  * @param {ostream} output_file: the output database file containing attributes
  * @param {Image} an_image: input image
+ * @param {FrameArena} arena: optional objects, partial tables and inertia
+ *                    batch, kept from one frame to the next
+ * @param {Image} overlay: optional image drawn on instead of an_image,
+ *                 e.g. an overlay plane (see overlay.h), so that the
+ *                 labels are left as they are
+ */
+void ComputeObjectAttributes(std::ostream &output_file, Image *an_image,
+                             FrameArena *arena = nullptr,
+                             Image *overlay = nullptr);
+
+/**
+ * WriteObjectAttributes( ) writes the same database as
+ * ComputeObjectAttributes( ) from objects whose second moments and
+ * bounding box are already known, and draws the orientation of the
+ * objects on an_image.
+ * 
+ * @param {ostream} output_file: the output database file containing attributes
+ * @param {vector} objects: features of objects 1..n, index 0 unused
+ * @param {Image} an_image: image to draw on
+ * @param {FrameArena} arena: optional model records and inertia batch
+ */
+void WriteObjectAttributes(std::ostream &output_file,
+                           const std::vector<ObjectFeatures> &objects,
+                           Image *an_image, FrameArena *arena = nullptr);
+
+/**
+ * ComputeObjectModels( ) computes the model record of each object, which
+ * WriteObjectAttributes( ) writes as text and the binary database stores
+ * as it is, and draws the orientation of the objects on an_image.
+ * 
+ * @param {vector} objects: features of objects 1..n, index 0 unused
+ * @param {vector} models: receives the model of object i at i - 1
+ * @param {Image} an_image: image to draw on
+ * @param {FrameArena} arena: optional inertia batch and annotations
  */
-void ComputeObjectAttributes(std::ostream &output_file, Image *an_image);
+void ComputeObjectModels(const std::vector<ObjectFeatures> &objects,
+                         std::vector<ModelRecord> *models, Image *an_image,
+                         FrameArena *arena = nullptr);
 
 /**
  * CompareObjectAttributes( ) compares the attributes of each object in a
- * labeled image file with those from the object model database.
+ * labeled image file with those from the object model database, with the
+ * default MatchOptions.
  * 
  * @param {istream} database_file: database file containing attributes
  * @param {Image} an_image: input image
  */
 void CompareObjectAttributes(std::istream &database_file, Image *an_image);
 
+/**
+ * CompareObjectAttributes( ) measures every object of a labeled image
+ * once, looks up its nearest models in index and draws the orientation
+ * of the objects that match at least one model.
+ * 
+ * @param {ObjectIndex} index: the object model database
+ * @param {Image} an_image: input image
+ * @param {vector} matches: matches[i] receives the matches of object i
+ * @param {FrameArena} arena: optional moments and inertia batch, kept
+ *                    from one frame to the next
+ * @param {Image} overlay: optional image drawn on instead of an_image
+ */
+void CompareObjectAttributes(const ObjectIndex &index, Image *an_image,
+                             std::vector<std::vector<ObjectMatch>> *matches,
+                             FrameArena *arena = nullptr,
+                             Image *overlay = nullptr);
+
+/**
+ * CompareObjectAttributes( ) matches every object of a labeled image
+ * against the models with the cascade of matcher, adds the number of
+ * candidates each stage rejected to counters, and draws the orientation
+ * of the objects that match at least one model.
+ * 
+ * @param {CascadeMatcher} matcher: the object model database
+ * @param {Image} an_image: input image
+ * @param {vector} matches: matches[i] receives the matches of object i
+ * @param {CascadeCounters} counters: per-stage rejection counters
+ * @param {FrameArena} arena: optional objects and inertia batch, kept
+ *                    from one frame to the next
+ * @param {Image} overlay: optional image drawn on instead of an_image
+ */
+void CompareObjectAttributes(const CascadeMatcher &matcher, Image *an_image,
+                             std::vector<std::vector<ObjectMatch>> *matches,
+                             CascadeCounters *counters,
+                             FrameArena *arena = nullptr,
+                             Image *overlay = nullptr);
+
+/**
+ * DrawMatchedObjects( ) draws the orientation of every object of a batch
+ * that matched at least one model.
+ * 
+ * @param {InertiaBatch} batch: the objects, entry 0 unused
+ * @param {vector} matches: matches[i] holds the matches of object i
+ * @param {Image} an_image: image to draw on
+ */
+void DrawMatchedObjects(const InertiaBatch &batch,
+                        const std::vector<std::vector<ObjectMatch>> &matches,
+                        Image *an_image);
+
+/**
+ * AnnotateMatchedObjects( ) adds the lines DrawMatchedObjects( ) draws
+ * to annotations instead, to be rendered with the rest of the frame's
+ * annotations (see overlay.h).
+ * 
+ * @param {InertiaBatch} batch: the objects, entry 0 unused
+ * @param {vector} matches: matches[i] holds the matches of object i
+ * @param {OverlayBatch} annotations: receives the lines
+ */
+void AnnotateMatchedObjects(const InertiaBatch &batch,
+                            const std::vector<std::vector<ObjectMatch>> &matches,
+                            OverlayBatch *annotations);
+
+/**
+ * AnnotateObjects( ) adds a centroid marker and the bounding box of
+ * every object to annotations.
+ * 
+ * @param {vector} objects: features of objects 1..n, index 0 unused,
+ *                 measured with kCentroid and kBoundingBox
+ * @param {int} color: gray level of the marks
+ * @param {OverlayBatch} annotations: receives the marks
+ */
+void AnnotateObjects(const std::vector<ObjectFeatures> &objects, int color,
+                     OverlayBatch *annotations);
+
 void PrintImageToCout(Image *an_image);
 
 }  // namespace ComputerVisionProjects
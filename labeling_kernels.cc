@@ -0,0 +1,301 @@
+// Connected component labeling kernels specialized at compile time on
+// connectivity, label type and input format.
+// To be used in Computer Vision class.
+
+#include "labeling_kernels.h"
+#include "binary_mask.h"
+#include "labeling_workspace.h"
+#include "metrics.h"
+#include "UnionFind.h"
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+// Input format adaptors: operator()(i, j) is true for foreground pixels.
+// Coordinates are signed so that kernels can ask for pixels outside the
+// image, which are background.
+template <typename PixelType>
+class PlaneInput {
+ public:
+  explicit PlaneInput(const ImagePlane<const PixelType> &plane)
+      : plane_(plane) { }
+
+  long num_rows() const { return plane_.num_rows(); }
+  long num_columns() const { return plane_.num_columns(); }
+
+  bool operator()(long i, long j) const {
+    if (i < 0 || j < 0 || i >= num_rows() || j >= num_columns()) return false;
+    return plane_.Row(i)[j] != 0;
+  }
+
+ private:
+  ImagePlane<const PixelType> plane_;
+};
+
+class MaskInput {
+ public:
+  explicit MaskInput(const BinaryMask &mask): mask_(mask) { }
+
+  long num_rows() const { return mask_.num_rows(); }
+  long num_columns() const { return mask_.num_columns(); }
+
+  bool operator()(long i, long j) const {
+    if (i < 0 || j < 0 || i >= num_rows() || j >= num_columns()) return false;
+    return (mask_.Row(i)[j / BinaryMask::kBitsPerWord] >>
+            (j % BinaryMask::kBitsPerWord)) & 1;
+  }
+
+ private:
+  const BinaryMask &mask_;
+};
+
+// Replaces every provisional label by its final number.
+template <typename LabelType>
+void Relabel(const vector<uint32_t> &relabel,
+             const ImagePlane<LabelType> &labels) {
+  for (PixelSpan<LabelType> row : labels.Rows())
+    for (LabelType &label : row)
+      label = static_cast<LabelType>(relabel[label]);
+}
+
+// Pixel-based two-pass labeling. Only the neighbors already visited in
+// raster order are looked at: north and west for 4-connectivity, plus
+// north-west and north-east for 8-connectivity.
+template <Connectivity kConnectivity, typename LabelType, typename Input>
+uint32_t PixelScan(const Input &input, const ImagePlane<LabelType> &labels,
+                   RasterScanWorkspace *workspace) {
+  UnionFind &equivalences = workspace->equivalence_table;
+  equivalences.Reset(0);
+  const long num_rows = input.num_rows();
+  const long num_columns = input.num_columns();
+  for (long i = 0; i < num_rows; ++i) {
+    LabelType *current_row = labels.Row(i);
+    const LabelType *previous_row = (i == 0) ? nullptr : labels.Row(i - 1);
+    for (long j = 0; j < num_columns; ++j) {
+      if (!input(i, j)) {
+        current_row[j] = 0;
+        continue;
+      }
+      const uint32_t north = (i == 0) ? 0 : previous_row[j];
+      const uint32_t west = (j == 0) ? 0 : current_row[j - 1];
+      uint32_t pixel;
+      if (kConnectivity == Connectivity::kFour) {
+        if (north == 0 && west == 0)
+          pixel = equivalences.MakeSet();
+        else if (north == 0)
+          pixel = west;
+        else if (west == 0 || west == north)
+          pixel = north;
+        else
+          pixel = equivalences.Union(west, north);
+      } else {
+        const uint32_t north_west =
+            (i == 0 || j == 0) ? 0 : previous_row[j - 1];
+        const uint32_t north_east =
+            (i == 0 || j + 1 == num_columns) ? 0 : previous_row[j + 1];
+        // North touches both upper diagonals, and north-west touches
+        // west, so those pairs are already equivalent.
+        if (north != 0) {
+          pixel = north;
+        } else if (north_west != 0) {
+          pixel = north_east == 0 ? north_west
+                                  : equivalences.Union(north_west, north_east);
+        } else if (north_east != 0) {
+          pixel = west == 0 ? north_east
+                            : equivalences.Union(north_east, west);
+        } else if (west != 0) {
+          pixel = west;
+        } else {
+          pixel = equivalences.MakeSet();
+        }
+      }
+      current_row[j] = static_cast<LabelType>(pixel);
+    }
+  }
+  vector<uint32_t> &relabel = workspace->region_value;
+  const uint32_t num_objects = equivalences.Flatten(&relabel);
+  CV_METRIC(AddEquivalenceCounters(equivalences.counters()));
+  Relabel(relabel, labels);
+  return num_objects;
+}
+
+// Block-based two-pass labeling with 8-connectivity, in the spirit of
+// BBDT (Grana et al.). With block X made of pixels o p / s t:
+//
+//        . h | i j | k        P = block above-left, Q = above,
+//        ----+-----+--        R = above-right, S = left
+//        . n | o p
+//        . r | s t
+//
+// X joins P if h and o are set, Q if one of i j and one of o p are set,
+// R if k and p are set, and S if one of n r and one of o s are set.
+template <typename LabelType, typename Input>
+uint32_t BlockScan(const Input &input, const ImagePlane<LabelType> &labels,
+                   RasterScanWorkspace *workspace) {
+  UnionFind &equivalences = workspace->equivalence_table;
+  equivalences.Reset(0);
+  const long num_rows = input.num_rows();
+  const long num_columns = input.num_columns();
+  const auto label_at = [&labels](long i, long j) -> uint32_t {
+    return labels.Row(i)[j];
+  };
+
+  for (long r = 0; r < num_rows; r += 2) {
+    for (long c = 0; c < num_columns; c += 2) {
+      const bool o = input(r, c), p = input(r, c + 1);
+      const bool s = input(r + 1, c), t = input(r + 1, c + 1);
+      uint32_t block = 0;
+      if (o || p || s || t) {
+        const bool i = input(r - 1, c), j = input(r - 1, c + 1);
+        const bool top = (o || p) && (i || j);
+        const bool top_left = o && input(r - 1, c - 1);
+        const bool top_right = p && input(r - 1, c + 2);
+        const bool n = input(r, c - 1), rr = input(r + 1, c - 1);
+        const bool left = (o || s) && (n || rr);
+
+        if (top) block = label_at(r - 1, i ? c : c + 1);
+        // h touches i, and k touches j: those blocks are already joined
+        // through Q when both pixels are set.
+        if (top_left && !(top && i)) {
+          const uint32_t other = label_at(r - 1, c - 1);
+          block = block == 0 ? other : equivalences.Union(block, other);
+        }
+        if (top_right && !(top && j)) {
+          const uint32_t other = label_at(r - 1, c + 2);
+          block = block == 0 ? other : equivalences.Union(block, other);
+        }
+        // n touches h, so S is already joined through P.
+        if (left && !(top_left && n)) {
+          const uint32_t other = label_at(n ? r : r + 1, c - 1);
+          block = block == 0 ? other : equivalences.Union(block, other);
+        }
+        if (block == 0) block = equivalences.MakeSet();
+      }
+
+      labels.Row(r)[c] = o ? block : 0;
+      if (c + 1 < num_columns) labels.Row(r)[c + 1] = p ? block : 0;
+      if (r + 1 < num_rows) {
+        labels.Row(r + 1)[c] = s ? block : 0;
+        if (c + 1 < num_columns) labels.Row(r + 1)[c + 1] = t ? block : 0;
+      }
+    }
+  }
+
+  // Blocks are created two rows at a time, which is not the raster
+  // order of pixels, so number the sets as the pixel scan meets them.
+  vector<uint32_t> &relabel = workspace->region_value;
+  const uint32_t num_objects = equivalences.Flatten(&relabel);
+  CV_METRIC(AddEquivalenceCounters(equivalences.counters()));
+  vector<uint32_t> &raster_order = workspace->raster_order;
+  raster_order.assign(num_objects + 1, 0);
+  uint32_t next_object = 0;
+  for (long i = 0; i < num_rows; ++i) {
+    LabelType *row = labels.Row(i);
+    for (long j = 0; j < num_columns; ++j) {
+      const uint32_t set = relabel[row[j]];
+      if (set == 0) continue;
+      if (raster_order[set] == 0) raster_order[set] = ++next_object;
+      row[j] = static_cast<LabelType>(raster_order[set]);
+    }
+  }
+  return num_objects;
+}
+
+template <typename LabelType, typename Input>
+uint32_t RunKernel(const Input &input, const LabelingMode &mode,
+                   const ImagePlane<LabelType> &labels,
+                   RasterScanWorkspace *workspace) {
+  if (mode.scan == ScanMethod::kBlock) {
+    if (mode.connectivity != Connectivity::kEight) abort();
+    return BlockScan(input, labels, workspace);
+  }
+  if (mode.connectivity == Connectivity::kEight)
+    return PixelScan<Connectivity::kEight>(input, labels, workspace);
+  return PixelScan<Connectivity::kFour>(input, labels, workspace);
+}
+
+// Picks the label type from the worst case number of provisional
+// labels: one per two pixels for 4-connectivity, one per 2x2 cell for
+// 8-connectivity.
+template <typename Input>
+void LabelInput(const Input &input, const LabelingMode &mode,
+                Image *labels, RasterScanWorkspace *workspace) {
+  if (labels == nullptr || workspace == nullptr) abort();
+  CV_METRIC_STAGE(kMetricLabel);
+  const size_t num_rows = input.num_rows();
+  const size_t num_columns = input.num_columns();
+  const size_t max_labels =
+      mode.connectivity == Connectivity::kFour
+          ? (num_rows * num_columns + 1) / 2
+          : ((num_rows + 1) / 2) * ((num_columns + 1) / 2);
+
+  uint32_t num_objects;
+  if (max_labels <= UINT16_MAX) {
+    labels->AllocateSpaceAndSetSize(num_rows, num_columns,
+                                    PixelDepth::kUint16);
+    num_objects = RunKernel(input, mode, labels->Plane<uint16_t>(),
+                            workspace);
+  } else {
+    labels->AllocateSpaceAndSetSize(num_rows, num_columns,
+                                    PixelDepth::kUint32);
+    num_objects = RunKernel(input, mode, labels->Plane<uint32_t>(),
+                            workspace);
+  }
+  labels->SetDepth(DepthForMaxValue(num_objects), &workspace->scratch);
+  labels->SetNumberGrayLevels(num_objects);
+  CV_METRIC_ADD(pixels, num_rows * num_columns);
+  CV_METRIC_ADD(objects, num_objects);
+}
+
+}  // namespace
+
+bool ParseLabelingMode(const string &name, LabelingMode *mode) {
+  if (mode == nullptr) abort();
+  if (name == "pixel4") {
+    mode->connectivity = Connectivity::kFour;
+    mode->scan = ScanMethod::kPixel;
+  } else if (name == "pixel8") {
+    mode->connectivity = Connectivity::kEight;
+    mode->scan = ScanMethod::kPixel;
+  } else if (name == "block") {
+    mode->connectivity = Connectivity::kEight;
+    mode->scan = ScanMethod::kBlock;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void LabelBinaryImage(const Image &an_image, const LabelingMode &mode,
+                      Image *labels) {
+  RasterScanWorkspace workspace;
+  LabelBinaryImage(an_image, mode, labels, &workspace);
+}
+
+void LabelBinaryImage(const Image &an_image, const LabelingMode &mode,
+                      Image *labels, RasterScanWorkspace *workspace) {
+  VisitPlane(an_image, [&mode, labels, workspace](auto plane) {
+    typedef typename std::remove_const<typename std::remove_pointer<
+        decltype(plane.data())>::type>::type PixelType;
+    LabelInput(PlaneInput<PixelType>(plane), mode, labels, workspace);
+  });
+}
+
+void LabelBinaryImage(const BinaryMask &mask, const LabelingMode &mode,
+                      Image *labels) {
+  RasterScanWorkspace workspace;
+  LabelBinaryImage(mask, mode, labels, &workspace);
+}
+
+void LabelBinaryImage(const BinaryMask &mask, const LabelingMode &mode,
+                      Image *labels, RasterScanWorkspace *workspace) {
+  LabelInput(MaskInput(mask), mode, labels, workspace);
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,66 @@
+// Connected component labeling kernels specialized at compile time on
+// connectivity, label type and input format.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_LABELING_KERNELS_H_
+#define COMPUTER_VISION_LABELING_KERNELS_H_
+
+#include "image.h"
+#include <string>
+
+namespace ComputerVisionProjects {
+
+class BinaryMask;
+struct RasterScanWorkspace;
+
+enum class Connectivity { kFour = 4, kEight = 8 };
+
+enum class ScanMethod {
+  // Decides one pixel at a time from its already labeled neighbors.
+  kPixel,
+  // Decides one 2x2 block at a time (8-connectivity only): the pixels of
+  // a block are always connected, so a block needs one decision and one
+  // label, and its links to the four neighboring blocks are read off a
+  // handful of pixels instead of four neighbors per pixel.
+  kBlock
+};
+
+struct LabelingMode {
+  Connectivity connectivity = Connectivity::kFour;
+  ScanMethod scan = ScanMethod::kPixel;
+};
+
+// Parses the p2 engine names pixel4, pixel8 and block into mode.
+// Returns false for anything else.
+bool ParseLabelingMode(const std::string &name, LabelingMode *mode);
+
+/**
+ * LabelBinaryImage( ) labels the non-zero pixels of an image, numbering
+ * objects in raster order of their first pixel. The kernel is picked
+ * from mode, the depth of the input and the largest provisional label
+ * the image can produce (16-bit labels when they fit, 32-bit otherwise).
+ * With Connectivity::kFour and ScanMethod::kPixel the result is the same
+ * as RasterScan( ).
+ *
+ * @param {Image} an_image: input binary image
+ * @param {LabelingMode} mode: connectivity and scan method
+ * @param {Image} labels: the resulting label image
+ */
+void LabelBinaryImage(const Image &an_image, const LabelingMode &mode,
+                      Image *labels);
+
+// Same as above, reading a bit-packed mask directly.
+void LabelBinaryImage(const BinaryMask &mask, const LabelingMode &mode,
+                      Image *labels);
+
+// Both of the above with the equivalence and relabel tables and the
+// depth change scratch taken from workspace, so that a workspace kept
+// across frames makes the labeling allocation free.
+void LabelBinaryImage(const Image &an_image, const LabelingMode &mode,
+                      Image *labels, RasterScanWorkspace *workspace);
+void LabelBinaryImage(const BinaryMask &mask, const LabelingMode &mode,
+                      Image *labels, RasterScanWorkspace *workspace);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_LABELING_KERNELS_H_
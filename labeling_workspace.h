@@ -0,0 +1,36 @@
+// Buffers RasterScan( ) needs besides the image, kept across frames.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_LABELING_WORKSPACE_H_
+#define COMPUTER_VISION_LABELING_WORKSPACE_H_
+
+#include "image.h"
+#include "object_moments.h"
+#include "UnionFind.h"
+#include <cstdint>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Everything the fused RasterScan( ) would otherwise allocate per call:
+// the equivalence table, the per provisional label features, the relabel
+// table and the image the depth changes convert through. Each one only
+// ever grows, so a workspace reused for frames of similar content stops
+// allocating after the first few. The labeling kernels and LabelRuns( )
+// take their tables from it too.
+//
+// Example:
+//   RasterScanWorkspace workspace;
+//   for (each frame) RasterScan(&frame, &objects, &workspace);
+struct RasterScanWorkspace {
+  UnionFind equivalence_table;
+  std::vector<ObjectFeatures> provisional_objects;
+  std::vector<uint32_t> region_value;
+  // Final number of each set in raster order, for the block labeling.
+  std::vector<uint32_t> raster_order;
+  Image scratch;
+};
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_LABELING_WORKSPACE_H_
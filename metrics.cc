@@ -0,0 +1,198 @@
+// Per-frame stage timers and hot-path counters, exported as JSON lines
+// or as a Prometheus-style text dump.
+// To be used in Computer Vision class.
+
+#include "metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sys/resource.h>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+// The image name as a quoted string, with quotes and backslashes
+// escaped; valid in JSON and in Prometheus label values.
+string Quoted(const string &text) {
+  string quoted(1, '"');
+  for (char c : text) {
+    if (c == '"' || c == '\\') quoted += '\\';
+    if (c == '\n')
+      quoted += "\\n";
+    else
+      quoted += c;
+  }
+  quoted += '"';
+  return quoted;
+}
+
+struct Counter {
+  const char *name;
+  uint64_t FrameMetrics::*field;
+};
+
+const Counter kCounters[] = {
+    {"pixels", &FrameMetrics::pixels},
+    {"runs", &FrameMetrics::runs},
+    {"provisional_labels", &FrameMetrics::provisional_labels},
+    {"unions", &FrameMetrics::unions},
+    {"finds", &FrameMetrics::finds},
+    {"find_steps", &FrameMetrics::find_steps},
+    {"max_find_depth", &FrameMetrics::max_find_depth},
+    {"objects", &FrameMetrics::objects},
+    {"matches", &FrameMetrics::matches},
+    {"peak_rss_bytes", &FrameMetrics::peak_rss_bytes}};
+
+}  // namespace
+
+const char *MetricStageName(size_t stage) {
+  static const char *const kNames[kNumMetricStages] = {
+      "read", "threshold", "label", "measure", "match", "write"};
+  return stage < kNumMetricStages ? kNames[stage] : "";
+}
+
+void FrameMetrics::AddEquivalences(const UnionFindCounters &counters) {
+  provisional_labels += counters.labels;
+  unions += counters.unions;
+  finds += counters.finds;
+  find_steps += counters.find_steps;
+  max_find_depth = max(max_find_depth, counters.max_find_depth);
+}
+
+void WriteFrameMetricsJson(ostream &output, const FrameMetrics &frame) {
+  char number[32];
+  output << "{\"image\":" << Quoted(frame.image) << ",\"seconds\":{";
+  for (size_t stage = 0; stage < kNumMetricStages; ++stage) {
+    snprintf(number, sizeof number, "%.9f", frame.stage_seconds[stage]);
+    output << (stage == 0 ? "\"" : ",\"") << MetricStageName(stage)
+           << "\":" << number;
+  }
+  output << "}";
+  for (const Counter &counter : kCounters)
+    output << ",\"" << counter.name << "\":" << frame.*counter.field;
+  output << "}\n";
+}
+
+void WriteFrameMetricsPrometheus(ostream &output, const FrameMetrics &frame) {
+  const string image = "image=" + Quoted(frame.image);
+  char number[32];
+  for (size_t stage = 0; stage < kNumMetricStages; ++stage) {
+    snprintf(number, sizeof number, "%.9f", frame.stage_seconds[stage]);
+    output << "cv_frame_stage_seconds{" << image << ",stage=\""
+           << MetricStageName(stage) << "\"} " << number << "\n";
+  }
+  for (const Counter &counter : kCounters)
+    output << "cv_frame_" << counter.name << "{" << image << "} "
+           << frame.*counter.field << "\n";
+}
+
+#ifdef CV_METRICS
+
+namespace {
+
+thread_local FrameMetrics *current_frame = nullptr;
+thread_local StageTimer *current_timer = nullptr;
+
+// Where the frames go, set up from the environment on first use.
+struct MetricsOutput {
+  MetricsOutput() {
+    const char *filename = getenv("CV_METRICS_FILE");
+    const char *format = getenv("CV_METRICS_FORMAT");
+    prometheus = format != nullptr && string(format) == "prometheus";
+    if (filename == nullptr || *filename == '\0') return;
+    if (string(filename) == "-") {
+      output = &cerr;
+    } else {
+      file.open(filename, ios::app);
+      if (file.fail())
+        cout << "Metrics: can't open " << filename << endl;
+      else
+        output = &file;
+    }
+  }
+
+  mutex lock;
+  ofstream file;
+  ostream *output = nullptr;
+  bool prometheus = false;
+};
+
+MetricsOutput &Output() {
+  static MetricsOutput output;
+  return output;
+}
+
+}  // namespace
+
+FrameMetrics *CurrentFrameMetrics() {
+  return current_frame;
+}
+
+FrameMetricsScope::FrameMetricsScope(FrameMetrics *frame)
+    : previous_{current_frame} {
+  current_frame = frame;
+}
+
+FrameMetricsScope::~FrameMetricsScope() {
+  current_frame = previous_;
+}
+
+StageTimer::StageTimer(MetricStage stage)
+    : frame_{current_frame}, stage_{stage}, parent_{nullptr},
+      nested_seconds_{0} {
+  if (frame_ == nullptr) return;
+  parent_ = current_timer;
+  current_timer = this;
+  start_ = chrono::steady_clock::now();
+}
+
+StageTimer::~StageTimer() {
+  if (frame_ == nullptr) return;
+  const double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start_).count();
+  frame_->stage_seconds[stage_] += seconds - nested_seconds_;
+  if (parent_ != nullptr) parent_->nested_seconds_ += seconds;
+  current_timer = parent_;
+}
+
+void AddEquivalenceCounters(const UnionFindCounters &counters) {
+  if (current_frame != nullptr) current_frame->AddEquivalences(counters);
+}
+
+bool MetricsRequested() {
+  return Output().output != nullptr;
+}
+
+void EmitFrameMetrics(FrameMetrics *frame) {
+  if (frame == nullptr) abort();
+  MetricsOutput &output = Output();
+  if (output.output == nullptr) return;
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    frame->peak_rss_bytes = static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+  lock_guard<mutex> hold(output.lock);
+  if (output.prometheus)
+    WriteFrameMetricsPrometheus(*output.output, *frame);
+  else
+    WriteFrameMetricsJson(*output.output, *frame);
+  output.output->flush();
+}
+
+ScopedFrameMetrics::ScopedFrameMetrics(const string &image)
+    : scope_(MetricsRequested() ? &frame_ : nullptr) {
+  frame_.image = image;
+}
+
+ScopedFrameMetrics::~ScopedFrameMetrics() {
+  if (CurrentFrameMetrics() == &frame_) EmitFrameMetrics(&frame_);
+}
+
+#endif  // CV_METRICS
+
+}  // namespace ComputerVisionProjects
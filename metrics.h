@@ -0,0 +1,177 @@
+// Per-frame stage timers and hot-path counters, exported as JSON lines
+// or as a Prometheus-style text dump.
+// To be used in Computer Vision class.
+//
+// Instrumentation is compiled in only with -DCV_METRICS (make all
+// METRICS=1); otherwise every CV_METRIC* statement expands to nothing
+// and ScopedFrameMetrics is empty. When compiled in, a frame is
+// recorded while a ScopedFrameMetrics lives on the calling thread, and
+// written when it ends if the environment asks for it:
+//
+//   CV_METRICS_FILE    file the frames are appended to, - for stderr
+//   CV_METRICS_FORMAT  json (default, one object per line) or prometheus
+//
+// Example:
+//   {
+//     ScopedFrameMetrics frame_metrics(input_file);
+//     ReadImage(input_file, &an_image);  // timed as the read stage
+//     RasterScan(&an_image);             // timed and counted as label
+//   }                                    // the frame is written here
+
+#ifndef COMPUTER_VISION_METRICS_H_
+#define COMPUTER_VISION_METRICS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#ifdef CV_METRICS
+#define CV_METRIC(statement) statement
+#else
+#define CV_METRIC(statement)
+#endif
+
+// Times the rest of the enclosing scope as stage.
+#define CV_METRIC_STAGE(stage) \
+  CV_METRIC(::ComputerVisionProjects::StageTimer metric_stage_timer(stage))
+
+// Adds value to counter field of the frame recorded on this thread.
+#define CV_METRIC_ADD(field, value)                                      \
+  CV_METRIC(if (::ComputerVisionProjects::FrameMetrics *frame_metrics =  \
+                    ::ComputerVisionProjects::CurrentFrameMetrics())     \
+                frame_metrics->field += (value))
+
+namespace ComputerVisionProjects {
+
+enum MetricStage {
+  kMetricRead,
+  kMetricThreshold,
+  kMetricLabel,
+  kMetricMeasure,
+  kMetricMatch,
+  kMetricWrite,
+  kNumMetricStages
+};
+
+// "read", "threshold", "label", "measure", "match" or "write".
+const char *MetricStageName(size_t stage);
+
+// Work of an equivalence table since it was last reset. Find depth is
+// the number of parent links followed before reaching the root.
+struct UnionFindCounters {
+  // provisional labels created
+  uint64_t labels = 0;
+  // unions that joined two different sets
+  uint64_t unions = 0;
+  uint64_t finds = 0;
+  uint64_t find_steps = 0;
+  uint64_t max_find_depth = 0;
+};
+
+// Everything recorded about one frame.
+struct FrameMetrics {
+  std::string image;
+  // Time spent in each stage; a stage nested in another one is taken
+  // out of the outer one, so the stages add up to the timed total.
+  double stage_seconds[kNumMetricStages] = {};
+  // Pixels the labeling scanned.
+  uint64_t pixels = 0;
+  // Runs of foreground pixels found by the run-based labelings.
+  uint64_t runs = 0;
+  uint64_t provisional_labels = 0;
+  uint64_t unions = 0;
+  uint64_t finds = 0;
+  uint64_t find_steps = 0;
+  uint64_t max_find_depth = 0;
+  // Objects found by labeling, or measured in a labeled input image.
+  uint64_t objects = 0;
+  // Object-model matches found.
+  uint64_t matches = 0;
+  // Peak resident memory of the process when the frame was written.
+  uint64_t peak_rss_bytes = 0;
+
+  void AddEquivalences(const UnionFindCounters &counters);
+};
+
+// Writes frame as one JSON object on one line.
+void WriteFrameMetricsJson(std::ostream &output, const FrameMetrics &frame);
+
+// Writes frame as Prometheus text exposition lines labeled with the image.
+void WriteFrameMetricsPrometheus(std::ostream &output,
+                                 const FrameMetrics &frame);
+
+#ifdef CV_METRICS
+
+// Frame recorded on the calling thread, or null.
+FrameMetrics *CurrentFrameMetrics();
+
+// Records into frame on the calling thread for as long as it lives.
+// Stages running a frame on several threads each open one on its own.
+class FrameMetricsScope {
+ public:
+  explicit FrameMetricsScope(FrameMetrics *frame);
+  ~FrameMetricsScope();
+
+  FrameMetricsScope(const FrameMetricsScope &) = delete;
+  FrameMetricsScope &operator=(const FrameMetricsScope &) = delete;
+
+ private:
+  FrameMetrics *previous_;
+};
+
+// Adds the time until its destruction to a stage of the current frame,
+// less the time of the timers nested in it. Costs nothing but a check
+// when no frame is recorded.
+class StageTimer {
+ public:
+  explicit StageTimer(MetricStage stage);
+  ~StageTimer();
+
+  StageTimer(const StageTimer &) = delete;
+  StageTimer &operator=(const StageTimer &) = delete;
+
+ private:
+  FrameMetrics *frame_;
+  MetricStage stage_;
+  StageTimer *parent_;
+  std::chrono::steady_clock::time_point start_;
+  double nested_seconds_;
+};
+
+// Adds the counters of an equivalence table to the current frame.
+void AddEquivalenceCounters(const UnionFindCounters &counters);
+
+// True when CV_METRICS_FILE is set.
+bool MetricsRequested();
+
+// Writes frame to CV_METRICS_FILE; safe to call from several threads.
+void EmitFrameMetrics(FrameMetrics *frame);
+
+// Records one frame on the calling thread and writes it when it goes
+// out of scope, when MetricsRequested( ).
+class ScopedFrameMetrics {
+ public:
+  explicit ScopedFrameMetrics(const std::string &image);
+  ~ScopedFrameMetrics();
+
+  ScopedFrameMetrics(const ScopedFrameMetrics &) = delete;
+  ScopedFrameMetrics &operator=(const ScopedFrameMetrics &) = delete;
+
+ private:
+  FrameMetrics frame_;
+  FrameMetricsScope scope_;
+};
+
+#else
+
+class ScopedFrameMetrics {
+ public:
+  explicit ScopedFrameMetrics(const std::string &) { }
+};
+
+#endif  // CV_METRICS
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_METRICS_H_
@@ -0,0 +1,309 @@
+// Binary, memory-mappable object model database.
+// To be used in Computer Vision class.
+
+#include "model_database.h"
+#include "metrics.h"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+const char kMagic[8] = {'C', 'V', 'M', 'O', 'D', 'E', 'L', '\0'};
+
+// Fields written by WriteModelDatabase( ), in ModelRecord member order.
+const char *const kFieldNames[] = {"label", "row_center", "column_center",
+                                   "min_inertia", "orientation",
+                                   "roundness", "area", "aspect"};
+const size_t kNumFieldNames = sizeof kFieldNames / sizeof kFieldNames[0];
+
+uint32_t Load32(const unsigned char *bytes) {
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+         (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+uint64_t Load64(const unsigned char *bytes) {
+  return Load32(bytes) | (static_cast<uint64_t>(Load32(bytes + 4)) << 32);
+}
+
+void Store32(uint32_t value, unsigned char *bytes) {
+  for (int k = 0; k < 4; ++k) bytes[k] = (value >> (8 * k)) & 0xff;
+}
+
+void Store64(uint64_t value, unsigned char *bytes) {
+  Store32(value & 0xffffffff, bytes);
+  Store32(value >> 32, bytes + 4);
+}
+
+double LoadDouble(const unsigned char *bytes) {
+  const uint64_t bits = Load64(bytes);
+  double value;
+  memcpy(&value, &bits, sizeof value);
+  return value;
+}
+
+void StoreDouble(double value, unsigned char *bytes) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof bits);
+  Store64(bits, bytes);
+}
+
+double *Member(ModelRecord *model, int member) {
+  switch (member) {
+    case 1: return &model->row_center;
+    case 2: return &model->column_center;
+    case 3: return &model->min_inertia;
+    case 4: return &model->orientation;
+    case 5: return &model->roundness;
+    case 6: return &model->area;
+    case 7: return &model->aspect;
+  }
+  return nullptr;
+}
+
+double MemberValue(const ModelRecord &model, size_t member) {
+  if (member == 0) return model.label;
+  return *Member(const_cast<ModelRecord *>(&model), member);
+}
+
+// True when [offset, offset + count * size) lies within file_size.
+bool SectionFits(uint64_t offset, uint64_t count, uint64_t size,
+                 uint64_t file_size) {
+  return offset <= file_size && count <= (file_size - offset) / size;
+}
+
+// True when the index lists each matchable model exactly once and no
+// other model, which is all the matchers built from it rely on.
+template <typename Entry>
+bool IsIndexValid(size_t num_entries, const vector<bool> &matchable,
+                  size_t num_matchable, Entry entry) {
+  if (num_entries != num_matchable) return false;
+  vector<bool> seen(matchable.size(), false);
+  for (size_t k = 0; k < num_entries; ++k) {
+    const uint32_t model = entry(k);
+    if (model >= matchable.size() || !matchable[model] || seen[model])
+      return false;
+    seen[model] = true;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool MappedModelDatabase::Open(const string &filename) {
+  Close();
+  const int descriptor = open(filename.c_str(), O_RDONLY);
+  if (descriptor < 0) {
+    cout << "MappedModelDatabase: can't open " << filename << endl;
+    return false;
+  }
+  struct stat status;
+  if (fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) &&
+      status.st_size >= static_cast<off_t>(kModelDatabaseHeaderSize)) {
+    void *address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE,
+                         descriptor, 0);
+    if (address != MAP_FAILED) {
+      data_ = static_cast<const unsigned char *>(address);
+      size_ = status.st_size;
+    }
+  }
+  close(descriptor);
+  if (data_ == nullptr) {
+    cout << "MappedModelDatabase: can't map " << filename << endl;
+    return false;
+  }
+
+  if (memcmp(data_, kMagic, sizeof kMagic) != 0 ||
+      Load32(data_ + 8) != kModelDatabaseVersion) {
+    cout << "MappedModelDatabase: " << filename
+         << " is not a version " << kModelDatabaseVersion
+         << " model database" << endl;
+    Close();
+    return false;
+  }
+  num_fields_ = Load32(data_ + 12);
+  num_models_ = Load32(data_ + 16);
+  const uint32_t record_size = Load32(data_ + 20);
+  num_tree_ = Load32(data_ + 24);
+  num_area_ = Load32(data_ + 28);
+  const uint64_t schema_offset = Load64(data_ + 32);
+  const uint64_t records_offset = Load64(data_ + 40);
+  const uint64_t tree_offset = Load64(data_ + 48);
+  const uint64_t area_offset = Load64(data_ + 56);
+  if (num_fields_ == 0 || record_size != 8 * num_fields_ ||
+      !SectionFits(schema_offset, num_fields_, kModelDatabaseFieldNameSize,
+                   size_) ||
+      !SectionFits(records_offset, num_models_, record_size, size_) ||
+      !SectionFits(tree_offset, num_tree_, 4, size_) ||
+      !SectionFits(area_offset, num_area_, 4, size_)) {
+    cout << "MappedModelDatabase: " << filename << " is truncated" << endl;
+    Close();
+    return false;
+  }
+  schema_ = data_ + schema_offset;
+  records_ = data_ + records_offset;
+  tree_ = data_ + tree_offset;
+  area_ = data_ + area_offset;
+
+  field_members_.assign(num_fields_, -1);
+  for (size_t field = 0; field < num_fields_; ++field) {
+    const string name = FieldName(field);
+    for (size_t member = 0; member < kNumFieldNames; ++member)
+      if (name == kFieldNames[member]) field_members_[field] = member;
+  }
+
+  // Models with a positive inertia are the ones the matchers index.
+  vector<bool> matchable(num_models_);
+  size_t num_matchable = 0;
+  for (size_t model = 0; model < num_models_; ++model) {
+    matchable[model] = Model(model).min_inertia > 0;
+    if (matchable[model]) ++num_matchable;
+  }
+  if (!IsIndexValid(num_tree_, matchable, num_matchable,
+                    [this](size_t k) { return tree_order(k); }) ||
+      !IsIndexValid(num_area_, matchable, num_matchable,
+                    [this](size_t k) { return area_order(k); })) {
+    cout << "MappedModelDatabase: " << filename << " has a corrupt index"
+         << endl;
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void MappedModelDatabase::Close() {
+  if (data_ != nullptr) munmap(const_cast<unsigned char *>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+  num_fields_ = num_models_ = num_tree_ = num_area_ = 0;
+  schema_ = records_ = tree_ = area_ = nullptr;
+  field_members_.clear();
+}
+
+string MappedModelDatabase::FieldName(size_t field) const {
+  const char *name = reinterpret_cast<const char *>(
+      schema_ + field * kModelDatabaseFieldNameSize);
+  return string(name, strnlen(name, kModelDatabaseFieldNameSize));
+}
+
+double MappedModelDatabase::Field(size_t model, size_t field) const {
+  return LoadDouble(records_ + (model * num_fields_ + field) * 8);
+}
+
+ModelRecord MappedModelDatabase::Model(size_t model) const {
+  ModelRecord record;
+  for (size_t field = 0; field < num_fields_; ++field) {
+    const int member = field_members_[field];
+    if (member == 0)
+      record.label = static_cast<int>(Field(model, field));
+    else if (member > 0)
+      *Member(&record, member) = Field(model, field);
+  }
+  return record;
+}
+
+uint32_t MappedModelDatabase::tree_order(size_t k) const {
+  return Load32(tree_ + 4 * k);
+}
+
+uint32_t MappedModelDatabase::area_order(size_t k) const {
+  return Load32(area_ + 4 * k);
+}
+
+void MappedModelDatabase::ToModelDatabase(ModelDatabase *database) const {
+  if (database == nullptr) abort();
+  database->models.resize(num_models_);
+  for (size_t model = 0; model < num_models_; ++model)
+    database->models[model] = Model(model);
+  database->tree_order.resize(num_tree_);
+  for (size_t k = 0; k < num_tree_; ++k)
+    database->tree_order[k] = tree_order(k);
+  database->area_order.resize(num_area_);
+  for (size_t k = 0; k < num_area_; ++k)
+    database->area_order[k] = area_order(k);
+}
+
+bool IsBinaryModelDatabase(const string &filename) {
+  ifstream file(filename, ios::binary);
+  char magic[sizeof kMagic];
+  return file.read(magic, sizeof magic) &&
+         memcmp(magic, kMagic, sizeof kMagic) == 0;
+}
+
+bool WriteModelDatabase(const string &filename,
+                        const vector<ModelRecord> &models) {
+  const vector<uint32_t> tree_order = ObjectIndex::TreeOrder(models);
+  const vector<uint32_t> area_order = CascadeMatcher::AreaOrder(models);
+  const size_t record_size = 8 * kNumFieldNames;
+  const uint64_t schema_offset = kModelDatabaseHeaderSize;
+  const uint64_t records_offset =
+      schema_offset + kNumFieldNames * kModelDatabaseFieldNameSize;
+  const uint64_t tree_offset = records_offset + models.size() * record_size;
+  const uint64_t area_offset = tree_offset + 4 * tree_order.size();
+  vector<unsigned char> bytes(area_offset + 4 * area_order.size(), 0);
+
+  unsigned char *header = bytes.data();
+  memcpy(header, kMagic, sizeof kMagic);
+  Store32(kModelDatabaseVersion, header + 8);
+  Store32(kNumFieldNames, header + 12);
+  Store32(models.size(), header + 16);
+  Store32(record_size, header + 20);
+  Store32(tree_order.size(), header + 24);
+  Store32(area_order.size(), header + 28);
+  Store64(schema_offset, header + 32);
+  Store64(records_offset, header + 40);
+  Store64(tree_offset, header + 48);
+  Store64(area_offset, header + 56);
+
+  for (size_t field = 0; field < kNumFieldNames; ++field)
+    strncpy(reinterpret_cast<char *>(bytes.data() + schema_offset +
+                                     field * kModelDatabaseFieldNameSize),
+            kFieldNames[field], kModelDatabaseFieldNameSize);
+  for (size_t model = 0; model < models.size(); ++model)
+    for (size_t field = 0; field < kNumFieldNames; ++field)
+      StoreDouble(MemberValue(models[model], field),
+                  bytes.data() + records_offset + model * record_size +
+                      8 * field);
+  for (size_t k = 0; k < tree_order.size(); ++k)
+    Store32(tree_order[k], bytes.data() + tree_offset + 4 * k);
+  for (size_t k = 0; k < area_order.size(); ++k)
+    Store32(area_order[k], bytes.data() + area_offset + 4 * k);
+
+  ofstream file(filename, ios::binary);
+  if (!file.write(reinterpret_cast<const char *>(bytes.data()),
+                  bytes.size())) {
+    cout << "WriteModelDatabase: can't write " << filename << endl;
+    return false;
+  }
+  return true;
+}
+
+bool LoadModelDatabase(const string &filename, ModelDatabase *database) {
+  if (database == nullptr) abort();
+  CV_METRIC_STAGE(kMetricRead);
+  if (IsBinaryModelDatabase(filename)) {
+    MappedModelDatabase mapped;
+    if (!mapped.Open(filename)) return false;
+    mapped.ToModelDatabase(database);
+    return true;
+  }
+  ifstream file(filename);
+  if (file.fail()) {
+    cout << "LoadModelDatabase: can't open " << filename << endl;
+    return false;
+  }
+  if (!ReadObjectDatabase(file, &database->models)) return false;
+  database->tree_order = ObjectIndex::TreeOrder(database->models);
+  database->area_order = CascadeMatcher::AreaOrder(database->models);
+  return true;
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,127 @@
+// Binary, memory-mappable object model database.
+// To be used in Computer Vision class.
+//
+// Layout, all integers and floats little-endian:
+//
+//   offset  0  char[8]   magic "CVMODEL\0"
+//           8  uint32    format version (kModelDatabaseVersion)
+//          12  uint32    number of fields per record
+//          16  uint32    number of models
+//          20  uint32    record size in bytes (8 * number of fields)
+//          24  uint32    number of entries of the tree index
+//          28  uint32    number of entries of the area index
+//          32  uint64    offset of the schema
+//          40  uint64    offset of the records
+//          48  uint64    offset of the tree index
+//          56  uint64    offset of the area index
+//
+//   schema       one 16-byte NUL-padded field name per field
+//   records      one float64 per field per model, in schema order
+//   tree index   uint32 model indices in ObjectIndex::TreeOrder( )
+//   area index   uint32 model indices in CascadeMatcher::AreaOrder( )
+
+#ifndef COMPUTER_VISION_MODEL_DATABASE_H_
+#define COMPUTER_VISION_MODEL_DATABASE_H_
+
+#include "object_matcher.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+const uint32_t kModelDatabaseVersion = 1;
+const size_t kModelDatabaseHeaderSize = 64;
+const size_t kModelDatabaseFieldNameSize = 16;
+
+// Models together with the orders the matchers are built in.
+struct ModelDatabase {
+  std::vector<ModelRecord> models;
+  std::vector<uint32_t> tree_order;
+  std::vector<uint32_t> area_order;
+};
+
+// A binary database mapped read-only; records are read in place.
+//
+// Example:
+//   MappedModelDatabase database;
+//   if (database.Open("two_objects_database.cvdb")) {
+//     ModelRecord model = database.Model(0);
+//   }
+class MappedModelDatabase {
+ public:
+  MappedModelDatabase(): data_{nullptr}, size_{0} { }
+  ~MappedModelDatabase() { Close(); }
+
+  MappedModelDatabase(const MappedModelDatabase &) = delete;
+  MappedModelDatabase &operator=(const MappedModelDatabase &) = delete;
+
+  // Maps filename and checks its header, schema and index sections,
+  // including that each index lists every model with a positive inertia
+  // once and nothing else. The layout of the indices is taken as
+  // WriteModelDatabase( ) wrote it and not checked again.
+  // Returns false (with a message) for anything but a valid database.
+  bool Open(const std::string &filename);
+  void Close();
+
+  size_t size() const { return num_models_; }
+  size_t num_fields() const { return num_fields_; }
+  std::string FieldName(size_t field) const;
+
+  // Field field of model model.
+  double Field(size_t model, size_t field) const;
+  // Model model, with -1 for the optional features the schema lacks.
+  ModelRecord Model(size_t model) const;
+
+  uint32_t tree_order(size_t k) const;
+  size_t tree_order_size() const { return num_tree_; }
+  uint32_t area_order(size_t k) const;
+  size_t area_order_size() const { return num_area_; }
+
+  // Copies the models and index sections out of the mapping, for the
+  // matchers to build on as they are.
+  void ToModelDatabase(ModelDatabase *database) const;
+
+ private:
+  const unsigned char *data_;
+  size_t size_;
+  size_t num_fields_ = 0;
+  size_t num_models_ = 0;
+  size_t num_tree_ = 0;
+  size_t num_area_ = 0;
+  const unsigned char *schema_ = nullptr;
+  const unsigned char *records_ = nullptr;
+  const unsigned char *tree_ = nullptr;
+  const unsigned char *area_ = nullptr;
+  // ModelRecord member each schema field goes to, -1 for unknown names.
+  std::vector<int> field_members_;
+};
+
+// True when filename starts with the binary database magic.
+bool IsBinaryModelDatabase(const std::string &filename);
+
+/**
+ * WriteModelDatabase( ) writes models in the binary format, with both
+ * index sections prebuilt.
+ *
+ * @param {string} filename: output file
+ * @param {vector} models: the models
+ * @return false (with a message) when the file cannot be written
+ */
+bool WriteModelDatabase(const std::string &filename,
+                        const std::vector<ModelRecord> &models);
+
+/**
+ * LoadModelDatabase( ) loads a text or binary database, telling them
+ * apart by the magic. Index orders of a text database are computed.
+ *
+ * @param {string} filename: database written by p3 or db_convert
+ * @param {ModelDatabase} database: the models and index orders
+ * @return false (with a message) when the file cannot be read
+ */
+bool LoadModelDatabase(const std::string &filename, ModelDatabase *database);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_MODEL_DATABASE_H_
@@ -0,0 +1,343 @@
+// Object model database and nearest-model matching of scene objects.
+// To be used in Computer Vision class.
+
+#include "object_matcher.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+bool ReadObjectDatabase(istream &database_file, vector<ModelRecord> *models) {
+  if (models == nullptr) abort();
+  models->clear();
+  string line;
+  // header
+  getline(database_file, line);
+  while (getline(database_file, line)) {
+    istringstream fields(line);
+    ModelRecord model;
+    if (!(fields >> model.label)) continue;  // blank line
+    if (!(fields >> model.row_center >> model.column_center
+                 >> model.min_inertia >> model.orientation)) {
+      cout << "ReadObjectDatabase: malformed line " << line << endl;
+      return false;
+    }
+    if (!(fields >> model.roundness)) model.roundness = -1;
+    if (!(fields >> model.area)) model.area = -1;
+    if (!(fields >> model.aspect)) model.aspect = -1;
+    models->push_back(model);
+  }
+  return true;
+}
+
+double Roundness(const InertiaBatch &batch, size_t k) {
+  return batch.max_inertia[k] > 0 ? batch.min_inertia[k] / batch.max_inertia[k]
+                                  : 0;
+}
+
+namespace {
+
+// Raw features of a model for laying out the k-d tree: log inertia and
+// roundness (-1 when unknown).
+typedef std::array<double, ObjectIndex::kNumFeatures> RawFeatures;
+
+RawFeatures ModelFeatures(const ModelRecord &model) {
+  return RawFeatures{{log(model.min_inertia), model.roundness}};
+}
+
+void LayOutSubtree(vector<pair<RawFeatures, uint32_t>> *nodes, size_t begin,
+                   size_t end, size_t depth) {
+  if (end - begin <= 1) return;
+  const size_t feature = depth % ObjectIndex::kNumFeatures;
+  const size_t middle = begin + (end - begin) / 2;
+  nth_element(nodes->begin() + begin, nodes->begin() + middle,
+              nodes->begin() + end,
+              [feature](const pair<RawFeatures, uint32_t> &x,
+                        const pair<RawFeatures, uint32_t> &y) {
+                return x.first[feature] < y.first[feature];
+              });
+  LayOutSubtree(nodes, begin, middle, depth + 1);
+  LayOutSubtree(nodes, middle + 1, end, depth + 1);
+}
+
+}  // namespace
+
+const char kObjectDatabaseHeader[] =
+    "object label | row position of the center | "
+    "column position of the center | minimum moment of inertia | "
+    "orientation | roundness | area | bounding box aspect";
+
+void WriteObjectDatabase(ostream &database_file,
+                         const vector<ModelRecord> &models) {
+  database_file << kObjectDatabaseHeader << endl;
+  for (const ModelRecord &model : models) {
+    database_file << model.label << " " << model.row_center << " "
+                  << model.column_center << " " << model.min_inertia << " "
+                  << model.orientation;
+    if (model.roundness >= 0) {
+      database_file << " " << model.roundness;
+      if (model.area >= 0) {
+        database_file << " " << static_cast<long long>(model.area);
+        if (model.aspect >= 0) database_file << " " << model.aspect;
+      }
+    }
+    database_file << endl;
+  }
+}
+
+vector<uint32_t> ObjectIndex::TreeOrder(const vector<ModelRecord> &models) {
+  vector<pair<RawFeatures, uint32_t>> nodes;
+  for (size_t m = 0; m < models.size(); ++m) {
+    if (!(models[m].min_inertia > 0)) continue;
+    nodes.push_back({ModelFeatures(models[m]), static_cast<uint32_t>(m)});
+  }
+  LayOutSubtree(&nodes, 0, nodes.size(), 0);
+  vector<uint32_t> order(nodes.size());
+  for (size_t k = 0; k < nodes.size(); ++k) order[k] = nodes[k].second;
+  return order;
+}
+
+void ObjectIndex::Build(const vector<ModelRecord> &models,
+                        const MatchOptions &options) {
+  Build(models, options, TreeOrder(models));
+}
+
+void ObjectIndex::Build(const vector<ModelRecord> &models,
+                        const MatchOptions &options,
+                        const vector<uint32_t> &tree_order) {
+  options_ = options;
+  use_roundness_ = options.roundness_tolerance > 0 && !models.empty();
+  for (const ModelRecord &model : models)
+    if (model.roundness < 0) use_roundness_ = false;
+
+  // Without roundness every node has 0 as second feature, and the
+  // search simply looks on both sides of those splits.
+  nodes_.clear();
+  for (uint32_t m : tree_order) {
+    Node node;
+    node.model = m;
+    if (Normalize(models[m].min_inertia, models[m].roundness, &node.features))
+      nodes_.push_back(node);
+  }
+}
+
+bool ObjectIndex::Normalize(double min_inertia, double roundness,
+                            FeatureVector *features) const {
+  if (!(min_inertia > 0)) return false;
+  // ratio > inertia_ratio  <=>  |log E - log E'| < -log(inertia_ratio)
+  (*features)[0] = log(min_inertia) / -log(options_.inertia_ratio);
+  (*features)[1] = use_roundness_ ? roundness / options_.roundness_tolerance
+                                  : 0;
+  return true;
+}
+
+void ObjectIndex::SearchSubtree(size_t begin, size_t end, size_t depth,
+                                const FeatureVector &features,
+                                vector<ObjectMatch> *best) const {
+  if (begin >= end) return;
+  const size_t feature = depth % kNumFeatures;
+  const size_t middle = begin + (end - begin) / 2;
+  const Node &node = nodes_[middle];
+
+  // Every feature must be within tolerance, i.e. closer than 1.
+  double squared_distance = 0;
+  bool within_tolerance = true;
+  for (size_t f = 0; f < kNumFeatures; ++f) {
+    const double difference = features[f] - node.features[f];
+    if (fabs(difference) >= 1) within_tolerance = false;
+    squared_distance += difference * difference;
+  }
+  const size_t k = options_.max_matches;
+  if (within_tolerance &&
+      (best->size() < k || squared_distance < best->back().distance)) {
+    ObjectMatch match{node.model, squared_distance};
+    // make room first, so best never holds more than k matches
+    if (best->size() == k) best->pop_back();
+    auto position = upper_bound(
+        best->begin(), best->end(), match,
+        [](const ObjectMatch &x, const ObjectMatch &y) {
+          return x.distance < y.distance;
+        });
+    best->insert(position, match);
+  }
+
+  const double split = features[feature] - node.features[feature];
+  const bool left_first = split < 0;
+  if (left_first)
+    SearchSubtree(begin, middle, depth + 1, features, best);
+  else
+    SearchSubtree(middle + 1, end, depth + 1, features, best);
+  // The other side only holds models at least |split| away in feature.
+  if (fabs(split) < 1 &&
+      (best->size() < k || split * split < best->back().distance)) {
+    if (left_first)
+      SearchSubtree(middle + 1, end, depth + 1, features, best);
+    else
+      SearchSubtree(begin, middle, depth + 1, features, best);
+  }
+}
+
+void ObjectIndex::FindNearest(const FeatureVector &features,
+                              vector<ObjectMatch> *matches) const {
+  if (matches == nullptr) abort();
+  matches->clear();
+  if (options_.max_matches == 0) return;
+  // distances are squared while searching
+  SearchSubtree(0, nodes_.size(), 0, features, matches);
+  for (ObjectMatch &match : *matches) match.distance = sqrt(match.distance);
+}
+
+void MatchObjects(const ObjectIndex &index, const InertiaBatch &batch,
+                  vector<vector<ObjectMatch>> *matches) {
+  if (matches == nullptr) abort();
+  CV_METRIC_STAGE(kMetricMatch);
+  // clear( ) rather than assign( ) keeps the capacity of the inner
+  // vectors, so matching frame after frame stops allocating
+  matches->resize(batch.size());
+  for (vector<ObjectMatch> &object_matches : *matches) object_matches.clear();
+  ObjectIndex::FeatureVector features;
+  for (size_t k = 1; k < batch.size(); ++k)
+    if (index.Normalize(batch.min_inertia[k], Roundness(batch, k), &features)) {
+      index.FindNearest(features, &(*matches)[k]);
+      CV_METRIC_ADD(matches, (*matches)[k].size());
+    }
+}
+
+void CascadeCounters::Add(const CascadeCounters &other) {
+  candidates += other.candidates;
+  unmatchable += other.unmatchable;
+  rejected_by_area += other.rejected_by_area;
+  rejected_by_aspect += other.rejected_by_aspect;
+  rejected_by_roundness += other.rejected_by_roundness;
+  rejected_by_inertia += other.rejected_by_inertia;
+  accepted += other.accepted;
+}
+
+vector<uint32_t> CascadeMatcher::AreaOrder(const vector<ModelRecord> &models) {
+  vector<uint32_t> order;
+  for (size_t m = 0; m < models.size(); ++m)
+    if (models[m].min_inertia > 0) order.push_back(m);
+  stable_sort(order.begin(), order.end(), [&models](uint32_t x, uint32_t y) {
+    return models[x].area < models[y].area;
+  });
+  return order;
+}
+
+void CascadeMatcher::Build(const vector<ModelRecord> &models,
+                           const CascadeOptions &options) {
+  Build(models, options, AreaOrder(models));
+}
+
+void CascadeMatcher::Build(const vector<ModelRecord> &models,
+                           const CascadeOptions &options,
+                           const vector<uint32_t> &area_order) {
+  options_ = options;
+  use_area_ = options.area_ratio > 0;
+  use_aspect_ = options.aspect_tolerance > 0;
+  use_roundness_ = options.roundness_tolerance > 0;
+  for (const ModelRecord &model : models) {
+    if (model.area < 0) use_area_ = false;
+    if (model.aspect < 0) use_aspect_ = false;
+    if (model.roundness < 0) use_roundness_ = false;
+  }
+
+  candidates_.clear();
+  for (uint32_t m : area_order) {
+    candidates_.push_back(Candidate{models[m].area, models[m].aspect,
+                                    models[m].roundness,
+                                    log(models[m].min_inertia), m});
+  }
+  num_unmatchable_ = models.size() - candidates_.size();
+}
+
+void CascadeMatcher::Match(const SceneObject &object,
+                           vector<ObjectMatch> *matches,
+                           CascadeCounters *counters) const {
+  if (matches == nullptr || counters == nullptr) abort();
+  matches->clear();
+  counters->candidates += candidates_.size() + num_unmatchable_;
+  counters->unmatchable += num_unmatchable_;
+
+  // Stage 1: only models with an area in (A * ratio, A / ratio) can
+  // pass, and they are contiguous in candidates_.
+  size_t begin = 0;
+  size_t end = candidates_.size();
+  if (use_area_) {
+    const double low = object.area * options_.area_ratio;
+    const double high = object.area / options_.area_ratio;
+    begin = upper_bound(candidates_.begin(), candidates_.end(), low,
+                        [](double area, const Candidate &c) {
+                          return area < c.area;
+                        }) - candidates_.begin();
+    end = lower_bound(candidates_.begin() + begin, candidates_.end(), high,
+                      [](const Candidate &c, double area) {
+                        return c.area < area;
+                      }) - candidates_.begin();
+    end = max(begin, end);
+    counters->rejected_by_area += candidates_.size() - (end - begin);
+  }
+
+  const bool inertia_known = object.min_inertia > 0;
+  const double log_inertia = inertia_known ? log(object.min_inertia) : 0;
+  const double inertia_tolerance = -log(options_.inertia_ratio);
+  for (size_t k = begin; k < end; ++k) {
+    const Candidate &candidate = candidates_[k];
+    // Stage 2: bounding box aspect.
+    if (use_aspect_ &&
+        !(fabs(object.aspect - candidate.aspect) <
+          options_.aspect_tolerance)) {
+      ++counters->rejected_by_aspect;
+      continue;
+    }
+    // Stage 3: roundness.
+    if (use_roundness_ &&
+        !(fabs(object.roundness - candidate.roundness) <
+          options_.roundness_tolerance)) {
+      ++counters->rejected_by_roundness;
+      continue;
+    }
+    // Stage 4: the inertia ratio, on a log scale.
+    const double distance =
+        fabs(log_inertia - candidate.log_inertia) / inertia_tolerance;
+    if (!inertia_known || !(distance < 1)) {
+      ++counters->rejected_by_inertia;
+      continue;
+    }
+    ++counters->accepted;
+    matches->push_back(ObjectMatch{candidate.model, distance});
+  }
+
+  sort(matches->begin(), matches->end(),
+       [](const ObjectMatch &x, const ObjectMatch &y) {
+         return x.distance < y.distance ||
+                (x.distance == y.distance && x.model < y.model);
+       });
+  if (matches->size() > options_.max_matches)
+    matches->resize(options_.max_matches);
+}
+
+void MatchObjects(const CascadeMatcher &matcher,
+                  const vector<ObjectFeatures> &objects,
+                  const InertiaBatch &batch,
+                  vector<vector<ObjectMatch>> *matches,
+                  CascadeCounters *counters) {
+  if (matches == nullptr || counters == nullptr) abort();
+  CV_METRIC_STAGE(kMetricMatch);
+  matches->resize(objects.size());
+  for (vector<ObjectMatch> &object_matches : *matches) object_matches.clear();
+  for (size_t k = 1; k < objects.size(); ++k) {
+    SceneObject object;
+    object.area = objects[k].moments.area;
+    object.aspect = BoundingBoxAspect(objects[k]);
+    object.roundness = Roundness(batch, k);
+    object.min_inertia = batch.min_inertia[k];
+    matcher.Match(object, &(*matches)[k], counters);
+    CV_METRIC_ADD(matches, (*matches)[k].size());
+  }
+}
+
+}  // namespace ComputerVisionProjects
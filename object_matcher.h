@@ -0,0 +1,261 @@
+// Object model database and nearest-model matching of scene objects.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_OBJECT_MATCHER_H_
+#define COMPUTER_VISION_OBJECT_MATCHER_H_
+
+#include "object_moments.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// One line of the object model database written by p3.
+struct ModelRecord {
+  int label = 0;
+  double row_center = 0;
+  double column_center = 0;
+  double min_inertia = 0;
+  double orientation = 0;
+  // Minimum over maximum moment of inertia, 1 for round objects and 0
+  // for thin lines; -1 when the database has no roundness column.
+  double roundness = -1;
+  // Number of pixels; -1 when the database has no area column.
+  double area = -1;
+  // Shorter over longer side of the bounding box; -1 when the database
+  // has no aspect column.
+  double aspect = -1;
+};
+
+// Header line of the text object model database.
+extern const char kObjectDatabaseHeader[];
+
+/**
+ * ReadObjectDatabase( ) reads the header line and the model lines of an
+ * object model database. The roundness column is optional, so databases
+ * written before it was added still load. The same holds for the area
+ * and aspect columns that follow it.
+ *
+ * @param {istream} database_file: database written by p3
+ * @param {vector} models: the models, in database order
+ * @return false (with a message) on a malformed line
+ */
+bool ReadObjectDatabase(std::istream &database_file,
+                        std::vector<ModelRecord> *models);
+
+// Writes models as a text object model database, in the format p3
+// writes. Columns the models lack (-1) are left out.
+void WriteObjectDatabase(std::ostream &database_file,
+                         const std::vector<ModelRecord> &models);
+
+struct MatchOptions {
+  // A model matches when min(E, E') / max(E, E') > inertia_ratio, the
+  // test p4 has always used on the minimum moments of inertia E and E'.
+  double inertia_ratio = 0.8;
+  // When positive, a model also needs |roundness - roundness'| below
+  // this value. Ignored when the database has no roundness column.
+  double roundness_tolerance = 0;
+  // Number of nearest models returned per scene object.
+  size_t max_matches = 1;
+};
+
+struct ObjectMatch {
+  // Index of the model in the database.
+  size_t model;
+  // Distance in tolerance units: every feature within tolerance is
+  // closer than 1, and the distance grows with the differences.
+  double distance;
+};
+
+// Models in a k-d tree over their normalized features: log of the
+// minimum inertia (the primary key; a fixed inertia ratio is a fixed
+// distance on a log scale) and roundness. Each feature is divided by its
+// tolerance, so that the tolerances become the unit box around a query
+// and whole subtrees outside it are skipped.
+class ObjectIndex {
+ public:
+  static const size_t kNumFeatures = 2;
+  typedef std::array<double, kNumFeatures> FeatureVector;
+
+  ObjectIndex() { }
+
+  // Builds the index over models; models with a non-positive inertia
+  // never match anything and are left out.
+  void Build(const std::vector<ModelRecord> &models,
+             const MatchOptions &options);
+
+  // Same as above with the tree already laid out by TreeOrder( ), e.g.
+  // stored in a binary database.
+  void Build(const std::vector<ModelRecord> &models,
+             const MatchOptions &options,
+             const std::vector<uint32_t> &tree_order);
+
+  // Indices of the matchable models in k-d tree order. Scaling the
+  // features by the tolerances does not change the order, so it can be
+  // computed once per database.
+  static std::vector<uint32_t> TreeOrder(
+      const std::vector<ModelRecord> &models);
+
+  size_t size() const { return nodes_.size(); }
+  const MatchOptions &options() const { return options_; }
+
+  // Normalized features of an object with the given minimum inertia and
+  // roundness; false when it cannot match anything.
+  bool Normalize(double min_inertia, double roundness,
+                 FeatureVector *features) const;
+
+  /**
+   * FindNearest( ) returns the options().max_matches models nearest to
+   * features, among those within tolerance, nearest first.
+   *
+   * @param {FeatureVector} features: from Normalize( )
+   * @param {vector} matches: the matches, possibly none
+   */
+  void FindNearest(const FeatureVector &features,
+                   std::vector<ObjectMatch> *matches) const;
+
+ private:
+  struct Node {
+    FeatureVector features;
+    size_t model;
+  };
+
+  void SearchSubtree(size_t begin, size_t end, size_t depth,
+                     const FeatureVector &features,
+                     std::vector<ObjectMatch> *best) const;
+
+  MatchOptions options_;
+  bool use_roundness_ = false;
+  // Subtree [begin, end) has its root at the middle and its split
+  // feature given by its depth.
+  std::vector<Node> nodes_;
+};
+
+/**
+ * MatchObjects( ) finds the nearest models of every object of a batch
+ * whose inertia ComputeInertia( ) has computed.
+ *
+ * @param {ObjectIndex} index: the model database
+ * @param {InertiaBatch} batch: the scene objects, entry 0 unused
+ * @param {vector} matches: matches[k] receives the matches of object k
+ */
+void MatchObjects(const ObjectIndex &index, const InertiaBatch &batch,
+                  std::vector<std::vector<ObjectMatch>> *matches);
+
+// Minimum over maximum moment of inertia of entry k of a batch.
+double Roundness(const InertiaBatch &batch, size_t k);
+
+// Features of one scene object compared by CascadeMatcher.
+struct SceneObject {
+  double area = 0;
+  double aspect = 0;
+  double roundness = 0;
+  double min_inertia = 0;
+};
+
+// Tolerances of the stages of CascadeMatcher, cheapest first. A stage
+// whose tolerance is 0, or whose feature the database lacks, passes
+// every candidate.
+struct CascadeOptions {
+  // min(A, A') / max(A, A') > area_ratio.
+  double area_ratio = 0;
+  // |aspect - aspect'| < aspect_tolerance.
+  double aspect_tolerance = 0;
+  // |roundness - roundness'| < roundness_tolerance.
+  double roundness_tolerance = 0;
+  // min(E, E') / max(E, E') > inertia_ratio, always checked.
+  double inertia_ratio = 0.8;
+  // Number of matches kept per scene object, most similar inertia first.
+  size_t max_matches = 1;
+};
+
+// Number of model candidates each stage of CascadeMatcher rejected.
+struct CascadeCounters {
+  uint64_t candidates = 0;
+  // models without a positive inertia, which match nothing
+  uint64_t unmatchable = 0;
+  uint64_t rejected_by_area = 0;
+  uint64_t rejected_by_aspect = 0;
+  uint64_t rejected_by_roundness = 0;
+  uint64_t rejected_by_inertia = 0;
+  uint64_t accepted = 0;
+
+  void Add(const CascadeCounters &other);
+};
+
+// Matches scene objects against the models in stages that reject pairs
+// on the cheapest features first: area ratio, bounding box aspect,
+// roundness and finally the inertia ratio. The models are sorted by
+// area, so the area stage is a binary search that rejects every model
+// outside the allowed range at once.
+class CascadeMatcher {
+ public:
+  CascadeMatcher() { }
+
+  void Build(const std::vector<ModelRecord> &models,
+             const CascadeOptions &options);
+
+  // Same as above with the models already sorted by AreaOrder( ).
+  void Build(const std::vector<ModelRecord> &models,
+             const CascadeOptions &options,
+             const std::vector<uint32_t> &area_order);
+
+  // Indices of the matchable models by increasing area.
+  static std::vector<uint32_t> AreaOrder(
+      const std::vector<ModelRecord> &models);
+
+  const CascadeOptions &options() const { return options_; }
+
+  /**
+   * Match( ) runs the cascade for one scene object.
+   *
+   * @param {SceneObject} object: features of the scene object
+   * @param {vector} matches: accepted models, most similar inertia first;
+   *                          distance is |log(E / E')| / -log(inertia_ratio)
+   * @param {CascadeCounters} counters: incremented per stage
+   */
+  void Match(const SceneObject &object, std::vector<ObjectMatch> *matches,
+             CascadeCounters *counters) const;
+
+ private:
+  struct Candidate {
+    double area;
+    double aspect;
+    double roundness;
+    double log_inertia;
+    size_t model;
+  };
+
+  CascadeOptions options_;
+  bool use_area_ = false;
+  bool use_aspect_ = false;
+  bool use_roundness_ = false;
+  // Models with a positive inertia, by increasing area.
+  std::vector<Candidate> candidates_;
+  // Models with a non-positive inertia never match.
+  uint64_t num_unmatchable_ = 0;
+};
+
+/**
+ * MatchObjects( ) runs the cascade for every measured scene object.
+ *
+ * @param {CascadeMatcher} matcher: the model database
+ * @param {vector} objects: from MeasureObjects( ) with
+ *                          kSecondMoments | kBoundingBox, index 0 unused
+ * @param {InertiaBatch} batch: inertia of objects from ComputeInertia( )
+ * @param {vector} matches: matches[k] receives the matches of object k
+ * @param {CascadeCounters} counters: totals over all objects
+ */
+void MatchObjects(const CascadeMatcher &matcher,
+                  const std::vector<ObjectFeatures> &objects,
+                  const InertiaBatch &batch,
+                  std::vector<std::vector<ObjectMatch>> *matches,
+                  CascadeCounters *counters);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_OBJECT_MATCHER_H_
@@ -0,0 +1,436 @@
+// Raw image moments of labeled objects and the attributes derived from
+// them (center, orientation, minimum moment of inertia, Hu invariants).
+// To be used in Computer Vision class.
+
+#include "object_moments.h"
+#include "metrics.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COMPUTER_VISION_HAVE_X86_KERNELS 1
+#endif
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+// Adds to features the features they are derived from.
+uint32_t ExpandFeatures(uint32_t features) {
+  features |= MomentFeatures::kArea;
+  if (features & MomentFeatures::kHuInvariants)
+    features |= MomentFeatures::kSecondMoments;
+  if (features & MomentFeatures::kSecondMoments)
+    features |= MomentFeatures::kCentroid;
+  return features;
+}
+
+// Sums the features of the pixels in rows [begin, end) into objects.
+// kOrder is the highest order of moments summed (0 to 3).
+template <int kOrder, bool kBoundingBox, bool kPerimeter, typename PixelType>
+void MeasureBand(const ImagePlane<const PixelType> &plane, size_t begin,
+                 size_t end, ObjectFeatures *objects) {
+  const size_t num_rows = plane.num_rows();
+  const size_t num_columns = plane.num_columns();
+  for (size_t i = begin; i < end; ++i) {
+    const PixelType *row = plane.Row(i);
+    const PixelType *above = (i == 0) ? nullptr : plane.Row(i - 1);
+    const PixelType *below = (i + 1 == num_rows) ? nullptr : plane.Row(i + 1);
+    const int64_t ii = i;
+    for (size_t j = 0; j < num_columns; ++j) {
+      const PixelType label = row[j];
+      if (label == 0) continue;
+      ObjectFeatures &object = objects[label];
+      ObjectMoments &moments = object.moments;
+      const int64_t jj = j;
+      moments.area += 1;
+      if (kOrder >= 1) {
+        moments.sum_row += ii;
+        moments.sum_column += jj;
+      }
+      if (kOrder >= 2) {
+        moments.sum_row_squared += ii * ii;
+        moments.sum_column_squared += jj * jj;
+        moments.sum_row_column += ii * jj;
+      }
+      if (kOrder >= 3) {
+        object.sum_row_cubed += static_cast<__int128>(ii * ii) * ii;
+        object.sum_row_squared_column += static_cast<__int128>(ii * ii) * jj;
+        object.sum_row_column_squared += static_cast<__int128>(ii * jj) * jj;
+        object.sum_column_cubed += static_cast<__int128>(jj * jj) * jj;
+      }
+      if (kBoundingBox) object.ExtendBoundingBox(i, j);
+      if (kPerimeter) {
+        object.perimeter += (above == nullptr || above[j] != label) +
+                            (below == nullptr || below[j] != label) +
+                            (j == 0 || row[j - 1] != label) +
+                            (j + 1 == num_columns || row[j + 1] != label);
+      }
+    }
+  }
+}
+
+template <typename PixelType>
+using BandFunction = void (*)(const ImagePlane<const PixelType> &, size_t,
+                              size_t, ObjectFeatures *);
+
+template <int kOrder, typename PixelType>
+BandFunction<PixelType> PickBandFunction(bool bounding_box, bool perimeter) {
+  if (bounding_box) {
+    return perimeter ? &MeasureBand<kOrder, true, true, PixelType>
+                     : &MeasureBand<kOrder, true, false, PixelType>;
+  }
+  return perimeter ? &MeasureBand<kOrder, false, true, PixelType>
+                   : &MeasureBand<kOrder, false, false, PixelType>;
+}
+
+template <typename PixelType>
+BandFunction<PixelType> PickBandFunction(uint32_t features) {
+  const bool bounding_box = features & MomentFeatures::kBoundingBox;
+  const bool perimeter = features & MomentFeatures::kPerimeter;
+  if (features & MomentFeatures::kHuInvariants)
+    return PickBandFunction<3, PixelType>(bounding_box, perimeter);
+  if (features & MomentFeatures::kSecondMoments)
+    return PickBandFunction<2, PixelType>(bounding_box, perimeter);
+  if (features & MomentFeatures::kCentroid)
+    return PickBandFunction<1, PixelType>(bounding_box, perimeter);
+  return PickBandFunction<0, PixelType>(bounding_box, perimeter);
+}
+
+// Fills min_inertia and max_inertia of entries [0, count).
+typedef void (*InertiaKernel)(const double *a, const double *b,
+                              const double *c, size_t count,
+                              double *min_inertia, double *max_inertia);
+
+void InertiaTail(const double *a, const double *b, const double *c,
+                 size_t first, size_t count, double *min_inertia,
+                 double *max_inertia) {
+  for (size_t k = first; k < count; ++k) {
+    const double half_sum = (a[k] + c[k]) * 0.5;
+    const double difference = a[k] - c[k];
+    const double half_spread =
+        sqrt(difference * difference + b[k] * b[k]) * 0.5;
+    min_inertia[k] = half_sum - half_spread;
+    max_inertia[k] = half_sum + half_spread;
+  }
+}
+
+void InertiaScalar(const double *a, const double *b, const double *c,
+                   size_t count, double *min_inertia, double *max_inertia) {
+  InertiaTail(a, b, c, 0, count, min_inertia, max_inertia);
+}
+
+#ifdef COMPUTER_VISION_HAVE_X86_KERNELS
+
+__attribute__((target("sse2")))
+void InertiaSse2(const double *a, const double *b, const double *c,
+                 size_t count, double *min_inertia, double *max_inertia) {
+  const __m128d half = _mm_set1_pd(0.5);
+  const size_t full = count - count % 2;
+  for (size_t k = 0; k < full; k += 2) {
+    const __m128d va = _mm_loadu_pd(a + k);
+    const __m128d vb = _mm_loadu_pd(b + k);
+    const __m128d vc = _mm_loadu_pd(c + k);
+    const __m128d half_sum = _mm_mul_pd(_mm_add_pd(va, vc), half);
+    const __m128d difference = _mm_sub_pd(va, vc);
+    const __m128d half_spread = _mm_mul_pd(
+        _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(difference, difference),
+                               _mm_mul_pd(vb, vb))),
+        half);
+    _mm_storeu_pd(min_inertia + k, _mm_sub_pd(half_sum, half_spread));
+    _mm_storeu_pd(max_inertia + k, _mm_add_pd(half_sum, half_spread));
+  }
+  InertiaTail(a, b, c, full, count, min_inertia, max_inertia);
+}
+
+__attribute__((target("avx")))
+void InertiaAvx(const double *a, const double *b, const double *c,
+                size_t count, double *min_inertia, double *max_inertia) {
+  const __m256d half = _mm256_set1_pd(0.5);
+  const size_t full = count - count % 4;
+  for (size_t k = 0; k < full; k += 4) {
+    const __m256d va = _mm256_loadu_pd(a + k);
+    const __m256d vb = _mm256_loadu_pd(b + k);
+    const __m256d vc = _mm256_loadu_pd(c + k);
+    const __m256d half_sum = _mm256_mul_pd(_mm256_add_pd(va, vc), half);
+    const __m256d difference = _mm256_sub_pd(va, vc);
+    const __m256d half_spread = _mm256_mul_pd(
+        _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(difference, difference),
+                                     _mm256_mul_pd(vb, vb))),
+        half);
+    _mm256_storeu_pd(min_inertia + k, _mm256_sub_pd(half_sum, half_spread));
+    _mm256_storeu_pd(max_inertia + k, _mm256_add_pd(half_sum, half_spread));
+  }
+  InertiaTail(a, b, c, full, count, min_inertia, max_inertia);
+}
+
+#endif  // COMPUTER_VISION_HAVE_X86_KERNELS
+
+struct SelectedInertiaKernel {
+  InertiaKernel kernel;
+  const char *name;
+};
+
+const SelectedInertiaKernel &SelectInertiaKernel() {
+  static const SelectedInertiaKernel kernel = []() -> SelectedInertiaKernel {
+#ifdef COMPUTER_VISION_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx")) return {InertiaAvx, "avx"};
+    if (__builtin_cpu_supports("sse2")) return {InertiaSse2, "sse2"};
+#endif
+    return {InertiaScalar, "scalar"};
+  }();
+  return kernel;
+}
+
+}  // namespace
+
+void InertiaBatch::Resize(size_t size) {
+  row_center.assign(size, 0);
+  column_center.assign(size, 0);
+  a.assign(size, 0);
+  b.assign(size, 0);
+  c.assign(size, 0);
+  min_inertia.assign(size, 0);
+  max_inertia.assign(size, 0);
+  orientation.clear();
+}
+
+namespace {
+
+// Shared by both LoadInertiaBatch( ) overloads; moments_of(k) returns
+// the raw moments of object k, so neither needs a copy of the table.
+template <typename MomentsOf>
+void LoadInertiaBatch(size_t count, MomentsOf moments_of,
+                      InertiaBatch *batch) {
+  if (batch == nullptr) abort();
+  batch->Resize(count);
+  for (size_t k = 0; k < count; ++k) {
+    const ObjectMoments &m = moments_of(k);
+    if (m.area == 0) continue;
+    const double area = m.area;
+    const double x = m.sum_row / area;
+    const double y = m.sum_column / area;
+    batch->row_center[k] = x;
+    batch->column_center[k] = y;
+    batch->a[k] = m.sum_row_squared - (area * x * x);
+    batch->b[k] = 2 * (m.sum_row_column - (area * x * y));
+    batch->c[k] = m.sum_column_squared - (area * y * y);
+  }
+}
+
+}  // namespace
+
+void LoadInertiaBatch(const vector<ObjectMoments> &moments,
+                      InertiaBatch *batch) {
+  LoadInertiaBatch(
+      moments.size(),
+      [&moments](size_t k) -> const ObjectMoments & { return moments[k]; },
+      batch);
+}
+
+void LoadInertiaBatch(const vector<ObjectFeatures> &objects,
+                      InertiaBatch *batch) {
+  LoadInertiaBatch(
+      objects.size(),
+      [&objects](size_t k) -> const ObjectMoments & {
+        return objects[k].moments;
+      },
+      batch);
+}
+
+void ComputeInertia(InertiaBatch *batch, bool with_orientation) {
+  if (batch == nullptr) abort();
+  const size_t count = batch->size();
+  batch->min_inertia.resize(count);
+  batch->max_inertia.resize(count);
+  SelectInertiaKernel().kernel(batch->a.data(), batch->b.data(),
+                               batch->c.data(), count,
+                               batch->min_inertia.data(),
+                               batch->max_inertia.data());
+  if (!with_orientation) {
+    batch->orientation.clear();
+    return;
+  }
+  batch->orientation.resize(count);
+  for (size_t k = 0; k < count; ++k)
+    batch->orientation[k] =
+        InertiaOrientation(batch->a[k], batch->b[k], batch->c[k]);
+}
+
+const char *InertiaKernelName() {
+  return SelectInertiaKernel().name;
+}
+
+void ObjectFeatures::Add(const ObjectFeatures &other) {
+  moments.Add(other.moments);
+  sum_row_cubed += other.sum_row_cubed;
+  sum_row_squared_column += other.sum_row_squared_column;
+  sum_row_column_squared += other.sum_row_column_squared;
+  sum_column_cubed += other.sum_column_cubed;
+  min_row = min(min_row, other.min_row);
+  max_row = max(max_row, other.max_row);
+  min_column = min(min_column, other.min_column);
+  max_column = max(max_column, other.max_column);
+  perimeter += other.perimeter;
+}
+
+double BoundingBoxAspect(const ObjectFeatures &object) {
+  if (object.moments.area == 0 || object.min_row > object.max_row) return 0;
+  const double height = object.max_row - object.min_row + 1.0;
+  const double width = object.max_column - object.min_column + 1.0;
+  return min(height, width) / max(height, width);
+}
+
+ObjectAttributes ComputeAttributes(const ObjectMoments &moments) {
+  ObjectAttributes attributes;
+  if (moments.area == 0) return attributes;
+  double max_inertia;
+  const double area = moments.area;
+  // center of the object (x, y)
+  // x = (1/A)∑∑i bij
+  // y = (1/A)∑∑j bij
+  const double x = moments.sum_row / area;
+  const double y = moments.sum_column / area;
+  attributes.row_center = x;
+  attributes.column_center = y;
+
+  // a = ∫∫(x')^2 b(x, y)dx'dy'
+  attributes.a = moments.sum_row_squared - (area * x * x);
+  // 2∫∫(x'y') b(x, y)dx'dy'
+  attributes.b = 2 * (moments.sum_row_column - (area * x * y));
+  // c = ∫∫(y')2b(x, y)dx'dy'
+  attributes.c = moments.sum_column_squared - (area * y * y);
+
+  // E = a sin^2(θ) − b sin(θ) cos(θ) + c cos^2(θ) is smallest at
+  // θ = atan2(b, a − c) / 2, where it is the smaller eigenvalue of the
+  // second moment matrix.
+  attributes.orientation =
+      InertiaOrientation(attributes.a, attributes.b, attributes.c);
+  InertiaTail(&attributes.a, &attributes.b, &attributes.c, 0, 1,
+              &attributes.min_moment_of_inertia, &max_inertia);
+  return attributes;
+}
+
+std::array<double, 7> ComputeHuInvariants(const ObjectFeatures &object) {
+  std::array<double, 7> hu{};
+  const ObjectMoments &m = object.moments;
+  if (m.area == 0) return hu;
+  // Central moments, from the raw sums in extended precision.
+  typedef long double Real;
+  const Real area = m.area;
+  const Real x = m.sum_row / area;
+  const Real y = m.sum_column / area;
+  const Real mu20 = m.sum_row_squared - area * x * x;
+  const Real mu02 = m.sum_column_squared - area * y * y;
+  const Real mu11 = m.sum_row_column - area * x * y;
+  const Real mu30 = static_cast<Real>(object.sum_row_cubed) -
+                    3 * x * m.sum_row_squared + 2 * area * x * x * x;
+  const Real mu03 = static_cast<Real>(object.sum_column_cubed) -
+                    3 * y * m.sum_column_squared + 2 * area * y * y * y;
+  const Real mu21 = static_cast<Real>(object.sum_row_squared_column) -
+                    2 * x * m.sum_row_column - y * m.sum_row_squared +
+                    2 * area * x * x * y;
+  const Real mu12 = static_cast<Real>(object.sum_row_column_squared) -
+                    2 * y * m.sum_row_column - x * m.sum_column_squared +
+                    2 * area * x * y * y;
+
+  // Scale invariant moments ηpq = μpq / A^(1 + (p + q) / 2).
+  const Real second = area * area;
+  const Real third = second * sqrt(area);
+  const Real n20 = mu20 / second, n02 = mu02 / second, n11 = mu11 / second;
+  const Real n30 = mu30 / third, n03 = mu03 / third;
+  const Real n21 = mu21 / third, n12 = mu12 / third;
+
+  const Real s = n30 + n12;
+  const Real t = n21 + n03;
+  const Real u = n30 - 3 * n12;
+  const Real v = 3 * n21 - n03;
+  hu[0] = n20 + n02;
+  hu[1] = (n20 - n02) * (n20 - n02) + 4 * n11 * n11;
+  hu[2] = u * u + v * v;
+  hu[3] = s * s + t * t;
+  hu[4] = u * s * (s * s - 3 * t * t) + v * t * (3 * s * s - t * t);
+  hu[5] = (n20 - n02) * (s * s - t * t) + 4 * n11 * s * t;
+  hu[6] = v * s * (s * s - 3 * t * t) - u * t * (3 * s * s - t * t);
+  return hu;
+}
+
+void MeasureObjects(const Image &labels, const MeasureOptions &options,
+                    vector<ObjectFeatures> *objects) {
+  vector<vector<ObjectFeatures>> partials;
+  MeasureObjects(labels, options, objects, &partials);
+}
+
+void MeasureObjects(const Image &labels, const MeasureOptions &options,
+                    vector<ObjectFeatures> *objects,
+                    vector<vector<ObjectFeatures>> *partials) {
+  if (objects == nullptr || partials == nullptr) abort();
+  CV_METRIC_STAGE(kMetricMeasure);
+  const uint32_t features = ExpandFeatures(options.features);
+  const size_t num_rows = labels.num_rows();
+  const size_t num_labels = labels.num_gray_levels() + 1;
+  const size_t num_pixels = num_rows * labels.num_columns();
+
+  // One partial table per band: keep the tables together no larger than
+  // the image, and small images on one thread.
+  size_t num_bands = options.num_threads == 0 ? DefaultThreadCount()
+                                              : options.num_threads;
+  num_bands = min(num_bands, max<size_t>(1, num_pixels / num_labels));
+  if (num_pixels < kParallelMomentPixels) num_bands = 1;
+  num_bands = max<size_t>(1, min(num_bands, num_rows));
+
+  // Band 0 sums straight into objects, the others into partial tables
+  // that are only ever added to, so their capacity carries over.
+  if (partials->size() < num_bands) partials->resize(num_bands);
+  const auto table = [objects, partials](size_t band) {
+    return band == 0 ? objects : &(*partials)[band];
+  };
+  VisitPlane(labels, [&](auto plane) {
+    typedef typename std::remove_const<typename std::remove_pointer<
+        decltype(plane.data())>::type>::type PixelType;
+    const BandFunction<PixelType> measure =
+        PickBandFunction<PixelType>(features);
+    ParallelForBands(num_rows, num_bands,
+                     [&](size_t band, size_t begin, size_t end) {
+      table(band)->assign(num_labels, ObjectFeatures());
+      measure(plane, begin, end, table(band)->data());
+    });
+  });
+
+  // Reduce in band order; labels are split among the threads.
+  vector<ObjectFeatures> &total = *objects;
+  if (num_bands > 1) {
+    ParallelForBands(num_labels, num_bands,
+                     [&](size_t, size_t begin, size_t end) {
+      for (size_t band = 1; band < num_bands; ++band)
+        for (size_t label = begin; label < end; ++label)
+          total[label].Add((*partials)[band][label]);
+    });
+  }
+  CV_METRIC_ADD(objects, num_labels - 1);
+}
+
+void AccumulateMoments(const Image &labels, vector<ObjectMoments> *moments) {
+  vector<ObjectFeatures> objects;
+  vector<vector<ObjectFeatures>> partials;
+  AccumulateMoments(labels, moments, &objects, &partials);
+}
+
+void AccumulateMoments(const Image &labels, vector<ObjectMoments> *moments,
+                       vector<ObjectFeatures> *objects,
+                       vector<vector<ObjectFeatures>> *partials) {
+  if (moments == nullptr || objects == nullptr) abort();
+  MeasureOptions options;
+  options.features = MomentFeatures::kSecondMoments;
+  MeasureObjects(labels, options, objects, partials);
+  moments->resize(objects->size());
+  for (size_t label = 0; label < objects->size(); ++label)
+    (*moments)[label] = (*objects)[label].moments;
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,240 @@
+// Raw image moments of labeled objects and the attributes derived from
+// them (center, orientation, minimum moment of inertia, Hu invariants).
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_OBJECT_MOMENTS_H_
+#define COMPUTER_VISION_OBJECT_MOMENTS_H_
+
+#include "image.h"
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Sums over the pixels (i, j) of one object; i is the row, j the column.
+// Moments of two parts of an object add up to the moments of the whole,
+// which lets labeling accumulate them per provisional label and merge
+// them when labels turn out to be equivalent.
+struct ObjectMoments {
+  int64_t area = 0;
+  int64_t sum_row = 0;
+  int64_t sum_column = 0;
+  int64_t sum_row_squared = 0;
+  int64_t sum_column_squared = 0;
+  int64_t sum_row_column = 0;
+
+  void Add(int64_t i, int64_t j) {
+    area += 1;
+    sum_row += i;
+    sum_column += j;
+    sum_row_squared += i * i;
+    sum_column_squared += j * j;
+    sum_row_column += i * j;
+  }
+
+  void Add(const ObjectMoments &other) {
+    area += other.area;
+    sum_row += other.sum_row;
+    sum_column += other.sum_column;
+    sum_row_squared += other.sum_row_squared;
+    sum_column_squared += other.sum_column_squared;
+    sum_row_column += other.sum_row_column;
+  }
+};
+
+// Features MeasureObjects( ) can compute; combine them with |.
+// Features pull in the sums they are derived from: kHuInvariants also
+// computes kSecondMoments, which computes kCentroid. The area is always
+// computed.
+struct MomentFeatures {
+  enum : uint32_t {
+    kArea = 1u << 0,
+    kCentroid = 1u << 1,
+    kSecondMoments = 1u << 2,
+    kBoundingBox = 1u << 3,
+    kPerimeter = 1u << 4,
+    kHuInvariants = 1u << 5,
+    kAll = (1u << 6) - 1
+  };
+};
+
+// Everything MeasureObjects( ) knows about one object. Only the fields
+// of the requested features are filled, the others keep their defaults.
+struct ObjectFeatures {
+  // Zeroth to second order sums (kArea, kCentroid, kSecondMoments).
+  ObjectMoments moments;
+  // Third order sums ∑i³, ∑i²j, ∑ij², ∑j³ (kHuInvariants). They are
+  // kept exact in 128 bits, which holds any image up to 2^32 pixels
+  // with 2^16 rows and columns.
+  __int128 sum_row_cubed = 0;
+  __int128 sum_row_squared_column = 0;
+  __int128 sum_row_column_squared = 0;
+  __int128 sum_column_cubed = 0;
+  // Inclusive bounding box (kBoundingBox); min > max while empty.
+  uint32_t min_row = UINT32_MAX;
+  uint32_t max_row = 0;
+  uint32_t min_column = UINT32_MAX;
+  uint32_t max_column = 0;
+  // Number of pixel sides the object shares with other pixels or the
+  // image border, i.e. the length of its 4-connected outline (kPerimeter).
+  int64_t perimeter = 0;
+
+  void ExtendBoundingBox(uint32_t i, uint32_t j) {
+    if (i < min_row) min_row = i;
+    if (i > max_row) max_row = i;
+    if (j < min_column) min_column = j;
+    if (j > max_column) max_column = j;
+  }
+
+  void Add(const ObjectFeatures &other);
+};
+
+// Shorter over longer side of the bounding box of an object measured
+// with MomentFeatures::kBoundingBox, in (0, 1]; 0 for an empty object.
+double BoundingBoxAspect(const ObjectFeatures &object);
+
+struct MeasureOptions {
+  // MomentFeatures flags.
+  uint32_t features = MomentFeatures::kSecondMoments;
+  // Number of row bands measured concurrently; 0 uses DefaultThreadCount().
+  size_t num_threads = 0;
+};
+
+// Attributes written to the object model database.
+struct ObjectAttributes {
+  double row_center = 0;
+  double column_center = 0;
+  // Second moments about the center: a = ∑(i')², b = 2∑i'j', c = ∑(j')².
+  double a = 0;
+  double b = 0;
+  double c = 0;
+  double orientation = 0;
+  double min_moment_of_inertia = 0;
+};
+
+// Second moments about the center of many objects, one array per
+// quantity (structure of arrays), so that batch kernels process several
+// objects per instruction. Entry k describes object k; entry 0 is the
+// background and stays zero.
+struct InertiaBatch {
+  std::vector<double> row_center;
+  std::vector<double> column_center;
+  // a = ∑(i')², b = 2∑i'j', c = ∑(j')², as in ObjectAttributes.
+  std::vector<double> a;
+  std::vector<double> b;
+  std::vector<double> c;
+  // Filled by ComputeInertia( ).
+  std::vector<double> min_inertia;
+  std::vector<double> max_inertia;
+  // Filled by ComputeInertia( ) when asked for, empty otherwise.
+  std::vector<double> orientation;
+
+  size_t size() const { return a.size(); }
+  void Resize(size_t size);
+};
+
+/**
+ * LoadInertiaBatch( ) fills the centers and the second moments about
+ * them of every object from its raw moments.
+ *
+ * @param {vector} moments: raw moments, index 0 unused
+ * @param {InertiaBatch} batch: receives one entry per element of moments
+ */
+void LoadInertiaBatch(const std::vector<ObjectMoments> &moments,
+                      InertiaBatch *batch);
+
+// Same as above from the moments of measured objects.
+void LoadInertiaBatch(const std::vector<ObjectFeatures> &objects,
+                      InertiaBatch *batch);
+
+/**
+ * ComputeInertia( ) computes the minimum and maximum moments of inertia
+ * of every object of a batch without trigonometry: they are the
+ * eigenvalues (a + c ∓ √((a − c)² + b²)) / 2 of the second moment
+ * matrix. The kernel runs on AVX or SSE2 when the processor has them.
+ * The orientation needs one atan2 per object and is only computed when
+ * with_orientation is set.
+ *
+ * @param {InertiaBatch} batch: batch with the second moments loaded
+ * @param {bool} with_orientation: whether to fill batch->orientation
+ */
+void ComputeInertia(InertiaBatch *batch, bool with_orientation);
+
+// Angle of the axis of least inertia of an object with second moments
+// a, b and c.
+inline double InertiaOrientation(double a, double b, double c) {
+  return std::atan2(b, a - c) / 2;
+}
+
+// Name of the inertia kernel selected for this processor:
+// "avx", "sse2" or "scalar".
+const char *InertiaKernelName();
+
+/**
+ * ComputeAttributes( ) derives the center, orientation and minimum
+ * moment of inertia of an object from its raw moments. Empty objects
+ * get all-zero attributes.
+ *
+ * @param {ObjectMoments} moments: raw moments of an object
+ * @return the attributes of the object
+ */
+ObjectAttributes ComputeAttributes(const ObjectMoments &moments);
+
+/**
+ * ComputeHuInvariants( ) derives the seven Hu moment invariants, which
+ * do not change under translation, scaling and rotation of the object.
+ *
+ * @param {ObjectFeatures} object: measured with MomentFeatures::kHuInvariants
+ * @return the invariants h1..h7, all zero for an empty object
+ */
+std::array<double, 7> ComputeHuInvariants(const ObjectFeatures &object);
+
+/**
+ * MeasureObjects( ) scans a label image once and computes the requested
+ * features of labels 1..num_gray_levels(). Large images are split into
+ * row bands, each summed on its own thread into a partial table; the
+ * partial tables are then added label by label in band order. All sums
+ * are integers, so the result does not depend on the number of threads.
+ * The scan loop is compiled separately for each combination of sums, so
+ * features that were not asked for cost nothing.
+ *
+ * @param {Image} labels: input label image
+ * @param {MeasureOptions} options: features and threading options
+ * @param {vector} objects: the resulting features, index 0 unused
+ */
+void MeasureObjects(const Image &labels, const MeasureOptions &options,
+                    std::vector<ObjectFeatures> *objects);
+
+// Same as above with the partial tables of the bands kept in partials
+// from one call to the next; band 0 is summed directly into objects.
+void MeasureObjects(const Image &labels, const MeasureOptions &options,
+                    std::vector<ObjectFeatures> *objects,
+                    std::vector<std::vector<ObjectFeatures>> *partials);
+
+/**
+ * AccumulateMoments( ) computes the moments up to second order of every
+ * label; moments[label] holds the sums of label, for labels
+ * 1..num_gray_levels().
+ *
+ * @param {Image} labels: input label image
+ * @param {vector} moments: the resulting moments, index 0 unused
+ */
+void AccumulateMoments(const Image &labels,
+                       std::vector<ObjectMoments> *moments);
+
+// Same as above, measuring through objects and partials, which are
+// kept across calls like the tables of MeasureObjects( ).
+void AccumulateMoments(const Image &labels,
+                       std::vector<ObjectMoments> *moments,
+                       std::vector<ObjectFeatures> *objects,
+                       std::vector<std::vector<ObjectFeatures>> *partials);
+
+// Images with at least this many pixels are measured on several threads.
+const size_t kParallelMomentPixels = size_t{1} << 20;
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_OBJECT_MOMENTS_H_
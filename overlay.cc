@@ -0,0 +1,252 @@
+// Annotations drawn over an image: segments, centroid markers and
+// bounding boxes, clipped to the image and rendered in batches.
+// To be used in Computer Vision class.
+
+#include "overlay.h"
+#include "metrics.h"
+#include "pgm_io.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+// One Liang-Barsky test: narrows [t0, t1] to the parameters where
+// origin + t * delta stays within [low, high]. False when none do.
+bool ClipAxis(double origin, double delta, double low, double high,
+              double *t0, double *t1) {
+  if (delta == 0) return origin >= low && origin <= high;
+  double enter = (low - origin) / delta;
+  double leave = (high - origin) / delta;
+  if (enter > leave) swap(enter, leave);
+  *t0 = max(*t0, enter);
+  *t1 = min(*t1, leave);
+  return *t0 <= *t1;
+}
+
+// Midpoint line along its major axis, the axis with the larger extent
+// (columns on a tie, as DrawLine( ) always did): step k moves the major
+// coordinate by one and the minor one by floor((2 * rise * k + bias) /
+// (2 * length)), which is where the incremental decision variable of
+// Foley et al. ("Computer Graphics. Principles and practice", 2nd ed.,
+// 1990, section 3.2.2) puts it. The closed form lets the scan start at
+// the first step inside the image instead of at the segment's end.
+template <bool kRowsMajor, typename PixelType>
+void RasterizeSegment(long major0, long minor0, long length, long rise,
+                      long first, long last, PixelType color,
+                      const ImagePlane<PixelType> &plane) {
+  const long step = rise >= 0 ? 1 : -1;
+  const long twice_rise = 2 * rise * step;
+  const long twice_length = 2 * length;
+  // Exact ties move the minor coordinate late for rising lines and
+  // early for falling ones.
+  const long bias = rise >= 0 ? length - 1 : length;
+  const long minor_size = kRowsMajor ? plane.num_columns() : plane.num_rows();
+  long offset = 0, remainder = 0;
+  if (twice_length != 0) {
+    const long numerator = twice_rise * first + bias;
+    offset = numerator / twice_length;
+    remainder = numerator % twice_length;
+  }
+  for (long k = first; k <= last; ++k) {
+    const long major = major0 + k;
+    const long minor = minor0 + step * offset;
+    if (minor >= 0 && minor < minor_size) {
+      if (kRowsMajor)
+        plane.Row(major)[minor] = color;
+      else
+        plane.Row(minor)[major] = color;
+    }
+    remainder += twice_rise;
+    if (remainder >= twice_length) {
+      remainder -= twice_length;
+      ++offset;
+    }
+  }
+}
+
+template <typename PixelType>
+void RenderSegment(const OverlaySegment &segment,
+                   const ImagePlane<PixelType> &plane) {
+  double t0, t1;
+  if (!ClipSegment(segment, plane.num_rows(), plane.num_columns(), &t0, &t1))
+    return;
+  long row0 = segment.row0, column0 = segment.column0;
+  long row1 = segment.row1, column1 = segment.column1;
+  const long row_delta = row1 - row0, column_delta = column1 - column0;
+  const bool rows_major = row_delta * row_delta > column_delta * column_delta;
+  // Scan with the major coordinate increasing.
+  if (rows_major ? row1 < row0 : column1 < column0) {
+    swap(row0, row1);
+    swap(column0, column1);
+    swap(t0, t1);
+    t0 = 1 - t0;
+    t1 = 1 - t1;
+  }
+  const long major0 = rows_major ? row0 : column0;
+  const long minor0 = rows_major ? column0 : row0;
+  const long length = (rows_major ? row1 : column1) - major0;
+  const long rise = (rows_major ? column1 : row1) - minor0;
+  const long major_size = rows_major ? plane.num_rows() : plane.num_columns();
+
+  // Steps within the clipped parameters, widened by one for rounding
+  // and then held to the rows or columns of the image; the minor
+  // coordinate is checked per pixel at the ends of that range.
+  long first = static_cast<long>(floor(t0 * length)) - 1;
+  long last = static_cast<long>(ceil(t1 * length)) + 1;
+  first = max(first, max(0L, -major0));
+  last = min(last, min(length, major_size - 1 - major0));
+  if (first > last) return;
+  const PixelType color = static_cast<PixelType>(segment.color);
+  if (rows_major)
+    RasterizeSegment<true>(major0, minor0, length, rise, first, last, color,
+                           plane);
+  else
+    RasterizeSegment<false>(major0, minor0, length, rise, first, last, color,
+                            plane);
+}
+
+// Fills columns [begin, end] of row, clipped to the plane.
+template <typename PixelType>
+void RenderRowSpan(long row, long begin, long end, PixelType color,
+                   const ImagePlane<PixelType> &plane) {
+  if (row < 0 || row >= static_cast<long>(plane.num_rows())) return;
+  begin = max(begin, 0L);
+  end = min(end, static_cast<long>(plane.num_columns()) - 1);
+  if (begin > end) return;
+  const PixelSpan<PixelType> pixels = plane.Span(row).Subspan(begin, end + 1);
+  fill(pixels.begin(), pixels.end(), color);
+}
+
+// Sets rows [begin, end] of column, clipped to the plane.
+template <typename PixelType>
+void RenderColumnSpan(long column, long begin, long end, PixelType color,
+                      const ImagePlane<PixelType> &plane) {
+  if (column < 0 || column >= static_cast<long>(plane.num_columns())) return;
+  begin = max(begin, 0L);
+  end = min(end, static_cast<long>(plane.num_rows()) - 1);
+  for (long row = begin; row <= end; ++row) plane.Row(row)[column] = color;
+}
+
+template <typename PixelType>
+void RenderMarker(const OverlayMarker &marker,
+                  const ImagePlane<PixelType> &plane) {
+  const PixelType color = static_cast<PixelType>(marker.color);
+  const long row = marker.row, column = marker.column;
+  RenderRowSpan(row, column - marker.radius, column + marker.radius, color,
+                plane);
+  RenderColumnSpan(column, row - marker.radius, row + marker.radius, color,
+                   plane);
+}
+
+template <typename PixelType>
+void RenderBox(const OverlayBox &box, const ImagePlane<PixelType> &plane) {
+  const PixelType color = static_cast<PixelType>(box.color);
+  RenderRowSpan(box.min_row, box.min_column, box.max_column, color, plane);
+  RenderRowSpan(box.max_row, box.min_column, box.max_column, color, plane);
+  RenderColumnSpan(box.min_column, box.min_row, box.max_row, color, plane);
+  RenderColumnSpan(box.max_column, box.min_row, box.max_row, color, plane);
+}
+
+}  // namespace
+
+void OverlayBatch::Clear() {
+  segments_.clear();
+  markers_.clear();
+  boxes_.clear();
+}
+
+bool OverlayBatch::empty() const {
+  return segments_.empty() && markers_.empty() && boxes_.empty();
+}
+
+void OverlayBatch::AddSegment(int row0, int column0, int row1, int column1,
+                              int color) {
+  segments_.push_back(OverlaySegment{row0, column0, row1, column1, color});
+}
+
+void OverlayBatch::AddMarker(int row, int column, int radius, int color) {
+  markers_.push_back(OverlayMarker{row, column, radius, color});
+}
+
+void OverlayBatch::AddBox(int min_row, int min_column, int max_row,
+                          int max_column, int color) {
+  boxes_.push_back(
+      OverlayBox{min_row, min_column, max_row, max_column, color});
+}
+
+void OverlayBatch::Render(Image *an_image) const {
+  if (an_image == nullptr) abort();
+  VisitPlane(an_image, [this](auto plane) {
+    for (const OverlaySegment &segment : segments_)
+      RenderSegment(segment, plane);
+    for (const OverlayBox &box : boxes_) RenderBox(box, plane);
+    for (const OverlayMarker &marker : markers_) RenderMarker(marker, plane);
+  });
+}
+
+bool ClipSegment(const OverlaySegment &segment, size_t num_rows,
+                 size_t num_columns, double *t0, double *t1) {
+  if (t0 == nullptr || t1 == nullptr) abort();
+  *t0 = 0;
+  *t1 = 1;
+  return ClipAxis(segment.row0, segment.row1 - segment.row0, -0.5,
+                  num_rows - 0.5, t0, t1) &&
+         ClipAxis(segment.column0, segment.column1 - segment.column0, -0.5,
+                  num_columns - 0.5, t0, t1);
+}
+
+void DrawSegment(const OverlaySegment &segment, Image *an_image) {
+  if (an_image == nullptr) abort();
+  VisitPlane(an_image,
+             [&segment](auto plane) { RenderSegment(segment, plane); });
+}
+
+void ResetOverlayPlane(const Image &an_image, Image *overlay) {
+  if (overlay == nullptr) abort();
+  overlay->AllocateSpaceAndSetSize(an_image.num_rows(),
+                                   an_image.num_columns(),
+                                   PixelDepth::kUint8);
+  overlay->SetNumberGrayLevels(255);
+  for (PixelSpan<uint8_t> row : overlay->Plane<uint8_t>().Rows())
+    memset(row.data(), 0, row.size());
+}
+
+void CompositeOverlay(const Image &overlay, Image *an_image) {
+  if (an_image == nullptr) abort();
+  if (overlay.num_rows() != an_image->num_rows() ||
+      overlay.num_columns() != an_image->num_columns())
+    abort();
+  const ImagePlane<const uint8_t> over = overlay.Plane<uint8_t>();
+  VisitPlane(an_image, [&over](auto plane) {
+    for (size_t i = 0; i < plane.num_rows(); ++i) {
+      const auto row = plane.Row(i);
+      const uint8_t *from = over.Row(i);
+      for (size_t j = 0; j < plane.num_columns(); ++j)
+        if (from[j] != 0) row[j] = from[j];
+    }
+  });
+}
+
+bool WriteImage(const string &filename, const Image &an_image,
+                const Image &overlay) {
+  CV_METRIC_STAGE(kMetricWrite);
+  FilePgmSink output;
+  if (!output.Open(filename)) {
+    cout << "WriteImage: cannot open file" << endl;
+    return false;
+  }
+  if (!EncodePgm(an_image, &overlay, &output) || !output.Finish()) {
+    cout << "WriteImage: could not write" << endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,118 @@
+// Annotations drawn over an image: segments, centroid markers and
+// bounding boxes, clipped to the image and rendered in batches.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_OVERLAY_H_
+#define COMPUTER_VISION_OVERLAY_H_
+
+#include "image.h"
+#include <string>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Segment from (row0, column0) to (row1, column1), both ends included.
+// Ends may lie outside the image.
+struct OverlaySegment {
+  int row0;
+  int column0;
+  int row1;
+  int column1;
+  int color;
+};
+
+// Cross of 2 * radius + 1 pixels each way centered on (row, column).
+struct OverlayMarker {
+  int row;
+  int column;
+  int radius;
+  int color;
+};
+
+// Outline of the rectangle [min_row, max_row] x [min_column, max_column].
+struct OverlayBox {
+  int min_row;
+  int min_column;
+  int max_row;
+  int max_column;
+  int color;
+};
+
+// The annotations of one frame, collected first and drawn together by
+// Render( ): the pixel type of the target is dispatched once for the
+// whole batch, and every primitive is clipped to the image before it is
+// rasterized, so nothing is drawn, or checked, outside of it. Clear( )
+// keeps the capacity, so a batch reused across frames stops allocating.
+//
+// Example:
+//   OverlayBatch annotations;
+//   annotations.AddSegment(10, 10, 10, 60, 200);
+//   annotations.AddMarker(10, 10, 3, 255);
+//   annotations.Render(&an_image);
+class OverlayBatch {
+ public:
+  void Clear();
+  bool empty() const;
+
+  void AddSegment(int row0, int column0, int row1, int column1, int color);
+  void AddMarker(int row, int column, int radius, int color);
+  void AddBox(int min_row, int min_column, int max_row, int max_column,
+              int color);
+
+  const std::vector<OverlaySegment> &segments() const { return segments_; }
+  const std::vector<OverlayMarker> &markers() const { return markers_; }
+  const std::vector<OverlayBox> &boxes() const { return boxes_; }
+
+  // Draws every annotation into an_image, clipped to it.
+  void Render(Image *an_image) const;
+
+ private:
+  std::vector<OverlaySegment> segments_;
+  std::vector<OverlayMarker> markers_;
+  std::vector<OverlayBox> boxes_;
+};
+
+/**
+ * ClipSegment( ) clips a segment to the image [0, num_rows) x
+ * [0, num_columns) with the Liang-Barsky parametric test: the part left
+ * is the one between parameters t0 and t1 of the segment, 0 being
+ * (row0, column0) and 1 (row1, column1). Pixel centers are at integer
+ * coordinates, so the image spans -0.5 to num_rows - 0.5.
+ *
+ * @param {OverlaySegment} segment: the segment to clip
+ * @param {size_t} num_rows: rows of the image
+ * @param {size_t} num_columns: columns of the image
+ * @param {double} t0: receives the parameter where the segment enters
+ * @param {double} t1: receives the parameter where it leaves
+ * @return false when no part of the segment is inside the image
+ */
+bool ClipSegment(const OverlaySegment &segment, size_t num_rows,
+                 size_t num_columns, double *t0, double *t1);
+
+/**
+ * DrawSegment( ) draws the pixels of the midpoint (Bresenham) line of a
+ * segment that are inside an_image: the same pixels DrawLine( ) always
+ * drew for a segment inside the image, without visiting the ones outside.
+ *
+ * @param {OverlaySegment} segment: the segment and its color
+ * @param {Image} an_image: image to draw on
+ */
+void DrawSegment(const OverlaySegment &segment, Image *an_image);
+
+// Sizes overlay to an_image as an 8-bit plane of zeros. Annotations
+// rendered into it are laid over the image by CompositeOverlay( ) or by
+// WriteImage( ) with an overlay, so the image below, e.g. the labels
+// being analyzed, is never changed. Color 0 is transparent.
+void ResetOverlayPlane(const Image &an_image, Image *overlay);
+
+// Copies the non-zero pixels of overlay, of the same size, into an_image.
+void CompositeOverlay(const Image &overlay, Image *an_image);
+
+// Writes an_image with the non-zero pixels of overlay laid over it,
+// composited row by row while encoding; an_image is not changed.
+bool WriteImage(const std::string &output_filename, const Image &an_image,
+                const Image &overlay);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_OVERLAY_H_
@@ -3,12 +3,20 @@
  * Author         : Renat Khalikov
  * Created on     : September 26, 2017
  * Description    : converts a gray–level image to a binary one using 
- *                  a threshold value
+ *                  a threshold value, or one picked from the histogram
+ *                  when the threshold is auto (Otsu), otsu or triangle.
+ *                  An output file name ending in .pbm stores
+ *                  a bit-packed (P4) mask instead of a pgm image
  * Purpose        : 
  * Usage          : ./p1 many_objects_1.pgm 125 many_objects_1_p1_out.pgm
+ *                  ./p1 many_objects_1.pgm 125 many_objects_1_p1_out.pbm
+ *                  ./p1 many_objects_1.pgm auto many_objects_1_p1_out.pgm
  * Build with     : make all
  */
 #include "image.h"
+#include "binary_mask.h"
+#include "histogram.h"
+#include "metrics.h"
 #include <cstdio>
 #include <iostream>
 #include <string>
@@ -18,19 +26,46 @@ using namespace ComputerVisionProjects;
 
 int main(int argc, char **argv){  
   if (argc!=4) {
-    printf("Usage: %s {input gray–level image} {input gray–level threshold} {output binary image}\n", argv[0]);
+    printf("Usage: %s {input gray–level image} {input gray–level threshold | auto | otsu | triangle} {output binary image (.pgm or .pbm)}\n", argv[0]);
     return 0;
   }
   const string input_file(argv[1]);
   const string value(argv[2]);
   const string output_file(argv[3]);
 
+  // stage times and counters of this run, with make all METRICS=1
+  ScopedFrameMetrics frame_metrics(input_file);
+
+  // automatic thresholds take the histogram gathered while reading
+  ThresholdMethod method;
+  const bool automatic = ParseThresholdMethod(value, &method);
+  GrayHistogram histogram;
   Image an_image;
-  if (!ReadImage(input_file, &an_image)) {
+  if (!ReadImage(input_file, &an_image, automatic ? &histogram : nullptr)) {
     cout <<"Can't open file " << input_file << endl;
     return 0;
   }
-  int threshold_value = stoi(value);  // convert string to int
+  int threshold_value;
+  if (automatic) {
+    threshold_value = SelectThreshold(histogram, method);
+    cout << "Threshold: " << threshold_value << endl;
+  } else {
+    threshold_value = stoi(value);  // convert string to int
+  }
+
+  // .pbm output: threshold straight into a bit-packed mask
+  const string pbm_extension(".pbm");
+  if (output_file.size() >= pbm_extension.size() &&
+      output_file.compare(output_file.size() - pbm_extension.size(),
+                          pbm_extension.size(), pbm_extension) == 0) {
+    BinaryMask mask;
+    ThresholdToMask(an_image, threshold_value, &mask);
+    if (!WriteMask(output_file, mask)) {
+      cout << "Can't write to file " << output_file << endl;
+    }
+    return 0;
+  }
+
   ConvertToBinary(threshold_value, &an_image);
   
   if (!WriteImage(output_file, an_image)){
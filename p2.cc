@@ -3,13 +3,26 @@
  * Author         : Renat Khalikov
  * Created on     : September 26, 2017
  * Description    : labeling program that segments a binary image into several
- *                  connected regions
+ *                  connected regions. The optional engine argument picks
+ *                  the labeling algorithm: raster (default, RasterScan),
+ *                  runs (run-length labeling), parallel (multi-threaded
+ *                  labeling over horizontal bands), pixel4 / pixel8
+ *                  (specialized 4- or 8-connected kernels) or block
+ *                  (8-connected 2x2 block scan). The kernel engines read
+ *                  a .pbm mask from p1 without unpacking it
  * Purpose        : 
  * Usage          : ./p2 many_objects_1_p1_out.pgm many_objects_1_p2_out.pgm
+ *                  ./p2 many_objects_1_p1_out.pgm many_objects_1_p2_out.pgm runs
+ *                  ./p2 many_objects_1_p1_out.pbm many_objects_1_p2_out.pgm block
  * Build with     : make all
  */
 #include "image.h"
 #include "DisjSets.h"
+#include "run_labeling.h"
+#include "parallel_labeling.h"
+#include "labeling_kernels.h"
+#include "binary_mask.h"
+#include "metrics.h"
 #include <cstdio>
 #include <iostream>
 #include <string>
@@ -18,12 +31,41 @@ using namespace std;
 using namespace ComputerVisionProjects;
 
 int main(int argc, char **argv){  
-  if (argc!=3) {
-    printf("Usage: %s {input binary image} {output labeled image}\n", argv[0]);
+  if (argc!=3 && argc!=4) {
+    printf("Usage: %s {input binary image} {output labeled image} [raster|runs|parallel|pixel4|pixel8|block]\n", argv[0]);
     return 0;
   }
   const string input_file(argv[1]);
   const string output_file(argv[2]);
+  const string engine(argc == 4 ? argv[3] : "raster");
+  LabelingMode mode;
+  const bool kernel_engine = ParseLabelingMode(engine, &mode);
+  if (engine != "raster" && engine != "runs" && engine != "parallel" &&
+      !kernel_engine) {
+    cout << "Unknown labeling engine " << engine << endl;
+    return 0;
+  }
+
+  // stage times and counters of this run, with make all METRICS=1
+  ScopedFrameMetrics frame_metrics(input_file);
+
+  // kernel engines label a bit-packed mask as it is stored in the file
+  const string pbm_extension(".pbm");
+  if (kernel_engine && input_file.size() >= pbm_extension.size() &&
+      input_file.compare(input_file.size() - pbm_extension.size(),
+                         pbm_extension.size(), pbm_extension) == 0) {
+    BinaryMask mask;
+    if (!ReadMask(input_file, &mask)) {
+      cout <<"Can't open file " << input_file << endl;
+      return 0;
+    }
+    Image labels;
+    LabelBinaryImage(mask, mode, &labels);
+    if (!WriteImage(output_file, labels)){
+      cout << "Can't write to file " << output_file << endl;
+    }
+    return 0;
+  }
 
   Image an_image;
   if (!ReadImage(input_file, &an_image)) {
@@ -31,7 +73,21 @@ int main(int argc, char **argv){
     return 0;
   }
 
-  RasterScan(&an_image);
+  if (kernel_engine) {
+    Image labels;
+    LabelBinaryImage(an_image, mode, &labels);
+    if (!WriteImage(output_file, labels)){
+      cout << "Can't write to file " << output_file << endl;
+    }
+    return 0;
+  }
+
+  if (engine == "runs")
+    RunLengthLabeling(&an_image);
+  else if (engine == "parallel")
+    ParallelRasterScan(&an_image);
+  else
+    RasterScan(&an_image);
   
   if (!WriteImage(output_file, an_image)){
     cout << "Can't write to file " << output_file << endl;
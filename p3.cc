@@ -3,31 +3,54 @@
  * Author         : Renat Khalikov
  * Created on     : September 26, 2017
  * Description    : takes a labeled image as input, computes object attributes,
- *                  and generates the database of the objects
+ *                  and generates the database of the objects. With the
+ *                  optional "binary" argument it takes the binary image
+ *                  of p1 instead, and labels and measures the objects in
+ *                  a single pass. A database name ending in .cvdb
+ *                  gets the binary database format
  * Purpose        : 
  * Usage          : ./p3 many_objects_1_p2_out.pgm 
  *                       many_objects_1_database.txt 
  *                       many_objects_1_p3_out.pgm
+ *                       [binary]
+ *                  ./p3 many_objects_1_p2_out.pgm
+ *                       many_objects_1_database.cvdb
+ *                       many_objects_1_p3_out.pgm
  * Build with     : make all
  */
 #include "image.h"
 #include "DisjSets.h"
+#include "frame_arena.h"
+#include "metrics.h"
+#include "model_database.h"
+#include "object_matcher.h"
+#include "object_moments.h"
+#include "overlay.h"
 #include <cstdio>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace ComputerVisionProjects;
 
 int main(int argc, char **argv){  
-  if (argc!=4) {
-    printf("Usage: %s {input labeled image} {output database} {output image}\n", argv[0]);
+  if (argc!=4 && argc!=5) {
+    printf("Usage: %s {input labeled image} {output database} {output image} [binary]\n", argv[0]);
     return 0;
   }
   const string input_image(argv[1]);
   const string output_database(argv[2]);
   const string output_image(argv[3]);
+  const bool binary_input = (argc == 5);
+  if (binary_input && string(argv[4]) != "binary") {
+    cout << "Unknown input kind " << argv[4] << endl;
+    return 0;
+  }
+
+  // stage times and counters of this run, with make all METRICS=1
+  ScopedFrameMetrics frame_metrics(input_image);
 
   Image an_image;
   if (!ReadImage(input_image, &an_image)) {
@@ -35,15 +58,41 @@ int main(int argc, char **argv){
     return 0;
   }
 
-  ofstream output_filename(output_database);
-  if (output_filename.fail()) {
-    cerr << "Could not open: {output database}\n";
-    exit(1); // 1 indicates an error occurred
+  FrameArena arena;
+  vector<ObjectFeatures> &objects = arena.objects;
+  if (binary_input) {
+    // Label and measure in the same scan; an_image becomes the labels.
+    RasterScan(&an_image, &objects);
+  } else {
+    MeasureOptions options;
+    options.features = MomentFeatures::kSecondMoments | MomentFeatures::kBoundingBox;
+    MeasureObjects(an_image, options, &objects, &arena.partial_objects);
+  }
+
+  // The orientation lines go to an overlay plane laid over the labels
+  // when the image is written; the labels themselves are not drawn on.
+  Image overlay;
+  ResetOverlayPlane(an_image, &overlay);
+  const bool binary_database =
+      output_database.size() > 5 &&
+      output_database.compare(output_database.size() - 5, 5, ".cvdb") == 0;
+  if (binary_database) {
+    vector<ModelRecord> models;
+    ComputeObjectModels(objects, &models, &overlay, &arena);
+    if (!WriteModelDatabase(output_database, models)) {
+      cout << "Can't write to file " << output_database << endl;
+      return 0;
+    }
+  } else {
+    ofstream database_file(output_database);
+    if (database_file.fail()) {
+      cerr << "Could not open: {output database}\n";
+      exit(1); // 1 indicates an error occurred
+    }
+    WriteObjectAttributes(database_file, objects, &overlay, &arena);
   }
-  ComputeObjectAttributes(output_filename, &an_image);
-  output_filename.close();
   
-  if (!WriteImage(output_image, an_image)){
+  if (!WriteImage(output_image, an_image, overlay)){
     cout << "Can't write to file " << output_image << endl;
     return 0;
   }
@@ -2,31 +2,72 @@
  * Title          : p4.cc
  * Author         : Renat Khalikov
  * Created on     : September 26, 2017
- * Description    : recognizes objects from the database
+ * Description    : recognizes objects from the database. The optional
+ *                  arguments set the inertia ratio two objects must
+ *                  exceed to match (default 0.8) and the largest
+ *                  roundness difference (default: not compared). With
+ *                  an area ratio and an aspect tolerance as well, the
+ *                  models go through a cascade that rejects them on
+ *                  area, bounding box aspect, roundness and inertia in
+ *                  turn, and the rejections of each stage are printed.
+ *                  The database may be text (p3) or binary (db_convert)
  * Purpose        : 
  * Usage          : ./p4 many_objects_1_p2_out.pgm 
  *                  two_objects_database.txt 
  *                  many_objects_1_p4_out.pgm
+ *                  [0.8 [0.1 [0.5 [0.2]]]]
  * Build with     : make all
  */
 #include "image.h"
 #include "DisjSets.h"
+#include "frame_arena.h"
+#include "metrics.h"
+#include "model_database.h"
+#include "object_matcher.h"
+#include "overlay.h"
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace ComputerVisionProjects;
 
 int main(int argc, char **argv){  
-  if (argc!=4) {
-    printf("Usage: %s {input labeled image} {input database} {output image}\n", argv[0]);
+  if (argc<4 || argc>8) {
+    printf("Usage: %s {input labeled image} {input database} {output image} [inertia ratio [roundness tolerance [area ratio [aspect tolerance]]]]\n", argv[0]);
     return 0;
   }
   const string input_image(argv[1]);
   string input_database(argv[2]);
   const string output_image(argv[3]);
+  MatchOptions options;
+  if (argc > 4) options.inertia_ratio = atof(argv[4]);
+  if (argc > 5) options.roundness_tolerance = atof(argv[5]);
+  const bool use_cascade = argc > 6;
+  CascadeOptions cascade_options;
+  cascade_options.inertia_ratio = options.inertia_ratio;
+  cascade_options.roundness_tolerance = options.roundness_tolerance;
+  if (argc > 6) cascade_options.area_ratio = atof(argv[6]);
+  if (argc > 7) cascade_options.aspect_tolerance = atof(argv[7]);
+  if (!(options.inertia_ratio > 0 && options.inertia_ratio < 1)) {
+    cout << "Inertia ratio must be between 0 and 1" << endl;
+    return 0;
+  }
+  if (argc > 6 &&
+      !(cascade_options.area_ratio > 0 && cascade_options.area_ratio < 1)) {
+    cout << "Area ratio must be between 0 and 1" << endl;
+    return 0;
+  }
+  if (argc > 7 && !(cascade_options.aspect_tolerance > 0)) {
+    cout << "Aspect tolerance must be positive" << endl;
+    return 0;
+  }
+
+  // stage times and counters of this run, with make all METRICS=1
+  ScopedFrameMetrics frame_metrics(input_image);
 
   Image an_image;
   if (!ReadImage(input_image, &an_image)) {
@@ -34,15 +75,44 @@ int main(int argc, char **argv){
     return 0;
   }
 
-  ifstream database_file(input_database);
-  if (database_file.fail()) {
-    cerr << "Could not open: {input database}\n";
-    exit(1); // 1 indicates an error occurred
+  ModelDatabase database;
+  if (!LoadModelDatabase(input_database, &database)) {
+    cout << "Can't read database " << input_database << endl;
+    return 0;
+  }
+  const vector<ModelRecord> &models = database.models;
+
+  // Matched objects are marked on an overlay plane, composited when the
+  // image is written, so the labels are not drawn on.
+  Image overlay;
+  ResetOverlayPlane(an_image, &overlay);
+  FrameArena arena;
+  vector<vector<ObjectMatch>> matches;
+  if (use_cascade) {
+    CascadeMatcher matcher;
+    matcher.Build(models, cascade_options, database.area_order);
+    CascadeCounters counters;
+    CompareObjectAttributes(matcher, &an_image, &matches, &counters, &arena,
+                            &overlay);
+    cout << "candidates " << counters.candidates
+         << ", unmatchable " << counters.unmatchable
+         << ", rejected by area " << counters.rejected_by_area
+         << ", by aspect " << counters.rejected_by_aspect
+         << ", by roundness " << counters.rejected_by_roundness
+         << ", by inertia " << counters.rejected_by_inertia
+         << ", accepted " << counters.accepted << endl;
+  } else {
+    ObjectIndex index;
+    index.Build(models, options, database.tree_order);
+    CompareObjectAttributes(index, &an_image, &matches, &arena, &overlay);
   }
-  CompareObjectAttributes(database_file, &an_image);
-  database_file.close();
+  for (size_t i = 1; i < matches.size(); ++i)
+    for (const ObjectMatch &match : matches[i])
+      cout << "object " << i << " matches model "
+           << models[match.model].label << " (distance "
+           << match.distance << ")" << endl;
   
-  if (!WriteImage(output_image, an_image)){
+  if (!WriteImage(output_image, an_image, overlay)){
     cout << "Can't write to file " << output_image << endl;
     return 0;
   }
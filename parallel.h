@@ -0,0 +1,78 @@
+// Minimal data-parallel helpers shared by the image stages.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_PARALLEL_H_
+#define COMPUTER_VISION_PARALLEL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Size of the cache lines that data written by different threads is
+// kept apart by.
+const size_t kCacheLineSize = 64;
+
+// Base of classes aligned with alignas(kCacheLineSize), on the class or
+// on members: before C++17, plain new only guarantees the alignment of
+// the fundamental types, so the heap copies of such classes could share
+// a cache line after all. These take the whole alignment from
+// posix_memalign instead.
+struct CacheLineAligned {
+  static void *operator new(size_t size) { return Allocate(size); }
+  static void *operator new[](size_t size) { return Allocate(size); }
+  static void operator delete(void *pointer) { free(pointer); }
+  static void operator delete[](void *pointer) { free(pointer); }
+
+ private:
+  static void *Allocate(size_t size) {
+    void *pointer = nullptr;
+    if (posix_memalign(&pointer, kCacheLineSize, size) != 0)
+      throw std::bad_alloc();
+    return pointer;
+  }
+};
+
+// Number of threads data-parallel stages use when not told otherwise.
+inline size_t DefaultThreadCount() {
+  const size_t count = std::thread::hardware_concurrency();
+  return count == 0 ? 1 : count;
+}
+
+// First row of band number band when num_rows rows are split into
+// num_bands bands of (almost) equal height.
+inline size_t BandBegin(size_t num_rows, size_t num_bands, size_t band) {
+  return num_rows * band / num_bands;
+}
+
+/**
+ * ParallelForBands( ) splits the rows [0, num_rows) into num_bands
+ * contiguous bands and calls function(band, begin_row, end_row) once per
+ * band, each on its own thread. The calling thread runs band 0 and
+ * returns once every band is done. Bands are numbered top to bottom, so
+ * reducing per-band results by band number is deterministic.
+ *
+ * @param {size_t} num_rows: number of rows to split
+ * @param {size_t} num_bands: number of bands (clamped to 1..num_rows)
+ * @param {Function} function: called as function(size_t, size_t, size_t)
+ */
+template <typename Function>
+void ParallelForBands(size_t num_rows, size_t num_bands, Function function) {
+  num_bands = std::max<size_t>(1, std::min(num_bands, num_rows));
+  std::vector<std::thread> workers;
+  workers.reserve(num_bands - 1);
+  for (size_t band = 1; band < num_bands; ++band)
+    workers.emplace_back(function, band,
+                         BandBegin(num_rows, num_bands, band),
+                         BandBegin(num_rows, num_bands, band + 1));
+  function(size_t{0}, size_t{0}, BandBegin(num_rows, num_bands, 1));
+  for (std::thread &worker : workers) worker.join();
+}
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_PARALLEL_H_
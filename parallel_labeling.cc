@@ -0,0 +1,127 @@
+// Multi-threaded connected component labeling over horizontal bands.
+// To be used in Computer Vision class.
+
+#include "parallel_labeling.h"
+#include "metrics.h"
+#include "parallel.h"
+#include "UnionFind.h"
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+// Labels rows [begin, end) of labels on their own, ignoring the row
+// above the band. Fills relabel with a table from provisional label to
+// band-local object number (1..num_objects, in raster order), and
+// counters with the work of the band's equivalence table when metrics
+// are compiled in.
+uint32_t LabelBand(const ImagePlane<uint32_t> &labels, size_t begin,
+                   size_t end, vector<uint32_t> *relabel,
+                   UnionFindCounters *counters) {
+  static_cast<void>(counters);  // only filled when metrics are compiled in
+  UnionFind equivalences;
+  const size_t column = labels.num_columns();
+  for (size_t i = begin; i < end; ++i) {
+    uint32_t *current_row = labels.Row(i);
+    const uint32_t *previous_row = (i == begin) ? nullptr : labels.Row(i - 1);
+    for (size_t j = 0; j < column; ++j) {
+      if (current_row[j] == 0) continue;
+      const uint32_t north_pixel = (i == begin) ? 0 : previous_row[j];
+      const uint32_t west_pixel = (j == 0) ? 0 : current_row[j - 1];
+      uint32_t pixel;
+      if (north_pixel == 0 && west_pixel == 0)
+        pixel = equivalences.MakeSet();
+      else if (north_pixel == 0)
+        pixel = west_pixel;
+      else if (west_pixel == 0 || west_pixel == north_pixel)
+        pixel = north_pixel;
+      else
+        pixel = equivalences.Union(west_pixel, north_pixel);
+      current_row[j] = pixel;
+    }
+  }
+
+  // Provisional labels are created in raster order, so flattening
+  // numbers the objects by their first pixel.
+  const uint32_t num_objects = equivalences.Flatten(relabel);
+  CV_METRIC(*counters = equivalences.counters());
+  return num_objects;
+}
+
+}  // namespace
+
+void ParallelRasterScan(Image *an_image,
+                        const ParallelLabelingOptions &options) {
+  if (an_image == nullptr) abort();
+  CV_METRIC_STAGE(kMetricLabel);
+  an_image->SetDepth(PixelDepth::kUint32);
+  const ImagePlane<uint32_t> labels = an_image->Plane<uint32_t>();
+  const size_t num_rows = labels.num_rows();
+  const size_t num_bands = max<size_t>(1, min(num_rows,
+      options.num_threads == 0 ? DefaultThreadCount() : options.num_threads));
+
+  // Pass 1: label every band independently.
+  vector<vector<uint32_t>> relabel(num_bands);
+  vector<uint32_t> num_objects(num_bands);
+  // the bands run on threads without a frame to count into
+  vector<UnionFindCounters> counters(num_bands);
+  ParallelForBands(num_rows, num_bands,
+                   [&](size_t band, size_t begin, size_t end) {
+    num_objects[band] =
+        LabelBand(labels, begin, end, &relabel[band], &counters[band]);
+  });
+  CV_METRIC(for (const UnionFindCounters &band : counters)
+                AddEquivalenceCounters(band));
+
+  // Band objects get consecutive global ids, band by band.
+  vector<uint32_t> offset(num_bands + 1, 0);
+  for (size_t band = 0; band < num_bands; ++band)
+    offset[band + 1] = offset[band] + num_objects[band];
+
+  // Merge objects touching across the band borders, one border per
+  // thread, all sharing one lock-free table.
+  ConcurrentUnionFind borders(offset[num_bands]);
+  ParallelForBands(num_bands, num_bands,
+                   [&](size_t band, size_t, size_t) {
+    if (band == 0) return;
+    const size_t first_row = BandBegin(num_rows, num_bands, band);
+    const uint32_t *above = labels.Row(first_row - 1);
+    const uint32_t *below = labels.Row(first_row);
+    for (size_t j = 0; j < labels.num_columns(); ++j) {
+      if (above[j] == 0 || below[j] == 0) continue;
+      borders.Union(offset[band - 1] + relabel[band - 1][above[j]],
+                    offset[band] + relabel[band][below[j]]);
+    }
+  });
+
+  // Global ids follow the raster order of each band object's first
+  // pixel and roots are the smallest id of their set, so numbering roots
+  // in id order reproduces RasterScan( )'s numbering.
+  vector<uint32_t> final_label;
+  const uint32_t new_region = borders.Flatten(&final_label);
+  for (size_t band = 0; band < num_bands; ++band)
+    for (uint32_t &label : relabel[band])
+      if (label != 0) label = final_label[offset[band] + label];
+
+  // Pass 2: one table lookup per pixel.
+  ParallelForBands(num_rows, num_bands,
+                   [&](size_t band, size_t begin, size_t end) {
+    const vector<uint32_t> &table = relabel[band];
+    for (size_t i = begin; i < end; ++i) {
+      uint32_t *row = labels.Row(i);
+      for (size_t j = 0; j < labels.num_columns(); ++j)
+        row[j] = table[row[j]];
+    }
+  });
+
+  an_image->SetDepth(DepthForMaxValue(new_region));
+  an_image->SetNumberGrayLevels(new_region);
+  CV_METRIC_ADD(pixels, num_rows * labels.num_columns());
+  CV_METRIC_ADD(objects, new_region);
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,35 @@
+// Multi-threaded connected component labeling over horizontal bands.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_PARALLEL_LABELING_H_
+#define COMPUTER_VISION_PARALLEL_LABELING_H_
+
+#include "image.h"
+#include <cstddef>
+
+namespace ComputerVisionProjects {
+
+struct ParallelLabelingOptions {
+  // Number of bands labeled concurrently; 0 uses DefaultThreadCount().
+  size_t num_threads = 0;
+};
+
+/**
+ * ParallelRasterScan( ) labels a binary image with 4-connectivity like
+ * RasterScan( ), splitting it into horizontal bands that are labeled on
+ * separate threads with band-local provisional labels. Equivalences
+ * across band borders are then merged and every pixel is relabeled in
+ * parallel with a single table lookup.
+ * Objects are numbered in the raster order of their first pixel, so the
+ * result is identical to RasterScan( ) for any number of threads.
+ *
+ * @param {Image} an_image: input image, labeled in place
+ * @param {ParallelLabelingOptions} options: threading options
+ */
+void ParallelRasterScan(Image *an_image,
+                        const ParallelLabelingOptions &options =
+                            ParallelLabelingOptions());
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_PARALLEL_LABELING_H_
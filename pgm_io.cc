@@ -0,0 +1,622 @@
+// Low-level support for reading and writing pgm images: header parsing,
+// an ASCII (P2) tokenizer, read-only memory-mapped access to
+// binary (P5) rasters and buffered output sinks.
+// To be used in Computer Vision class.
+
+#include "pgm_io.h"
+#include "histogram.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+// Sets product to a * b. Returns false, leaving it alone, on overflow.
+bool MultiplySizes(size_t a, size_t b, size_t *product) {
+  if (a != 0 && b > SIZE_MAX / a) return false;
+  *product = a * b;
+  return true;
+}
+
+bool IsDigit(unsigned char c) { return c >= '0' && c <= '9'; }
+
+bool IsSpace(unsigned char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+         c == '\v' || c == '\f';
+}
+
+// Appends the digits of data[*position, size) to number, stopping at the
+// first other byte, and leaves position past them. Digits may arrive in
+// several calls as long as number is kept between them. Returns false if
+// the number does not fit in a size_t.
+bool ParseDigits(const unsigned char *data, size_t size, size_t *position,
+                 size_t *number) {
+  for (; *position < size && IsDigit(data[*position]); ++*position) {
+    if (*number > (SIZE_MAX - 9) / 10) return false;
+    *number = *number * 10 + (data[*position] - '0');
+  }
+  return true;
+}
+
+// Reads whitespace separated unsigned decimal numbers,
+// skipping '#' comments up to the end of their line.
+class PgmTokenizer {
+ public:
+  PgmTokenizer(const unsigned char *data, size_t size, size_t position)
+      : data_{data}, size_{size}, position_{position} { }
+
+  size_t position() const { return position_; }
+
+  // Returns false if no number is left before the end of the data,
+  // or if the number does not fit in a size_t.
+  bool NextNumber(size_t *value) {
+    SkipSpaceAndComments();
+    if (position_ >= size_ || !IsDigit(data_[position_])) return false;
+    size_t number = 0;
+    if (!ParseDigits(data_, size_, &position_, &number)) return false;
+    *value = number;
+    return true;
+  }
+
+ private:
+  void SkipSpaceAndComments() {
+    while (position_ < size_) {
+      if (IsSpace(data_[position_])) {
+        ++position_;
+      } else if (data_[position_] == '#') {
+        while (position_ < size_ && data_[position_] != '\n') ++position_;
+      } else {
+        break;
+      }
+    }
+  }
+
+  const unsigned char *data_;
+  size_t size_;
+  size_t position_;
+};
+
+}  // namespace
+
+bool ParsePgmHeader(const unsigned char *data, size_t size,
+                    PgmHeader *header) {
+  if (header == nullptr) abort();
+  if (size < 2 || data[0] != 'P' ||
+      (data[1] != '2' && data[1] != '4' && data[1] != '5'))
+    return false;
+
+  PgmTokenizer tokenizer(data, size, 2);
+  size_t num_columns, num_rows, max_value = 1;
+  if (!tokenizer.NextNumber(&num_columns) ||
+      !tokenizer.NextNumber(&num_rows) ||
+      (data[1] != '4' && !tokenizer.NextNumber(&max_value)))
+    return false;
+  if (max_value > 65535 || num_columns == 0 || num_rows == 0) return false;
+
+  // The decoded image holds a pixel for each of them, whatever the format.
+  size_t num_pixels;
+  if (!MultiplySizes(num_rows, num_columns, &num_pixels)) return false;
+  size_t raster_size = num_pixels;
+  if (data[1] == '4') {
+    raster_size = num_rows * ((num_columns + 7) / 8);
+  } else if (data[1] == '5' && max_value > 255 &&
+             !MultiplySizes(num_pixels, 2, &raster_size)) {
+    return false;
+  }
+
+  header->format = data[1];
+  header->num_columns = num_columns;
+  header->num_rows = num_rows;
+  header->max_value = max_value;
+  // A single whitespace character separates the header from the raster.
+  header->raster_offset = tokenizer.position() + 1;
+  header->raster_size = raster_size;
+  return header->raster_offset <= size || header->format == '2';
+}
+
+MappedPgm::~MappedPgm() {
+  Close();
+}
+
+bool MappedPgm::Open(const string &filename) {
+  Close();
+  const int descriptor = open(filename.c_str(), O_RDONLY);
+  if (descriptor < 0) return false;
+
+  struct stat status;
+  if (fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) &&
+      status.st_size > 0) {
+    void *address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE,
+                         descriptor, 0);
+    if (address != MAP_FAILED) {
+      madvise(address, status.st_size, MADV_SEQUENTIAL);
+      data_ = static_cast<const unsigned char *>(address);
+      size_ = status.st_size;
+      mapped_ = true;
+    }
+  }
+
+  if (!mapped_) {
+    // Not mappable: pull the whole file in with as few reads as possible.
+    unsigned char chunk[1 << 16];
+    ssize_t count;
+    while ((count = read(descriptor, chunk, sizeof chunk)) > 0)
+      buffer_.insert(buffer_.end(), chunk, chunk + count);
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+  }
+  close(descriptor);
+
+  // The raster must fit in the file before any image is sized from it.
+  // ASCII samples may follow the header without the single separator.
+  if (!ParsePgmHeader(data_, size_, &header_) ||
+      size_ - (header_.raster_offset - (header_.format == '2')) <
+          header_.raster_size) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void MappedPgm::Close() {
+  if (mapped_) munmap(const_cast<unsigned char *>(data_), size_);
+  buffer_.clear();
+  data_ = nullptr;
+  size_ = 0;
+  mapped_ = false;
+  header_ = PgmHeader();
+}
+
+ImagePlane<const uint8_t> MappedPgm::View() const {
+  if (header_.format != '5' || header_.bytes_per_pixel() != 1 ||
+      size_ - header_.raster_offset < header_.raster_size)
+    return ImagePlane<const uint8_t>();
+  return ImagePlane<const uint8_t>(data_ + header_.raster_offset,
+                                   header_.num_rows, header_.num_columns,
+                                   header_.num_columns);
+}
+
+bool DecodePgmRaster(const MappedPgm &a_pgm, Image *an_image,
+                     GrayHistogram *histogram) {
+  if (an_image == nullptr) abort();
+  const PgmHeader &header = a_pgm.header();
+  const size_t num_rows = header.num_rows;
+  const size_t num_columns = header.num_columns;
+  an_image->AllocateSpaceAndSetSize(num_rows, num_columns,
+                                    DepthForMaxValue(header.max_value));
+  an_image->SetNumberGrayLevels(header.max_value);
+
+  if (header.format == '2') {
+    PgmTokenizer tokenizer(a_pgm.data(), a_pgm.size(),
+                           header.raster_offset - 1);
+    // A sample above the maximum gray value would not fit the depth
+    // chosen for it, so the file is rejected instead of truncated.
+    const size_t max_value = header.max_value;
+    const bool complete = VisitPlane(an_image, [&](auto plane) {
+      for (size_t i = 0; i < plane.num_rows(); ++i) {
+        auto *row = plane.Row(i);
+        for (size_t j = 0; j < plane.num_columns(); ++j) {
+          size_t value;
+          if (!tokenizer.NextNumber(&value) || value > max_value)
+            return false;
+          row[j] = value;
+        }
+      }
+      return true;
+    });
+    if (complete && histogram != nullptr)
+      ComputeHistogram(*an_image, histogram);
+    return complete;
+  }
+
+  const size_t row_bytes = header.format == '4'
+                               ? (num_columns + 7) / 8
+                               : num_columns * header.bytes_per_pixel();
+  if (a_pgm.size() - header.raster_offset < header.raster_size)
+    return false;
+  const unsigned char *raster = a_pgm.data() + header.raster_offset;
+
+  if (header.format == '4') {
+    // Eight pixels per byte, leftmost pixel in the most significant bit.
+    ImagePlane<uint8_t> plane = an_image->Plane<uint8_t>();
+    for (size_t i = 0; i < num_rows; ++i) {
+      const unsigned char *bits = raster + i * row_bytes;
+      uint8_t *row = plane.Row(i);
+      for (size_t j = 0; j < num_columns; ++j)
+        row[j] = (bits[j / 8] >> (7 - j % 8)) & 1;
+    }
+  } else if (header.bytes_per_pixel() == 1 && histogram != nullptr) {
+    // Count each row while it is still in cache from the copy.
+    ImagePlane<uint8_t> plane = an_image->Plane<uint8_t>();
+    const size_t num_bands = num_rows * num_columns >= kParallelHistogramPixels
+                                 ? DefaultThreadCount() : 1;
+    vector<GrayHistogram> partials(num_bands);
+    ParallelForBands(num_rows, num_bands,
+                     [&](size_t band, size_t begin, size_t end) {
+      HistogramAccumulator accumulator;
+      for (size_t i = begin; i < end; ++i) {
+        memcpy(plane.Row(i), raster + i * row_bytes, row_bytes);
+        accumulator.Add(plane.Row(i), num_columns);
+      }
+      accumulator.FlushTo(&partials[band]);
+    });
+    histogram->Clear();
+    histogram->SetShift(0);
+    for (const GrayHistogram &partial : partials) histogram->Add(partial);
+    return true;
+  } else if (header.bytes_per_pixel() == 1) {
+    ImagePlane<uint8_t> plane = an_image->Plane<uint8_t>();
+    for (size_t i = 0; i < num_rows; ++i)
+      memcpy(plane.Row(i), raster + i * row_bytes, row_bytes);
+  } else {
+    ImagePlane<uint16_t> plane = an_image->Plane<uint16_t>();
+    for (size_t i = 0; i < num_rows; ++i) {
+      const unsigned char *samples = raster + i * row_bytes;
+      uint16_t *row = plane.Row(i);
+      for (size_t j = 0; j < num_columns; ++j)
+        row[j] = (samples[2 * j] << 8) | samples[2 * j + 1];
+    }
+  }
+  if (histogram != nullptr) ComputeHistogram(*an_image, histogram);
+  return true;
+}
+
+namespace {
+
+// Size of the PgmRowReader buffer; also the longest header it can parse.
+const size_t kRowReaderBufferSize = 1 << 16;
+
+}  // namespace
+
+PgmRowReader::~PgmRowReader() {
+  Close();
+}
+
+bool PgmRowReader::Open(const string &filename) {
+  Close();
+  descriptor_ = open(filename.c_str(), O_RDONLY);
+  if (descriptor_ < 0) return false;
+  buffer_.resize(kRowReaderBufferSize);
+  // A short file leaves less than a buffer, which is fine.
+  Ensure(kRowReaderBufferSize);
+  if (!ParsePgmHeader(buffer_.data(), end_, &header_)) {
+    Close();
+    return false;
+  }
+  // ASCII samples may follow the header without the single separator.
+  begin_ = header_.format == '2' ? header_.raster_offset - 1
+                                 : header_.raster_offset;
+  // Callers size their rows from the header, so a regular file must
+  // hold the raster it announces; pipes are only found short row by row.
+  struct stat status;
+  if (fstat(descriptor_, &status) == 0 && S_ISREG(status.st_mode) &&
+      (static_cast<size_t>(status.st_size) < begin_ ||
+       static_cast<size_t>(status.st_size) - begin_ < header_.raster_size)) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void PgmRowReader::Close() {
+  if (descriptor_ >= 0) close(descriptor_);
+  descriptor_ = -1;
+  header_ = PgmHeader();
+  begin_ = end_ = 0;
+  num_rows_read_ = 0;
+}
+
+bool PgmRowReader::Ensure(size_t count) {
+  if (end_ - begin_ >= count) return true;
+  if (begin_ > 0) {
+    memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+  }
+  while (end_ < count) {
+    const ssize_t got = read(descriptor_, buffer_.data() + end_,
+                             buffer_.size() - end_);
+    if (got <= 0) return false;
+    end_ += got;
+  }
+  return true;
+}
+
+// Same grammar as PgmTokenizer, refilling the buffer on the way.
+bool PgmRowReader::NextNumber(size_t *value) {
+  for (;;) {
+    if (!Ensure(1)) return false;
+    const unsigned char c = buffer_[begin_];
+    if (c == '#') {
+      while (Ensure(1) && buffer_[begin_] != '\n') ++begin_;
+    } else if (IsSpace(c)) {
+      ++begin_;
+    } else {
+      break;
+    }
+  }
+  if (!IsDigit(buffer_[begin_])) return false;
+  // A number may run past the end of what is buffered.
+  size_t number = 0;
+  do {
+    if (!ParseDigits(buffer_.data(), end_, &begin_, &number)) return false;
+  } while (begin_ == end_ && Ensure(1));
+  *value = number;
+  return true;
+}
+
+bool PgmRowReader::ReadRow(uint16_t *samples) {
+  if (descriptor_ < 0 || num_rows_read_ >= header_.num_rows) return false;
+  const size_t num_columns = header_.num_columns;
+  if (header_.format == '2') {
+    for (size_t j = 0; j < num_columns; ++j) {
+      size_t value;
+      if (!NextNumber(&value) || value > header_.max_value) return false;
+      samples[j] = value;
+    }
+  } else if (header_.format == '4') {
+    // Eight pixels per byte, leftmost pixel in the most significant bit.
+    const size_t row_bytes = (num_columns + 7) / 8;
+    for (size_t byte = 0; byte < row_bytes;) {
+      const size_t chunk = min(row_bytes - byte, buffer_.size());
+      if (!Ensure(chunk)) return false;
+      for (size_t k = 0; k < chunk; ++k, ++byte)
+        for (size_t bit = 0; bit < 8 && 8 * byte + bit < num_columns; ++bit)
+          samples[8 * byte + bit] = (buffer_[begin_ + k] >> (7 - bit)) & 1;
+      begin_ += chunk;
+    }
+  } else {
+    // Binary samples, big-endian when they take two bytes; rows longer
+    // than the buffer go through it in pieces.
+    const size_t bytes_per_pixel = header_.bytes_per_pixel();
+    const size_t chunk_pixels = buffer_.size() / bytes_per_pixel;
+    for (size_t j = 0; j < num_columns;) {
+      const size_t chunk = min(num_columns - j, chunk_pixels);
+      if (!Ensure(chunk * bytes_per_pixel)) return false;
+      const unsigned char *bytes = buffer_.data() + begin_;
+      if (bytes_per_pixel == 1) {
+        for (size_t k = 0; k < chunk; ++k) samples[j + k] = bytes[k];
+      } else {
+        for (size_t k = 0; k < chunk; ++k)
+          samples[j + k] = (bytes[2 * k] << 8) | bytes[2 * k + 1];
+      }
+      begin_ += chunk * bytes_per_pixel;
+      j += chunk;
+    }
+  }
+  ++num_rows_read_;
+  return true;
+}
+
+namespace {
+
+// Writes all first_size bytes of first and then all second_size bytes
+// of second to descriptor with writev(), retrying short writes.
+bool WriteFully(int descriptor, const unsigned char *first, size_t first_size,
+                const unsigned char *second, size_t second_size) {
+  struct iovec pieces[2] = {
+      {const_cast<unsigned char *>(first), first_size},
+      {const_cast<unsigned char *>(second), second_size}};
+  struct iovec *next = pieces;
+  int num_pieces = 2;
+  while (num_pieces > 0) {
+    if (next->iov_len == 0) {
+      ++next;
+      --num_pieces;
+      continue;
+    }
+    const ssize_t count = writev(descriptor, next, num_pieces);
+    if (count < 0) return false;
+    // Skip what went out, possibly ending in the middle of a piece.
+    size_t left = count;
+    while (num_pieces > 0 && left >= next->iov_len) {
+      left -= next->iov_len;
+      ++next;
+      --num_pieces;
+    }
+    if (num_pieces > 0) {
+      next->iov_base = static_cast<unsigned char *>(next->iov_base) + left;
+      next->iov_len -= left;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+FilePgmSink::~FilePgmSink() {
+  if (descriptor_ >= 0) close(descriptor_);
+}
+
+bool FilePgmSink::Open(const string &filename) {
+  if (descriptor_ >= 0) close(descriptor_);
+  num_staged_ = 0;
+  descriptor_ = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  return descriptor_ >= 0;
+}
+
+bool FilePgmSink::Write(const void *data, size_t size) {
+  if (descriptor_ < 0) return false;
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  if (size <= kStageSize - num_staged_) {
+    memcpy(staged_ + num_staged_, bytes, size);
+    num_staged_ += size;
+    return true;
+  }
+  const size_t num_staged = num_staged_;
+  num_staged_ = 0;
+  return WriteFully(descriptor_, staged_, num_staged, bytes, size);
+}
+
+bool FilePgmSink::Finish() {
+  if (descriptor_ < 0) return false;
+  const bool written =
+      WriteFully(descriptor_, staged_, num_staged_, nullptr, 0);
+  num_staged_ = 0;
+  const bool closed = close(descriptor_) == 0;
+  descriptor_ = -1;
+  return written && closed;
+}
+
+MappedFilePgmSink::~MappedFilePgmSink() {
+  Unmap();
+  if (descriptor_ >= 0) close(descriptor_);
+}
+
+bool MappedFilePgmSink::Open(const string &filename) {
+  Unmap();
+  if (descriptor_ >= 0) close(descriptor_);
+  descriptor_ = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  return descriptor_ >= 0;
+}
+
+bool MappedFilePgmSink::Reserve(size_t size) {
+  if (descriptor_ < 0 || data_ != nullptr) return false;
+  if (size == 0) return true;
+  if (ftruncate(descriptor_, size) != 0) return false;
+  void *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       descriptor_, 0);
+  if (address == MAP_FAILED) return false;
+  data_ = static_cast<unsigned char *>(address);
+  size_ = size;
+  position_ = 0;
+  return true;
+}
+
+bool MappedFilePgmSink::Write(const void *data, size_t size) {
+  if (size > size_ - position_) return false;
+  memcpy(data_ + position_, data, size);
+  position_ += size;
+  return true;
+}
+
+bool MappedFilePgmSink::Finish() {
+  if (descriptor_ < 0) return false;
+  const bool complete = position_ == size_;
+  Unmap();
+  const bool closed = close(descriptor_) == 0;
+  descriptor_ = -1;
+  return complete && closed;
+}
+
+void MappedFilePgmSink::Unmap() {
+  if (data_ != nullptr) munmap(data_, size_);
+  data_ = nullptr;
+  size_ = 0;
+  position_ = 0;
+}
+
+bool MemoryPgmSink::Reserve(size_t size) {
+  buffer_->reserve(buffer_->size() + size);
+  return true;
+}
+
+bool MemoryPgmSink::Write(const void *data, size_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  buffer_->insert(buffer_->end(), bytes, bytes + size);
+  return true;
+}
+
+bool OstreamPgmSink::Reserve(size_t size) {
+  buffer_.reserve(buffer_.size() + size);
+  return true;
+}
+
+bool OstreamPgmSink::Write(const void *data, size_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  buffer_.insert(buffer_.end(), bytes, bytes + size);
+  return true;
+}
+
+bool OstreamPgmSink::Finish() {
+  output_.write(reinterpret_cast<const char *>(buffer_.data()),
+                buffer_.size());
+  buffer_.clear();
+  output_.flush();
+  return output_.good();
+}
+
+bool EncodePgm(const Image &an_image, PgmSink *sink) {
+  return EncodePgm(an_image, nullptr, sink);
+}
+
+bool EncodePgm(const Image &an_image, const Image *overlay, PgmSink *sink) {
+  if (sink == nullptr) abort();
+  if (overlay != nullptr &&
+      (overlay->num_rows() != an_image.num_rows() ||
+       overlay->num_columns() != an_image.num_columns() ||
+       overlay->depth() != PixelDepth::kUint8))
+    abort();
+  const size_t num_rows = an_image.num_rows();
+  const size_t num_columns = an_image.num_columns();
+  const size_t colors = an_image.num_gray_levels();
+  const size_t bytes_per_pixel = colors > 255 ? 2 : 1;
+  const size_t row_bytes = num_columns * bytes_per_pixel;
+
+  // Same header as always: magic number, empty comment, size, colors.
+  char header[64];
+  const int header_size = snprintf(header, sizeof header,
+                                   "P5\n#\n%zu %zu\n%03zu\n",
+                                   num_columns, num_rows, colors);
+  if (!sink->Reserve(header_size + num_rows * row_bytes) ||
+      !sink->Write(header, header_size))
+    return false;
+
+  // 8-bit pixels go out as they are only when the file has one byte per
+  // pixel too; more than 255 gray levels widen them below.
+  if (an_image.depth() == PixelDepth::kUint8 && bytes_per_pixel == 1 &&
+      overlay == nullptr) {
+    ImagePlane<const uint8_t> plane = an_image.Plane<uint8_t>();
+    if (plane.stride() == num_columns)
+      return sink->Write(plane.data(), num_rows * row_bytes);
+    for (size_t i = 0; i < num_rows; ++i)
+      if (!sink->Write(plane.Row(i), row_bytes)) return false;
+    return true;
+  }
+
+  // Wider pixels are narrowed to 8 or 16 big-endian bits a piece of a
+  // row at a time, and the overlay is laid over each row on the way.
+  unsigned char samples[4096];
+  const size_t piece_pixels = sizeof samples / bytes_per_pixel;
+  const auto encode_row = [&](const auto *row, const uint8_t *over) {
+    for (size_t begin = 0; begin < num_columns; begin += piece_pixels) {
+      const size_t end = min(num_columns, begin + piece_pixels);
+      for (size_t j = begin; j < end; ++j) {
+        const uint32_t value =
+            (over != nullptr && over[j] != 0) ? over[j] : row[j];
+        unsigned char *sample = samples + (j - begin) * bytes_per_pixel;
+        if (bytes_per_pixel == 1) {
+          sample[0] = static_cast<unsigned char>(value);
+        } else {
+          sample[0] = static_cast<unsigned char>(value >> 8);
+          sample[1] = static_cast<unsigned char>(value);
+        }
+      }
+      if (!sink->Write(samples, (end - begin) * bytes_per_pixel))
+        return false;
+    }
+    return true;
+  };
+  return VisitPlane(an_image, [&](auto plane) {
+    for (size_t i = 0; i < num_rows; ++i) {
+      const uint8_t *over = overlay == nullptr
+                                ? nullptr
+                                : overlay->Plane<uint8_t>().Row(i);
+      if (!encode_row(plane.Row(i), over)) return false;
+    }
+    return true;
+  });
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,269 @@
+// Low-level support for reading and writing pgm images: header parsing,
+// an ASCII (P2) tokenizer, read-only memory-mapped access to
+// binary (P5) rasters and buffered output sinks.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_PGM_IO_H_
+#define COMPUTER_VISION_PGM_IO_H_
+
+#include "image.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+class GrayHistogram;
+
+// Description of a pgm file as found in its header.
+struct PgmHeader {
+  // '2' for ASCII (P2) files, '5' for binary (P5) files,
+  // '4' for bit-packed pbm (P4) files.
+  char format = 0;
+  size_t num_columns = 0;
+  size_t num_rows = 0;
+  // Always 1 for pbm files, which have no maximum gray value field.
+  size_t max_value = 0;
+  // Offset of the first raster byte from the start of the file.
+  size_t raster_offset = 0;
+  // Bytes of a binary raster; for ASCII files the fewest bytes its
+  // samples can take, one digit each.
+  size_t raster_size = 0;
+
+  // Binary files store two big-endian bytes per pixel when max_value > 255.
+  size_t bytes_per_pixel() const { return max_value > 255 ? 2 : 1; }
+};
+
+/**
+ * ParsePgmHeader( ) parses the magic number, size and maximum gray value
+ * at the start of a pgm (or P4 pbm) file, skipping '#' comments.
+ *
+ * @param {unsigned char} data: the first bytes of the file
+ * @param {size_t} size: number of bytes available in data
+ * @param {PgmHeader} header: the parsed header
+ * @return true if data starts with a valid P2, P4 or P5 header whose
+ *         size is not zero and whose raster size fits in a size_t
+ */
+bool ParsePgmHeader(const unsigned char *data, size_t size,
+                    PgmHeader *header);
+
+// Read-only view of the contents of a pgm file.
+// The file is mapped with mmap when possible, so that 8-bit binary
+// rasters can be used in place without copying; files that cannot be
+// mapped (pipes, special files) are read in a single bulk read instead.
+// Sample usage:
+//   MappedPgm pgm;
+//   if (pgm.Open("many_objects_1.pgm")) {
+//     ImagePlane<const uint8_t> pixels = pgm.View();
+//     ...
+//   }
+class MappedPgm {
+ public:
+  MappedPgm(): data_{nullptr}, size_{0}, mapped_{false} { }
+  MappedPgm(const MappedPgm &a_pgm) = delete;
+  MappedPgm& operator=(const MappedPgm &a_pgm) = delete;
+
+  ~MappedPgm();
+
+  // Opens filename and parses its header.
+  // Returns true if everything is OK, false otherwise.
+  bool Open(const std::string &filename);
+  void Close();
+
+  const PgmHeader &header() const { return header_; }
+  const unsigned char *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool mapped() const { return mapped_; }
+
+  // Zero-copy view of the raster. Only available for complete 8-bit
+  // binary files; returns an empty plane otherwise.
+  ImagePlane<const uint8_t> View() const;
+
+ private:
+  PgmHeader header_;
+  const unsigned char *data_;
+  size_t size_;
+  bool mapped_;
+  std::vector<unsigned char> buffer_;
+};
+
+/**
+ * DecodePgmRaster( ) copies the raster of an opened pgm file into
+ * an_image, converting ASCII and 16-bit big-endian samples as needed.
+ * 8-bit binary rasters are copied a row at a time. Pbm rasters become
+ * an 8-bit image of 0s and 1s, as ConvertToBinary( ) produces.
+ * When histogram is not null the gray-level histogram is accumulated
+ * while the raster is copied, on several threads for large 8-bit images.
+ *
+ * @param {MappedPgm} a_pgm: the opened file
+ * @param {Image} an_image: the resulting image
+ * @param {GrayHistogram} histogram: optional histogram of the image
+ * @return false if the raster is shorter than the header announces or
+ *         an ASCII sample exceeds the maximum gray value
+ */
+bool DecodePgmRaster(const MappedPgm &a_pgm, Image *an_image,
+                     GrayHistogram *histogram = nullptr);
+
+// Reads a pgm (or pbm) file one row at a time through a fixed-size
+// buffer, for images too large to hold in memory. Samples come out as
+// 16-bit gray levels whatever the format; pbm pixels are 0 or 1.
+// Sample usage:
+//   PgmRowReader reader;
+//   if (reader.Open("line_scan.pgm")) {
+//     std::vector<uint16_t> row(reader.header().num_columns);
+//     while (reader.ReadRow(row.data())) ...
+//   }
+class PgmRowReader {
+ public:
+  PgmRowReader(): descriptor_{-1}, begin_{0}, end_{0}, num_rows_read_{0} { }
+  PgmRowReader(const PgmRowReader &a_reader) = delete;
+  PgmRowReader& operator=(const PgmRowReader &a_reader) = delete;
+
+  ~PgmRowReader();
+
+  // Opens filename and parses its header. For a regular file, also
+  // checks that the file is long enough for the raster in the header.
+  // Returns true if everything is OK, false otherwise.
+  bool Open(const std::string &filename);
+  void Close();
+
+  const PgmHeader &header() const { return header_; }
+  size_t num_rows_read() const { return num_rows_read_; }
+
+  // Reads the next row into samples, header().num_columns of them.
+  // Returns false after the last row, when the file is short or when an
+  // ASCII sample exceeds the maximum gray value.
+  bool ReadRow(uint16_t *samples);
+
+ private:
+  // Makes at least count bytes available at begin_, reading more when
+  // needed. Returns false when the file ends first.
+  bool Ensure(size_t count);
+  bool NextNumber(size_t *value);
+
+  int descriptor_;
+  PgmHeader header_;
+  std::vector<unsigned char> buffer_;
+  // Unconsumed bytes are buffer_[begin_, end_).
+  size_t begin_;
+  size_t end_;
+  size_t num_rows_read_;
+};
+
+// Destination of an encoded pgm image.
+// EncodePgm() announces the total size with Reserve(), hands over the
+// bytes with one or more Write() calls and ends with Finish().
+class PgmSink {
+ public:
+  virtual ~PgmSink() { }
+
+  // Called once before the first Write() with the exact encoded size.
+  virtual bool Reserve(size_t /* size */) { return true; }
+  virtual bool Write(const void *data, size_t size) = 0;
+  // Pushes everything written so far to its destination.
+  virtual bool Finish() { return true; }
+};
+
+// Writes the image to a file without copying its pixels. Short writes,
+// such as the header and converted rows, are staged in a fixed buffer
+// inside the sink; a write that does not fit goes out at once, after
+// what is staged, in a single writev(). A contiguous 8-bit image thus
+// reaches the file with its header in one system call, and nothing is
+// allocated.
+class FilePgmSink : public PgmSink {
+ public:
+  FilePgmSink(): descriptor_{-1}, num_staged_{0} { }
+  FilePgmSink(const FilePgmSink &a_sink) = delete;
+  FilePgmSink& operator=(const FilePgmSink &a_sink) = delete;
+
+  ~FilePgmSink();
+
+  // Creates (or truncates) filename. Returns false if it cannot be opened.
+  bool Open(const std::string &filename);
+
+  bool Write(const void *data, size_t size) override;
+  bool Finish() override;
+
+ private:
+  static const size_t kStageSize = 1 << 15;
+
+  int descriptor_;
+  // Bytes written but not yet sent are staged_[0, num_staged_).
+  unsigned char staged_[kStageSize];
+  size_t num_staged_;
+};
+
+// Sizes the file up front and encodes straight into a shared memory
+// mapping of it, so that no intermediate buffer or write() is needed.
+class MappedFilePgmSink : public PgmSink {
+ public:
+  MappedFilePgmSink(): descriptor_{-1}, data_{nullptr}, size_{0},
+                       position_{0} { }
+  MappedFilePgmSink(const MappedFilePgmSink &a_sink) = delete;
+  MappedFilePgmSink& operator=(const MappedFilePgmSink &a_sink) = delete;
+
+  ~MappedFilePgmSink();
+
+  bool Open(const std::string &filename);
+
+  bool Reserve(size_t size) override;
+  bool Write(const void *data, size_t size) override;
+  bool Finish() override;
+
+ private:
+  void Unmap();
+
+  int descriptor_;
+  unsigned char *data_;
+  size_t size_;
+  size_t position_;
+};
+
+// Appends the encoded image to a caller-owned byte buffer.
+class MemoryPgmSink : public PgmSink {
+ public:
+  explicit MemoryPgmSink(std::vector<unsigned char> *buffer)
+      : buffer_{buffer} { }
+
+  bool Reserve(size_t size) override;
+  bool Write(const void *data, size_t size) override;
+
+ private:
+  std::vector<unsigned char> *buffer_;
+};
+
+// Buffers the encoded image and hands it to an ostream in one write().
+class OstreamPgmSink : public PgmSink {
+ public:
+  explicit OstreamPgmSink(std::ostream &output): output_(output) { }
+
+  bool Reserve(size_t size) override;
+  bool Write(const void *data, size_t size) override;
+  bool Finish() override;
+
+ private:
+  std::ostream &output_;
+  std::vector<unsigned char> buffer_;
+};
+
+/**
+ * EncodePgm( ) serializes an_image as a binary (P5) pgm file into sink.
+ * Images with at most 255 gray levels are written with one byte per
+ * pixel, others with two big-endian bytes. Contiguous 8-bit images are
+ * handed to the sink in a single Write().
+ *
+ * @param {Image} an_image: input image
+ * @param {PgmSink} sink: destination of the encoded bytes
+ * @return true if the sink accepted all the bytes
+ */
+bool EncodePgm(const Image &an_image, PgmSink *sink);
+
+// Same as above with the non-zero pixels of overlay, an 8-bit image of
+// the same size, written in place of those of an_image (see overlay.h).
+bool EncodePgm(const Image &an_image, const Image *overlay, PgmSink *sink);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_PGM_IO_H_
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * Title          : pipeline.cc
+ * Description    : recognizes objects of a gray-level image in one run:
+ *                  thresholds it (p1), labels and measures the objects
+ *                  (p2, p3) and matches them against the database (p4)
+ *                  in memory. The output image is the one p4 writes.
+ *                  With a dump prefix the intermediate images and the
+ *                  attribute database are written too, as {prefix}_p1.pgm,
+ *                  {prefix}_p2.pgm, {prefix}_p3.pgm and {prefix}_db.txt
+ * Purpose        : 
+ * Usage          : ./pipeline many_objects_1.pgm 125
+ *                              two_objects_database.txt
+ *                              many_objects_1_p4_out.pgm
+ *                              [many_objects_1]
+ * Build with     : make all
+ */
+#include "image.h"
+#include "histogram.h"
+#include "metrics.h"
+#include "model_database.h"
+#include "recognition_pipeline.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace ComputerVisionProjects;
+
+int main(int argc, char **argv){  
+  if (argc!=5 && argc!=6) {
+    printf("Usage: %s {input gray–level image} {input gray–level threshold | auto | otsu | triangle} {input database} {output image} [dump prefix]\n", argv[0]);
+    return 0;
+  }
+  const string input_file(argv[1]);
+  const string value(argv[2]);
+  const string input_database(argv[3]);
+  const string output_file(argv[4]);
+
+  PipelineOptions options;
+  options.automatic_threshold =
+      ParseThresholdMethod(value, &options.threshold_method);
+  if (!options.automatic_threshold)
+    options.threshold_value = stoi(value);  // convert string to int
+  if (argc == 6) options.dump_prefix = argv[5];
+
+  // stage times and counters of this run, with make all METRICS=1
+  ScopedFrameMetrics frame_metrics(input_file);
+
+  ModelDatabase database;
+  if (!LoadModelDatabase(input_database, &database)) {
+    cout << "Can't read database " << input_database << endl;
+    return 0;
+  }
+
+  RecognitionPipeline pipeline(options);
+  pipeline.SetModels(database);
+  PipelineResult result;
+  if (!pipeline.RunFile(input_file, output_file, &result)) return 0;
+
+  if (options.automatic_threshold)
+    cout << "Threshold: " << result.threshold_value << endl;
+  for (size_t i = 1; i < result.matches.size(); ++i)
+    for (const ObjectMatch &match : result.matches[i])
+      cout << "object " << i << " matches model "
+           << database.models[match.model].label << " (distance "
+           << match.distance << ")" << endl;
+}
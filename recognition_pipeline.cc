@@ -0,0 +1,134 @@
+// Threshold -> label -> measure -> match -> overlay in one process, on
+// one image buffer, without intermediate files.
+// To be used in Computer Vision class.
+
+#include "recognition_pipeline.h"
+#include "metrics.h"
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+void RecognitionPipeline::SetModels(const ModelDatabase &database) {
+  index_.Build(database.models, options_.match, database.tree_order);
+}
+
+bool RecognitionPipeline::Dump(const string &suffix, const Image &an_image,
+                               const Image *overlay) const {
+  const string filename = options_.dump_prefix + suffix;
+  const bool written = overlay == nullptr
+                           ? WriteImage(filename, an_image)
+                           : WriteImage(filename, an_image, *overlay);
+  if (!written) {
+    cout << "RecognitionPipeline: can't write " << filename << endl;
+    return false;
+  }
+  return true;
+}
+
+bool RecognitionPipeline::Run(Image *an_image, const GrayHistogram *histogram,
+                              PipelineResult *result) const {
+  RasterScanWorkspace workspace;
+  return Run(an_image, histogram, result, &workspace);
+}
+
+bool RecognitionPipeline::Run(Image *an_image, const GrayHistogram *histogram,
+                              PipelineResult *result,
+                              RasterScanWorkspace *workspace) const {
+  if (an_image == nullptr || result == nullptr || workspace == nullptr)
+    abort();
+  const bool dump = !options_.dump_prefix.empty();
+
+  // threshold (p1)
+  Threshold(an_image, histogram, result);
+  if (dump && !Dump("_p1.pgm", *an_image, nullptr)) return false;
+
+  // label and measure (p2, p3)
+  Label(an_image, result, workspace);
+  if (dump && !Dump("_p2.pgm", *an_image, nullptr)) return false;
+  Measure(result);
+  if (dump) {
+    // p3 draws on an overlay plane, leaving the labels for the match
+    Image overlay;
+    ResetOverlayPlane(*an_image, &overlay);
+    const string database_name = options_.dump_prefix + "_db.txt";
+    ofstream database_file(database_name);
+    if (database_file.fail()) {
+      cout << "RecognitionPipeline: can't write " << database_name << endl;
+      return false;
+    }
+    WriteObjectAttributes(database_file, result->objects, &overlay);
+    if (!Dump("_p3.pgm", *an_image, &overlay)) return false;
+  }
+
+  // match and overlay (p4)
+  Match(an_image, result);
+  return true;
+}
+
+void RecognitionPipeline::Threshold(Image *an_image,
+                                    const GrayHistogram *histogram,
+                                    PipelineResult *result) const {
+  if (an_image == nullptr || result == nullptr) abort();
+  CV_METRIC_STAGE(kMetricThreshold);
+  result->threshold_value = options_.threshold_value;
+  if (options_.automatic_threshold) {
+    GrayHistogram computed;
+    if (histogram == nullptr) {
+      ComputeHistogram(*an_image, &computed);
+      histogram = &computed;
+    }
+    result->threshold_value =
+        SelectThreshold(*histogram, options_.threshold_method);
+  }
+  ConvertToBinary(result->threshold_value, an_image);
+}
+
+void RecognitionPipeline::Label(Image *an_image, PipelineResult *result,
+                                RasterScanWorkspace *workspace) const {
+  if (an_image == nullptr || result == nullptr) abort();
+  CV_METRIC_STAGE(kMetricLabel);
+  RasterScan(an_image, &result->objects, workspace);
+}
+
+void RecognitionPipeline::Measure(PipelineResult *result) const {
+  if (result == nullptr) abort();
+  CV_METRIC_STAGE(kMetricMeasure);
+  LoadInertiaBatch(result->objects, &result->inertia);
+  ComputeInertia(&result->inertia, false);
+}
+
+void RecognitionPipeline::Match(Image *an_image,
+                                PipelineResult *result) const {
+  if (an_image == nullptr || result == nullptr) abort();
+  CV_METRIC_STAGE(kMetricMatch);
+  MatchObjects(index_, result->inertia, &result->matches);
+  result->annotations.Clear();
+  AnnotateMatchedObjects(result->inertia, result->matches,
+                         &result->annotations);
+  result->annotations.Render(an_image);
+}
+
+bool RecognitionPipeline::RunFile(const string &input_file,
+                                  const string &output_file,
+                                  PipelineResult *result) const {
+  GrayHistogram histogram;
+  Image an_image;
+  if (!ReadImage(input_file, &an_image,
+                 options_.automatic_threshold ? &histogram : nullptr)) {
+    cout << "RecognitionPipeline: can't open " << input_file << endl;
+    return false;
+  }
+  if (!Run(&an_image,
+           options_.automatic_threshold ? &histogram : nullptr, result))
+    return false;
+  if (!WriteImage(output_file, an_image)) {
+    cout << "RecognitionPipeline: can't write " << output_file << endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,112 @@
+// Threshold -> label -> measure -> match -> overlay in one process, on
+// one image buffer, without intermediate files.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_RECOGNITION_PIPELINE_H_
+#define COMPUTER_VISION_RECOGNITION_PIPELINE_H_
+
+#include "image.h"
+#include "histogram.h"
+#include "labeling_workspace.h"
+#include "model_database.h"
+#include "object_matcher.h"
+#include "object_moments.h"
+#include "overlay.h"
+#include <string>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+struct PipelineOptions {
+  // Threshold for ConvertToBinary( ), unless automatic_threshold is set.
+  int threshold_value = 125;
+  bool automatic_threshold = false;
+  ThresholdMethod threshold_method = ThresholdMethod::kOtsu;
+  MatchOptions match;
+  // When not empty, each stage also writes what the separate program
+  // would have: dump_prefix + "_p1.pgm" (binary image), "_p2.pgm"
+  // (labels), "_p3.pgm" and "_db.txt" (attributes of the scene objects).
+  std::string dump_prefix;
+};
+
+// What a run found, for callers that want more than the overlay image.
+struct PipelineResult {
+  int threshold_value = 0;
+  // Features of objects 1..n, index 0 unused.
+  std::vector<ObjectFeatures> objects;
+  InertiaBatch inertia;
+  // matches[i] holds the models object i matched.
+  std::vector<std::vector<ObjectMatch>> matches;
+  // Orientation lines of the matched objects, drawn by Match( ).
+  OverlayBatch annotations;
+};
+
+// Runs the p1 -> p2 -> p4 chain on an image in memory. Each stage is
+// the function the programs use: ConvertToBinary( ), the fused
+// RasterScan( ) that measures the objects while labeling them, then
+// the inertia batch, the model index and DrawMatchedObjects( ) that
+// CompareObjectAttributes( ) is made of. The result is the image p4
+// writes for the same input.
+//
+// Example:
+//   RecognitionPipeline pipeline(options);
+//   pipeline.SetModels(database);
+//   pipeline.RunFile("many_objects_1.pgm", "many_objects_1_out.pgm", &result);
+class RecognitionPipeline {
+ public:
+  explicit RecognitionPipeline(const PipelineOptions &options)
+      : options_(options) { }
+
+  const PipelineOptions &options() const { return options_; }
+
+  // Builds the model index the match stage looks up.
+  void SetModels(const ModelDatabase &database);
+
+  /**
+   * Run( ) recognizes the objects of a gray-level image in place.
+   *
+   * @param {Image} an_image: the input frame; receives the overlay
+   * @param {GrayHistogram} histogram: histogram of the frame for an
+   *                        automatic threshold, or null to compute it
+   * @param {PipelineResult} result: threshold, objects and matches
+   * @return false (with a message) when a debugging dump fails
+   */
+  bool Run(Image *an_image, const GrayHistogram *histogram,
+           PipelineResult *result) const;
+
+  // Same as above with the labeling buffers taken from workspace. With
+  // an_image, result and workspace all reused from the previous frame,
+  // a frame of similar size and content runs without allocating.
+  bool Run(Image *an_image, const GrayHistogram *histogram,
+           PipelineResult *result, RasterScanWorkspace *workspace) const;
+
+  // The stages Run( ) is made of, for callers that run them on separate
+  // threads. Each one expects the result of the previous one in result.
+  // Threshold( ) binarizes an_image (p1).
+  void Threshold(Image *an_image, const GrayHistogram *histogram,
+                 PipelineResult *result) const;
+  // Label( ) labels an_image and measures its objects (p2, p3).
+  void Label(Image *an_image, PipelineResult *result,
+             RasterScanWorkspace *workspace) const;
+  // Measure( ) computes the inertia batch of the objects.
+  void Measure(PipelineResult *result) const;
+  // Match( ) matches the objects and draws the matched ones (p4).
+  void Match(Image *an_image, PipelineResult *result) const;
+
+  // Reads input_file (gathering the histogram while reading when the
+  // threshold is automatic), runs the pipeline and writes the overlay.
+  bool RunFile(const std::string &input_file, const std::string &output_file,
+               PipelineResult *result) const;
+
+ private:
+  // Writes an_image, with overlay laid over it when not null.
+  bool Dump(const std::string &suffix, const Image &an_image,
+            const Image *overlay) const;
+
+  PipelineOptions options_;
+  ObjectIndex index_;
+};
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_RECOGNITION_PIPELINE_H_
@@ -0,0 +1,158 @@
+// Connected component labeling on horizontal runs of foreground pixels.
+// To be used in Computer Vision class.
+
+#include "run_labeling.h"
+#include "binary_mask.h"
+#include "labeling_workspace.h"
+#include "metrics.h"
+#include "UnionFind.h"
+#include <algorithm>
+#include <type_traits>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+void ExtractRuns(const Image &an_image, RunLabeling *labeling) {
+  if (labeling == nullptr) abort();
+  labeling->num_rows = an_image.num_rows();
+  labeling->num_columns = an_image.num_columns();
+  labeling->runs.clear();
+  labeling->row_begin.assign(1, 0);
+  labeling->num_labels = 0;
+
+  VisitPlane(an_image, [labeling](auto plane) {
+    const uint32_t column = plane.num_columns();
+    for (uint32_t i = 0; i < plane.num_rows(); ++i) {
+      const auto *row = plane.Row(i);
+      uint32_t j = 0;
+      while (j < column) {
+        while (j < column && row[j] == 0) ++j;
+        if (j == column) break;
+        const uint32_t begin = j;
+        while (j < column && row[j] != 0) ++j;
+        labeling->runs.push_back(Run{i, begin, j, 0});
+      }
+      labeling->row_begin.push_back(labeling->runs.size());
+    }
+  });
+}
+
+void ExtractRuns(const BinaryMask &mask, RunLabeling *labeling) {
+  if (labeling == nullptr) abort();
+  labeling->num_rows = mask.num_rows();
+  labeling->num_columns = mask.num_columns();
+  labeling->runs.clear();
+  labeling->row_begin.assign(1, 0);
+  labeling->num_labels = 0;
+
+  const size_t kBits = BinaryMask::kBitsPerWord;
+  for (uint32_t i = 0; i < mask.num_rows(); ++i) {
+    const uint64_t *words = mask.Row(i);
+    bool inside = false;
+    uint32_t begin = 0;
+    for (size_t w = 0; w < mask.words_per_row(); ++w) {
+      // Runs start where the bits go 0 -> 1 and end where they go 1 -> 0;
+      // find those transitions with count-trailing-zeros.
+      uint64_t word = words[w];
+      if (inside) word = ~word;
+      size_t position = 0;
+      while (position < kBits) {
+        const uint64_t remaining = word >> position;
+        if (remaining == 0) break;
+        position += __builtin_ctzll(remaining);
+        const uint32_t column = w * kBits + position;
+        if (!inside) {
+          begin = column;
+        } else {
+          labeling->runs.push_back(Run{i, begin, column, 0});
+        }
+        inside = !inside;
+        word = ~word;
+      }
+    }
+    if (inside)
+      labeling->runs.push_back(
+          Run{i, begin, static_cast<uint32_t>(mask.num_columns()), 0});
+    labeling->row_begin.push_back(labeling->runs.size());
+  }
+}
+
+void LabelRuns(RunLabeling *labeling) {
+  RasterScanWorkspace workspace;
+  LabelRuns(labeling, &workspace);
+}
+
+void LabelRuns(RunLabeling *labeling, RasterScanWorkspace *workspace) {
+  if (labeling == nullptr || workspace == nullptr) abort();
+  vector<Run> &runs = labeling->runs;
+  // One set per run: the table grows with the image, not a fixed cap.
+  UnionFind &equivalence_table = workspace->equivalence_table;
+  equivalence_table.Reset(runs.size());
+
+  for (size_t i = 1; i < labeling->num_rows; ++i) {
+    // Sweep the runs of the previous and current rows together,
+    // joining every pair that shares a column.
+    size_t above = labeling->row_begin[i - 1];
+    const size_t above_end = labeling->row_begin[i];
+    size_t current = labeling->row_begin[i];
+    const size_t current_end = labeling->row_begin[i + 1];
+    while (above < above_end && current < current_end) {
+      const Run &a = runs[above];
+      const Run &c = runs[current];
+      // Set labels are run indices shifted by one, 0 is background.
+      if (a.begin < c.end && c.begin < a.end)
+        equivalence_table.Union(above + 1, current + 1);
+      // Advance whichever run finishes first.
+      if (a.end <= c.end)
+        ++above;
+      else
+        ++current;
+    }
+  }
+
+  // Runs are in raster order, so flattening numbers the objects in
+  // raster order of their first run.
+  vector<uint32_t> &relabel = workspace->region_value;
+  labeling->num_labels = equivalence_table.Flatten(&relabel);
+  CV_METRIC(AddEquivalenceCounters(equivalence_table.counters()));
+  for (size_t r = 0; r < runs.size(); ++r) runs[r].label = relabel[r + 1];
+}
+
+void PaintRuns(const RunLabeling &labeling, Image *an_image) {
+  if (an_image == nullptr) abort();
+  an_image->AllocateSpaceAndSetSize(labeling.num_rows, labeling.num_columns,
+                                    DepthForMaxValue(labeling.num_labels));
+  an_image->SetNumberGrayLevels(labeling.num_labels);
+  VisitPlane(an_image, [&labeling](auto plane) {
+    typedef typename std::remove_pointer<decltype(plane.data())>::type
+        LabelType;
+    for (PixelSpan<LabelType> row : plane.Rows())
+      fill(row.begin(), row.end(), 0);
+    for (const Run &run : labeling.runs) {
+      const PixelSpan<LabelType> pixels =
+          plane.Span(run.row).Subspan(run.begin, run.end);
+      fill(pixels.begin(), pixels.end(), static_cast<LabelType>(run.label));
+    }
+  });
+}
+
+void RunLengthLabeling(Image *an_image) {
+  RunLabeling labeling;
+  RasterScanWorkspace workspace;
+  RunLengthLabeling(an_image, &labeling, &workspace);
+}
+
+void RunLengthLabeling(Image *an_image, RunLabeling *labeling,
+                       RasterScanWorkspace *workspace) {
+  if (an_image == nullptr || labeling == nullptr) abort();
+  CV_METRIC_STAGE(kMetricLabel);
+  ExtractRuns(*an_image, labeling);
+  LabelRuns(labeling, workspace);
+  PaintRuns(*labeling, an_image);
+  CV_METRIC_ADD(pixels, an_image->num_rows() * an_image->num_columns());
+  CV_METRIC_ADD(runs, labeling->runs.size());
+  CV_METRIC_ADD(objects, labeling->num_labels);
+}
+
+}  // namespace ComputerVisionProjects
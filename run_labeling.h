@@ -0,0 +1,85 @@
+// Connected component labeling on horizontal runs of foreground pixels.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_RUN_LABELING_H_
+#define COMPUTER_VISION_RUN_LABELING_H_
+
+#include "image.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+class BinaryMask;
+struct RasterScanWorkspace;
+
+// Maximal horizontal sequence of foreground pixels in one row:
+// columns [begin, end) of row.
+struct Run {
+  uint32_t row;
+  uint32_t begin;
+  uint32_t end;
+  // Object label, 1..num_labels, once LabelRuns( ) has run.
+  uint32_t label;
+};
+
+// Runs of a binary image, in raster order.
+struct RunLabeling {
+  size_t num_rows = 0;
+  size_t num_columns = 0;
+  std::vector<Run> runs;
+  // Runs of row i are runs[row_begin[i]] .. runs[row_begin[i + 1] - 1].
+  std::vector<size_t> row_begin;
+  size_t num_labels = 0;
+};
+
+/**
+ * ExtractRuns( ) collects the runs of non-zero pixels of an image.
+ *
+ * @param {Image} an_image: input binary image
+ * @param {RunLabeling} labeling: receives the runs, unlabeled
+ */
+void ExtractRuns(const Image &an_image, RunLabeling *labeling);
+
+// Same as above for a bit-packed mask; skips whole background words.
+void ExtractRuns(const BinaryMask &mask, RunLabeling *labeling);
+
+/**
+ * LabelRuns( ) merges runs of adjacent rows that share a column
+ * (4-connectivity) and numbers the resulting objects 1..num_labels in the
+ * raster order of their first pixel, the same numbering RasterScan( )
+ * produces. There is no limit on the number of runs or labels.
+ *
+ * @param {RunLabeling} labeling: runs from ExtractRuns( )
+ */
+void LabelRuns(RunLabeling *labeling);
+
+// Same as above with the equivalence and relabel tables of workspace.
+void LabelRuns(RunLabeling *labeling, RasterScanWorkspace *workspace);
+
+/**
+ * PaintRuns( ) renders labeled runs into a dense label image with the
+ * narrowest depth holding num_labels; background pixels are 0.
+ *
+ * @param {RunLabeling} labeling: labeled runs
+ * @param {Image} an_image: the resulting label image
+ */
+void PaintRuns(const RunLabeling &labeling, Image *an_image);
+
+/**
+ * RunLengthLabeling( ) labels a binary image in place through runs:
+ * a drop-in replacement for RasterScan( ).
+ *
+ * @param {Image} an_image: input image
+ */
+void RunLengthLabeling(Image *an_image);
+
+// Same as above, reusing the runs of labeling and the tables of
+// workspace from the previous frame instead of allocating them.
+void RunLengthLabeling(Image *an_image, RunLabeling *labeling,
+                       RasterScanWorkspace *workspace);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_RUN_LABELING_H_
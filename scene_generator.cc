@@ -0,0 +1,128 @@
+// Synthetic gray-level scenes of known objects, for benchmarks and for
+// checking the stages on inputs of any size and density.
+// To be used in Computer Vision class.
+
+#include "scene_generator.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+// Paints one object centered at (row, column), with half axes
+// long_axis and short_axis, the long one at angle theta from the rows,
+// leaving margin pixels around the border untouched.
+// Returns the number of pixels that turned from background to object.
+size_t PaintObject(double row, double column, double long_axis,
+                   double short_axis, double theta, bool ellipse,
+                   uint8_t foreground, long margin,
+                   ImagePlane<uint8_t> plane) {
+  const double cosine = cos(theta), sine = sin(theta);
+  const double extent = long_axis + 1;
+  const long first_row = max(margin, lround(row - extent));
+  const long last_row =
+      min<long>(plane.num_rows() - 1 - margin, lround(row + extent));
+  const long first_column = max(margin, lround(column - extent));
+  const long last_column =
+      min<long>(plane.num_columns() - 1 - margin, lround(column + extent));
+  size_t painted = 0;
+  for (long i = first_row; i <= last_row; ++i) {
+    uint8_t *pixels = plane.Row(i);
+    for (long j = first_column; j <= last_column; ++j) {
+      // coordinates along the axes of the object
+      const double u = ((i - row) * cosine + (j - column) * sine) / long_axis;
+      const double v = (-(i - row) * sine + (j - column) * cosine) / short_axis;
+      const bool inside = ellipse ? u * u + v * v <= 1
+                                  : fabs(u) <= 1 && fabs(v) <= 1;
+      if (inside && pixels[j] != foreground) {
+        pixels[j] = foreground;
+        ++painted;
+      }
+    }
+  }
+  return painted;
+}
+
+}  // namespace
+
+bool ParseSceneShape(const string &name, SceneShape *shape) {
+  if (shape == nullptr) abort();
+  if (name == "ellipse")
+    *shape = SceneShape::kEllipse;
+  else if (name == "rectangle")
+    *shape = SceneShape::kRectangle;
+  else if (name == "mixed")
+    *shape = SceneShape::kMixed;
+  else
+    return false;
+  return true;
+}
+
+size_t GenerateScene(const SceneOptions &options, Image *an_image) {
+  if (an_image == nullptr) abort();
+  an_image->AllocateSpaceAndSetSize(options.num_rows, options.num_columns,
+                                    PixelDepth::kUint8);
+  an_image->SetNumberGrayLevels(255);
+  ImagePlane<uint8_t> plane = an_image->Plane<uint8_t>();
+  const uint8_t background = max(0, min(255, options.background));
+  const uint8_t foreground = max(0, min(255, options.foreground));
+  for (size_t i = 0; i < plane.num_rows(); ++i)
+    fill(plane.Row(i), plane.Row(i) + plane.num_columns(), background);
+
+  mt19937 random(options.seed);
+  uniform_real_distribution<double> unit(0, 1);
+  const double margin = options.margin;
+  const size_t num_pixels =
+      options.num_rows > 2 * options.margin &&
+              options.num_columns > 2 * options.margin
+          ? (options.num_rows - 2 * options.margin) *
+                (options.num_columns - 2 * options.margin)
+          : 0;
+  const double min_size = max(1.0, options.min_size);
+  const double max_size = max(min_size, options.max_size);
+  size_t num_placed = 0, painted = 0;
+  // a density the sizes cannot reach still ends
+  const size_t max_objects = options.density > 0 ? num_pixels
+                                                 : options.num_objects;
+  while (num_placed < max_objects && num_pixels > 0 &&
+         (options.density <= 0 ||
+          painted < options.density * num_pixels)) {
+    const double long_axis = min_size + unit(random) * (max_size - min_size);
+    // centers are drawn so that the object fits within the margin when
+    // the image is large enough
+    const double row_room =
+        max(0.0, options.num_rows - 2 * (margin + long_axis));
+    const double column_room =
+        max(0.0, options.num_columns - 2 * (margin + long_axis));
+    const double row =
+        (options.num_rows - row_room) / 2 + unit(random) * row_room;
+    const double column =
+        (options.num_columns - column_room) / 2 + unit(random) * column_room;
+    const double short_axis = max(1.0, long_axis * (0.3 + 0.7 * unit(random)));
+    const double theta = unit(random) * M_PI;
+    const bool ellipse =
+        options.shape == SceneShape::kEllipse ||
+        (options.shape == SceneShape::kMixed && unit(random) < 0.5);
+    painted += PaintObject(row, column, long_axis, short_axis, theta, ellipse,
+                           foreground, options.margin, plane);
+    ++num_placed;
+  }
+
+  if (options.noise > 0 && num_pixels > 0) {
+    normal_distribution<double> noise(0, options.noise);
+    for (size_t i = options.margin; i < plane.num_rows() - options.margin;
+         ++i) {
+      uint8_t *pixels = plane.Row(i);
+      for (size_t j = options.margin; j < plane.num_columns() - options.margin;
+           ++j)
+        pixels[j] = max(0L, min(255L, lround(pixels[j] + noise(random))));
+    }
+  }
+  return num_placed;
+}
+
+}  // namespace ComputerVisionProjects
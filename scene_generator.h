@@ -0,0 +1,60 @@
+// Synthetic gray-level scenes of known objects, for benchmarks and for
+// checking the stages on inputs of any size and density.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_SCENE_GENERATOR_H_
+#define COMPUTER_VISION_SCENE_GENERATOR_H_
+
+#include "image.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ComputerVisionProjects {
+
+enum class SceneShape { kEllipse, kRectangle, kMixed };
+
+// Parses ellipse, rectangle and mixed into shape.
+// Returns false for anything else.
+bool ParseSceneShape(const std::string &name, SceneShape *shape);
+
+struct SceneOptions {
+  size_t num_rows = 480;
+  size_t num_columns = 640;
+  // Objects to place, unless density is set.
+  size_t num_objects = 20;
+  SceneShape shape = SceneShape::kEllipse;
+  // Range of the half length of the long axis of an object, in pixels;
+  // the short axis is 0.3 to 1 times as long.
+  double min_size = 8;
+  double max_size = 40;
+  // When above 0 (and below 1), objects are placed until this fraction
+  // of the pixels within the margin belongs to objects, and num_objects
+  // is ignored.
+  double density = 0;
+  // Standard deviation of the gaussian noise added to every pixel within
+  // the margin.
+  double noise = 0;
+  // Width of a frame of plain background around the image; objects and
+  // noise stay inside it.
+  size_t margin = 0;
+  int background = 40;
+  int foreground = 200;
+  uint32_t seed = 1;
+};
+
+/**
+ * GenerateScene( ) draws objects of random position, size and
+ * orientation on a uniform background and adds noise. The same options
+ * always give the same scene. Objects may overlap, so the number of
+ * connected objects can be smaller than the number placed.
+ *
+ * @param {SceneOptions} options: size, objects and noise of the scene
+ * @param {Image} an_image: the resulting 8-bit gray-level image
+ * @return the number of objects placed
+ */
+size_t GenerateScene(const SceneOptions &options, Image *an_image);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_SCENE_GENERATOR_H_
@@ -0,0 +1,87 @@
+// Bounded lock-free queue between one producer and one consumer thread.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_SPSC_QUEUE_H_
+#define COMPUTER_VISION_SPSC_QUEUE_H_
+
+#include "parallel.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Ring buffer of a power-of-two number of slots. Exactly one thread may
+// push and exactly one other thread may pop; neither ever takes a lock.
+// head_ is only written by the consumer and tail_ by the producer, each
+// on its own cache line, and each side keeps a cached copy of the other
+// side's index so that it only touches the shared line when the cached
+// one says the queue is full (or empty). Queues made with new get the
+// same alignment from CacheLineAligned.
+// Sample usage:
+//   SpscQueue<Frame *> queue(8);
+//   producer: while (!queue.TryPush(frame)) wait;
+//   consumer: Frame *frame; while (!queue.TryPop(&frame)) wait;
+template <typename T>
+class SpscQueue : public CacheLineAligned {
+ public:
+  // capacity is rounded up to a power of two.
+  explicit SpscQueue(size_t capacity)
+      : mask_{RoundUpToPowerOfTwo(capacity) - 1}, slots_(mask_ + 1) { }
+
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue &operator=(const SpscQueue &) = delete;
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Number of values queued; exact from either side, a snapshot from
+  // any other thread.
+  size_t size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+
+  // Producer side. Returns false, leaving the queue unchanged, when full.
+  bool TryPush(const T &value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ > mask_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ > mask_) return false;
+    }
+    slots_[tail & mask_] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false, leaving value unchanged, when empty.
+  bool TryPop(T *value) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) return false;
+    }
+    *value = slots_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t power = 1;
+    while (power < value) power <<= 1;
+    return power;
+  }
+
+  const size_t mask_;
+  std::vector<T> slots_;
+  // consumer side
+  alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+  size_t cached_tail_ = 0;
+  // producer side
+  alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+  size_t cached_head_ = 0;
+};
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_SPSC_QUEUE_H_
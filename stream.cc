@@ -0,0 +1,75 @@
+/******************************************************************************
+ * Title          : stream.cc
+ * Description    : recognizes the objects of a stream of frames (the
+ *                  .pgm files of a directory in name order, or a file
+ *                  list) with reading, thresholding, labeling, measuring,
+ *                  matching and writing each on a thread of its own, and
+ *                  prints how busy each stage was and how full its input
+ *                  queue ran. The overlays written are the ones the
+ *                  pipeline program writes for each frame
+ * Purpose        : 
+ * Usage          : ./stream frames/ 125 two_objects_database.txt
+ *                            [overlay directory] [queue depth]
+ * Build with     : make all
+ */
+#include "batch_recognition.h"
+#include "histogram.h"
+#include "model_database.h"
+#include "recognition_pipeline.h"
+#include "stream_pipeline.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace ComputerVisionProjects;
+
+int main(int argc, char **argv){  
+  if (argc < 4 || argc > 6) {
+    printf("Usage: %s {input directory | input file list} {input gray–level threshold | auto | otsu | triangle} {input database} [output directory] [queue depth]\n", argv[0]);
+    return 0;
+  }
+  const string input_path(argv[1]);
+  const string value(argv[2]);
+  const string input_database(argv[3]);
+
+  PipelineOptions options;
+  options.automatic_threshold =
+      ParseThresholdMethod(value, &options.threshold_method);
+  if (!options.automatic_threshold)
+    options.threshold_value = stoi(value);  // convert string to int
+  StreamOptions stream_options;
+  if (argc > 4) stream_options.output_directory = argv[4];
+  if (argc > 5) stream_options.queue_depth = stoi(argv[5]);
+
+  vector<string> inputs;
+  if (!ListBatchInputs(input_path, &inputs)) return 0;
+
+  ModelDatabase database;
+  if (!LoadModelDatabase(input_database, &database)) {
+    cout << "Can't read database " << input_database << endl;
+    return 0;
+  }
+
+  RecognitionPipeline pipeline(options);
+  pipeline.SetModels(database);
+  StreamStats stats;
+  RunStream(pipeline, inputs, stream_options, &stats);
+
+  cout << stats.images << " frames (" << stats.failed << " failed), "
+       << stats.objects << " objects, " << stats.matched << " matched in "
+       << stats.seconds << " s";
+  if (stats.seconds > 0) cout << ", " << stats.images / stats.seconds << " frames/s";
+  cout << endl;
+  printf("%-10s %8s %10s %10s %10s %10s %6s\n", "stage", "frames", "busy s",
+         "starved s", "blocked s", "queue avg", "max");
+  for (size_t stage = 0; stage < kNumStreamStages; ++stage) {
+    const StageStats &stage_stats = stats.stages[stage];
+    printf("%-10s %8zu %10.3f %10.3f %10.3f %10.2f %6zu\n",
+           StreamStageName(stage), stage_stats.frames,
+           stage_stats.busy_seconds, stage_stats.starved_seconds,
+           stage_stats.blocked_seconds, stage_stats.MeanOccupancy(),
+           stage_stats.max_occupancy);
+  }
+}
@@ -0,0 +1,86 @@
+/******************************************************************************
+ * Title          : stream_label.cc
+ * Description    : thresholds, labels and measures a gray-level image
+ *                  read one row at a time, for images too large to load:
+ *                  only the previous row and the objects still open are
+ *                  kept. Writes the same attribute database as p3, with
+ *                  objects numbered in the order they end (the row
+ *                  below their last pixel) instead of the raster order
+ *                  of their first pixel
+ * Purpose        : 
+ * Usage          : ./stream_label line_scan.pgm 125 line_scan_database.txt
+ * Build with     : make all
+ */
+#include "image.h"
+#include "metrics.h"
+#include "object_matcher.h"
+#include "object_moments.h"
+#include "streaming_labeling.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace ComputerVisionProjects;
+
+namespace {
+
+// Objects measured and written together, to use the batch kernels.
+const size_t kObjectsPerBatch = 4096;
+
+// Writes objects 1.. of objects, numbered from first_label, and empties
+// objects back to the unused entry 0.
+void WriteObjects(vector<ObjectFeatures> *objects, size_t first_label,
+                  InertiaBatch *batch, ostream &output_file) {
+  LoadInertiaBatch(*objects, batch);
+  ComputeInertia(batch, true);
+  for (size_t i = 1; i < batch->size(); ++i)
+    output_file << first_label + i - 1 << " " << batch->row_center[i] << " "
+                << batch->column_center[i] << " " << batch->min_inertia[i]
+                << " " << batch->orientation[i] << " " << Roundness(*batch, i)
+                << " " << (*objects)[i].moments.area << " "
+                << BoundingBoxAspect((*objects)[i]) << endl;
+  objects->resize(1);
+}
+
+}  // namespace
+
+int main(int argc, char **argv){  
+  if (argc!=4) {
+    printf("Usage: %s {input gray–level image} {input gray–level threshold} {output database}\n", argv[0]);
+    return 0;
+  }
+  const string input_file(argv[1]);
+  const int threshold = stoi(argv[2]);  // convert string to int
+  const string output_file(argv[3]);
+
+  // stage times and counters of this run, with make all METRICS=1
+  ScopedFrameMetrics frame_metrics(input_file);
+
+  ofstream database_file(output_file);
+  if (database_file.fail()) {
+    cout << "Can't write " << output_file << endl;
+    return 0;
+  }
+  database_file << kObjectDatabaseHeader << endl;
+
+  vector<ObjectFeatures> objects(1);
+  InertiaBatch batch;
+  size_t num_written = 0;
+  StreamingLabeler labeler([&](const StreamedObject &object) {
+    objects.push_back(object.features);
+    if (objects.size() > kObjectsPerBatch) {
+      WriteObjects(&objects, num_written + 1, &batch, database_file);
+      num_written += kObjectsPerBatch;
+    }
+  });
+  if (!StreamLabelPgm(input_file, threshold, &labeler)) return 0;
+  WriteObjects(&objects, num_written + 1, &batch, database_file);
+
+  cout << labeler.num_rows() << " rows, " << labeler.num_runs() << " runs, "
+       << labeler.num_emitted() << " objects, at most "
+       << labeler.peak_open_objects() << " open at once" << endl;
+}
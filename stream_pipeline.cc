@@ -0,0 +1,227 @@
+// Recognition of a stream of frames with every stage on its own thread,
+// stages connected by bounded lock-free queues.
+// To be used in Computer Vision class.
+
+#include "stream_pipeline.h"
+#include "metrics.h"
+#include "spsc_queue.h"
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+// A frame and everything the stages compute for it. Frames are
+// allocated once per stream and recycled from the writer to the reader.
+struct StreamFrame {
+  const string *input = nullptr;
+  Image image;
+  GrayHistogram histogram;
+  PipelineResult result;
+  // false once a stage failed; later stages pass the frame on untouched
+  bool ok = false;
+#ifdef CV_METRICS
+  // filled by each stage on its own thread, written by the writer
+  FrameMetrics metrics;
+#endif
+};
+
+typedef SpscQueue<StreamFrame *> FrameQueue;
+
+double SecondsSince(Clock::time_point start) {
+  return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Waits a little longer the longer a queue stays full or empty: first
+// by giving the core away, then by sleeping, so that an idle stage does
+// not burn a core while the slow one works.
+void Backoff(size_t attempt) {
+  if (attempt < 64)
+    this_thread::yield();
+  else
+    this_thread::sleep_for(chrono::microseconds(50));
+}
+
+void WaitPop(FrameQueue *queue, StreamFrame **frame) {
+  for (size_t attempt = 0; !queue->TryPop(frame); ++attempt)
+    Backoff(attempt);
+}
+
+void WaitPush(FrameQueue *queue, StreamFrame *frame) {
+  for (size_t attempt = 0; !queue->TryPush(frame); ++attempt)
+    Backoff(attempt);
+}
+
+// Moves frames from input to output through process( ) until the null
+// frame that ends the stream, which is passed on too.
+template <typename Process>
+void RunStage(FrameQueue *input, FrameQueue *output, Process process,
+              StageStats *stats) {
+  for (;;) {
+    StreamFrame *frame;
+    Clock::time_point start = Clock::now();
+    WaitPop(input, &frame);
+    stats->starved_seconds += SecondsSince(start);
+    if (frame == nullptr) break;
+
+    const size_t occupancy = input->size() + 1;
+    stats->occupancy_sum += occupancy;
+    if (occupancy > stats->max_occupancy) stats->max_occupancy = occupancy;
+    start = Clock::now();
+    if (frame->ok) {
+      CV_METRIC(FrameMetricsScope scope(&frame->metrics));
+      process(frame);
+    }
+    stats->busy_seconds += SecondsSince(start);
+    ++stats->frames;
+
+    start = Clock::now();
+    WaitPush(output, frame);
+    stats->blocked_seconds += SecondsSince(start);
+  }
+  WaitPush(output, nullptr);
+}
+
+}  // namespace
+
+const char *StreamStageName(size_t stage) {
+  static const char *const kNames[kNumStreamStages] = {
+      "read", "threshold", "label", "measure", "match", "write"};
+  return stage < kNumStreamStages ? kNames[stage] : "";
+}
+
+void RunStream(const RecognitionPipeline &pipeline,
+               const vector<string> &inputs, const StreamOptions &options,
+               StreamStats *stats) {
+  if (stats == nullptr) abort();
+  *stats = StreamStats();
+  const Clock::time_point start = Clock::now();
+  const size_t depth = options.queue_depth == 0 ? 1 : options.queue_depth;
+
+  // queues[s] feeds stage s; queues[kStreamRead] holds the free frames
+  // and is fed by the writer, closing the loop. The frames in flight are
+  // at most depth per queue between stages plus one per stage.
+  const size_t num_frames = kNumStreamStages + depth * (kNumStreamStages - 1);
+  vector<unique_ptr<StreamFrame>> frames(num_frames);
+  vector<unique_ptr<FrameQueue>> queues(kNumStreamStages);
+  // the free list also takes the null frame that ends the stream
+  queues[kStreamRead].reset(new FrameQueue(num_frames + 1));
+  for (size_t stage = 1; stage < kNumStreamStages; ++stage)
+    queues[stage].reset(new FrameQueue(depth));
+  for (unique_ptr<StreamFrame> &frame : frames) {
+    frame.reset(new StreamFrame);
+    queues[kStreamRead]->TryPush(frame.get());
+  }
+  FrameQueue *free_frames = queues[kStreamRead].get();
+  StageStats *stage_stats = stats->stages;
+
+  const bool automatic = pipeline.options().automatic_threshold;
+  vector<thread> threads;
+  threads.emplace_back([&] {
+    StageStats *read_stats = &stage_stats[kStreamRead];
+    for (const string &input : inputs) {
+      StreamFrame *frame;
+      Clock::time_point start = Clock::now();
+      WaitPop(free_frames, &frame);
+      read_stats->starved_seconds += SecondsSince(start);
+      const size_t occupancy = free_frames->size() + 1;
+      read_stats->occupancy_sum += occupancy;
+      if (occupancy > read_stats->max_occupancy)
+        read_stats->max_occupancy = occupancy;
+
+      start = Clock::now();
+      frame->input = &input;
+      CV_METRIC(frame->metrics = FrameMetrics());
+      CV_METRIC(frame->metrics.image = input);
+      {
+        CV_METRIC(FrameMetricsScope scope(&frame->metrics));
+        frame->ok = ReadImage(input, &frame->image,
+                              automatic ? &frame->histogram : nullptr);
+      }
+      if (!frame->ok) cout << "RunStream: can't open " << input << endl;
+      read_stats->busy_seconds += SecondsSince(start);
+      ++read_stats->frames;
+
+      start = Clock::now();
+      WaitPush(queues[kStreamThreshold].get(), frame);
+      read_stats->blocked_seconds += SecondsSince(start);
+    }
+    WaitPush(queues[kStreamThreshold].get(), nullptr);
+  });
+  threads.emplace_back([&] {
+    RunStage(queues[kStreamThreshold].get(), queues[kStreamLabel].get(),
+             [&](StreamFrame *frame) {
+               pipeline.Threshold(&frame->image,
+                                  automatic ? &frame->histogram : nullptr,
+                                  &frame->result);
+             },
+             &stage_stats[kStreamThreshold]);
+  });
+  threads.emplace_back([&] {
+    // one labeling workspace serves every frame, as there is one thread
+    RasterScanWorkspace workspace;
+    RunStage(queues[kStreamLabel].get(), queues[kStreamMeasure].get(),
+             [&](StreamFrame *frame) {
+               pipeline.Label(&frame->image, &frame->result, &workspace);
+             },
+             &stage_stats[kStreamLabel]);
+  });
+  threads.emplace_back([&] {
+    RunStage(queues[kStreamMeasure].get(), queues[kStreamMatch].get(),
+             [&](StreamFrame *frame) { pipeline.Measure(&frame->result); },
+             &stage_stats[kStreamMeasure]);
+  });
+  threads.emplace_back([&] {
+    RunStage(queues[kStreamMatch].get(), queues[kStreamWrite].get(),
+             [&](StreamFrame *frame) {
+               pipeline.Match(&frame->image, &frame->result);
+             },
+             &stage_stats[kStreamMatch]);
+  });
+  // The writer also does the counting, as the last owner of the frames;
+  // counts.images are the frames that made it through.
+  StreamStats counts;
+  threads.emplace_back([&] {
+    string output_name;
+    RunStage(queues[kStreamWrite].get(), free_frames,
+             [&](StreamFrame *frame) {
+               if (!options.output_directory.empty()) {
+                 output_name = options.output_directory;
+                 output_name += '/';
+                 output_name.append(*frame->input,
+                                    frame->input->find_last_of('/') + 1,
+                                    string::npos);
+                 if (!WriteImage(output_name, frame->image)) {
+                   cout << "RunStream: can't write " << output_name << endl;
+                   frame->ok = false;
+                   return;
+                 }
+               }
+               ++counts.images;
+               const PipelineResult &result = frame->result;
+               for (size_t i = 1; i < result.matches.size(); ++i) {
+                 ++counts.objects;
+                 if (!result.matches[i].empty()) ++counts.matched;
+               }
+               CV_METRIC(EmitFrameMetrics(&frame->metrics));
+             },
+             &stage_stats[kStreamWrite]);
+  });
+  for (thread &stage : threads) stage.join();
+
+  // Frames that failed anywhere reach the writer with ok unset.
+  stats->images = inputs.size();
+  stats->failed = inputs.size() - counts.images;
+  stats->objects = counts.objects;
+  stats->matched = counts.matched;
+  stats->seconds = SecondsSince(start);
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,83 @@
+// Recognition of a stream of frames with every stage on its own thread,
+// stages connected by bounded lock-free queues.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_STREAM_PIPELINE_H_
+#define COMPUTER_VISION_STREAM_PIPELINE_H_
+
+#include "recognition_pipeline.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Stages of RunStream( ), in frame order.
+enum StreamStage {
+  kStreamRead, kStreamThreshold, kStreamLabel, kStreamMeasure, kStreamMatch,
+  kStreamWrite, kNumStreamStages
+};
+
+const char *StreamStageName(size_t stage);
+
+// What one stage thread did during a stream.
+struct StageStats {
+  size_t frames = 0;
+  // Working on frames.
+  double busy_seconds = 0;
+  // Waiting for a frame from the previous stage (the reader: for a free
+  // frame to read into).
+  double starved_seconds = 0;
+  // Waiting for room in the queue to the next stage.
+  double blocked_seconds = 0;
+  // Frames in the input queue, sampled at every frame.
+  size_t occupancy_sum = 0;
+  size_t max_occupancy = 0;
+
+  double MeanOccupancy() const {
+    return frames == 0 ? 0 : static_cast<double>(occupancy_sum) / frames;
+  }
+};
+
+struct StreamOptions {
+  // Slots of each queue between two stages. The frames in flight are
+  // the ones in the queues plus one per stage, and a full queue stops
+  // the stage feeding it.
+  size_t queue_depth = 2;
+  // When not empty, the overlay of each frame is written there under
+  // the name of the input.
+  std::string output_directory;
+};
+
+struct StreamStats {
+  size_t images = 0;
+  // Frames that could not be read or written.
+  size_t failed = 0;
+  size_t objects = 0;
+  // Objects that matched at least one model.
+  size_t matched = 0;
+  double seconds = 0;
+  StageStats stages[kNumStreamStages];
+};
+
+/**
+ * RunStream( ) recognizes the frames of inputs in order with the read,
+ * threshold, label, measure, match and write stages each on a thread of
+ * its own. Frames come from a fixed pool and move from stage to stage
+ * through SpscQueues of pointers, so a stage owns a frame exclusively
+ * while it works on it and nothing is copied or allocated per frame.
+ * The frame rate is that of the slowest stage; the stats tell which one
+ * that is (the busiest, with the fullest input queue).
+ *
+ * @param {RecognitionPipeline} pipeline: pipeline with its models set
+ * @param {vector} inputs: frame filenames, in stream order
+ * @param {StreamOptions} options: queue depth and overlay output
+ * @param {StreamStats} stats: counts, time and per-stage stats
+ */
+void RunStream(const RecognitionPipeline &pipeline,
+               const std::vector<std::string> &inputs,
+               const StreamOptions &options, StreamStats *stats);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_STREAM_PIPELINE_H_
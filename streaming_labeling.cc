@@ -0,0 +1,213 @@
+// Connected component labeling of images streamed a row at a time, in
+// memory proportional to the width and the number of open objects.
+// To be used in Computer Vision class.
+
+#include "streaming_labeling.h"
+#include "metrics.h"
+#include "pgm_io.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+namespace {
+
+// ∑ j for j in [0, n).
+int64_t SumTo(int64_t n) { return n * (n - 1) / 2; }
+
+// ∑ j² for j in [0, n).
+int64_t SumOfSquaresTo(int64_t n) { return (n - 1) * n * (2 * n - 1) / 6; }
+
+// Adds the pixels (i, begin) .. (i, end - 1) to object.
+void AddRun(int64_t i, int64_t begin, int64_t end, ObjectFeatures *object) {
+  const int64_t length = end - begin;
+  const int64_t sum_j = SumTo(end) - SumTo(begin);
+  ObjectMoments &moments = object->moments;
+  moments.area += length;
+  moments.sum_row += i * length;
+  moments.sum_column += sum_j;
+  moments.sum_row_squared += i * i * length;
+  moments.sum_column_squared += SumOfSquaresTo(end) - SumOfSquaresTo(begin);
+  moments.sum_row_column += i * sum_j;
+  object->ExtendBoundingBox(i, begin);
+  object->ExtendBoundingBox(i, end - 1);
+}
+
+}  // namespace
+
+uint32_t StreamingLabeler::NewSlot(uint32_t i, uint32_t j) {
+  uint32_t slot;
+  if (free_slots_.empty()) {
+    slot = slots_.size();
+    slots_.emplace_back();
+    touched_row_.push_back(0);
+  } else {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+    slots_[slot] = Slot();
+  }
+  CV_METRIC(++counters_.labels);
+  slots_[slot].parent = slot;
+  slots_[slot].object.first_row = i;
+  slots_[slot].object.first_column = j;
+  return slot;
+}
+
+uint32_t StreamingLabeler::Find(uint32_t slot) {
+  CV_METRIC(uint64_t depth = 0);
+  while (slots_[slot].parent != slot) {
+    slots_[slot].parent = slots_[slots_[slot].parent].parent;
+    slot = slots_[slot].parent;
+    CV_METRIC(++depth);
+  }
+  CV_METRIC(++counters_.finds);
+  CV_METRIC(counters_.find_steps += depth);
+  CV_METRIC(counters_.max_find_depth = max(counters_.max_find_depth, depth));
+  return slot;
+}
+
+// Features live at the roots only, so joining moves them to the root
+// that remains.
+uint32_t StreamingLabeler::Union(uint32_t first, uint32_t second) {
+  first = Find(first);
+  second = Find(second);
+  if (first == second) return first;
+  CV_METRIC(++counters_.unions);
+  StreamedObject &kept = slots_[first].object;
+  const StreamedObject &joined = slots_[second].object;
+  kept.features.Add(joined.features);
+  if (joined.first_row < kept.first_row ||
+      (joined.first_row == kept.first_row &&
+       joined.first_column < kept.first_column)) {
+    kept.first_row = joined.first_row;
+    kept.first_column = joined.first_column;
+  }
+  slots_[second].parent = first;
+  return first;
+}
+
+void StreamingLabeler::Retire(uint32_t slot) {
+  free_slots_.push_back(slot);
+}
+
+void StreamingLabeler::AddRow(const uint8_t *foreground, size_t num_columns) {
+  const uint32_t i = row_;
+  runs_.clear();
+  touched_.clear();
+  // Pieces open after the previous row may close or merge in this one.
+  for (const Run &run : previous_runs_) {
+    if (touched_row_[run.label] == i + 1) continue;
+    touched_row_[run.label] = i + 1;
+    touched_.push_back(run.label);
+  }
+
+  size_t p = 0;
+  for (size_t j = 0; j < num_columns;) {
+    if (foreground[j] == 0) {
+      ++j;
+      continue;
+    }
+    Run run;
+    run.row = i;
+    run.begin = j;
+    while (j < num_columns && foreground[j] != 0) ++j;
+    run.end = j;
+
+    // Runs of the previous row sharing a column with this one, which
+    // are consecutive as both rows are in column order.
+    uint32_t label = 0;
+    while (p < previous_runs_.size() && previous_runs_[p].end <= run.begin)
+      ++p;
+    for (size_t q = p;
+         q < previous_runs_.size() && previous_runs_[q].begin < run.end; ++q)
+      label = label == 0 ? Find(previous_runs_[q].label)
+                         : Union(label, previous_runs_[q].label);
+    if (label == 0) {
+      label = NewSlot(i, run.begin);
+      touched_row_[label] = i + 1;
+      touched_.push_back(label);
+    }
+    AddRun(i, run.begin, run.end, &slots_[label].object.features);
+    run.label = label;
+    runs_.push_back(run);
+  }
+  num_runs_ += runs_.size();
+
+  // Point the runs at their final objects; what no run points to any
+  // more is either a merged piece or a closed object.
+  for (Run &run : runs_) {
+    run.label = Find(run.label);
+    slots_[run.label].seen_row = i;
+  }
+  for (uint32_t slot : touched_) {
+    if (slots_[slot].parent != slot) {
+      Retire(slot);
+    } else if (slots_[slot].seen_row != i) {
+      emit_(slots_[slot].object);
+      ++num_emitted_;
+      Retire(slot);
+    }
+  }
+  peak_open_objects_ =
+      max(peak_open_objects_, slots_.size() - 1 - free_slots_.size());
+  swap(previous_runs_, runs_);
+  ++row_;
+  ++num_rows_;
+}
+
+void StreamingLabeler::Finish() {
+  // Every open object has a run in the last row, often several, so
+  // mark each one when it is emitted.
+  for (const Run &run : previous_runs_) {
+    const uint32_t slot = run.label;
+    if (slots_[slot].seen_row != row_) {
+      slots_[slot].seen_row = row_;
+      emit_(slots_[slot].object);
+      ++num_emitted_;
+      Retire(slot);
+    }
+  }
+  previous_runs_.clear();
+  row_ = 0;
+  CV_METRIC(AddEquivalenceCounters(counters_));
+  CV_METRIC(counters_ = UnionFindCounters());
+}
+
+bool StreamLabelPgm(const string &filename, int threshold_value,
+                    StreamingLabeler *labeler) {
+  if (labeler == nullptr) abort();
+  // reading, labeling and the callback interleave row by row
+  CV_METRIC_STAGE(kMetricLabel);
+  PgmRowReader reader;
+  if (!reader.Open(filename)) {
+    cout << "StreamLabelPgm: can't open " << filename << endl;
+    return false;
+  }
+  const PgmHeader &header = reader.header();
+  const size_t num_columns = header.num_columns;
+  vector<uint16_t> samples(num_columns);
+  vector<uint8_t> foreground(num_columns);
+  // pbm pixels are already binary, as DecodePgmRaster( ) reads them
+  const int threshold = header.format == '4' ? 0 : threshold_value;
+  CV_METRIC(const size_t first_runs = labeler->num_runs());
+  CV_METRIC(const size_t first_emitted = labeler->num_emitted());
+  while (reader.ReadRow(samples.data())) {
+    for (size_t j = 0; j < num_columns; ++j)
+      foreground[j] = samples[j] > threshold;
+    labeler->AddRow(foreground.data(), num_columns);
+  }
+  labeler->Finish();
+  CV_METRIC_ADD(pixels, reader.num_rows_read() * num_columns);
+  CV_METRIC_ADD(runs, labeler->num_runs() - first_runs);
+  CV_METRIC_ADD(objects, labeler->num_emitted() - first_emitted);
+  if (reader.num_rows_read() != header.num_rows) {
+    cout << "StreamLabelPgm: " << filename
+         << " is short or has a sample above its maximum gray value" << endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,120 @@
+// Connected component labeling of images streamed a row at a time, in
+// memory proportional to the width and the number of open objects.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_STREAMING_LABELING_H_
+#define COMPUTER_VISION_STREAMING_LABELING_H_
+
+#include "metrics.h"
+#include "object_moments.h"
+#include "run_labeling.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// An object as StreamingLabeler emits it. Objects are emitted in the
+// order they complete; first_row and first_column locate the first
+// pixel of the object in raster order, which is the order RasterScan( )
+// numbers objects in.
+struct StreamedObject {
+  // Moments and bounding box (kSecondMoments | kBoundingBox).
+  ObjectFeatures features;
+  uint32_t first_row = 0;
+  uint32_t first_column = 0;
+};
+
+// Labels a binary image fed to it row by row, with 4-connectivity as
+// RasterScan( ). Only the runs of the previous row and the features of
+// the objects still touching it are kept: when a row has no run joined
+// to an object, the object cannot grow any more and is handed to the
+// callback at once. Memory is O(width + open objects), whatever the
+// height of the image.
+//
+// Example:
+//   StreamingLabeler labeler([](const StreamedObject &object) { ... });
+//   for (each row) labeler.AddRow(row, num_columns);
+//   labeler.Finish();
+class StreamingLabeler {
+ public:
+  typedef std::function<void(const StreamedObject &)> Callback;
+
+  // Slot 0 stands for no object and is never handed out.
+  explicit StreamingLabeler(const Callback &emit)
+      : emit_(emit), slots_(1), touched_row_(1, 0) { }
+
+  /**
+   * AddRow( ) labels the next row and emits the objects it closes.
+   *
+   * @param {uint8_t} foreground: the row, non-zero for object pixels
+   * @param {size_t} num_columns: width of the row
+   */
+  void AddRow(const uint8_t *foreground, size_t num_columns);
+
+  // Emits the objects still open after the last row. The next row
+  // added is row 0 of a new image.
+  void Finish();
+
+  // Totals over every image fed so far.
+  size_t num_rows() const { return num_rows_; }
+  size_t num_runs() const { return num_runs_; }
+  size_t num_emitted() const { return num_emitted_; }
+  // Largest number of objects held at the end of a row.
+  size_t peak_open_objects() const { return peak_open_objects_; }
+
+ private:
+  // Open object, or piece of one until the end of the row that joined
+  // it to another.
+  struct Slot {
+    uint32_t parent;
+    // last row with a run of the object
+    uint32_t seen_row;
+    StreamedObject object;
+  };
+
+  uint32_t NewSlot(uint32_t i, uint32_t j);
+  uint32_t Find(uint32_t slot);
+  uint32_t Union(uint32_t first, uint32_t second);
+  void Retire(uint32_t slot);
+
+  Callback emit_;
+  std::vector<Slot> slots_;
+  std::vector<uint32_t> free_slots_;
+  // Runs of the previous and the current row; labels are slots.
+  std::vector<Run> previous_runs_;
+  std::vector<Run> runs_;
+  // Slots that may have closed or been merged by the current row.
+  std::vector<uint32_t> touched_;
+  // Per slot: row + 1 when already in touched_.
+  std::vector<uint32_t> touched_row_;
+  // row of the current image AddRow( ) labels next
+  uint32_t row_ = 0;
+  size_t num_rows_ = 0;
+  size_t num_runs_ = 0;
+  size_t num_emitted_ = 0;
+  size_t peak_open_objects_ = 0;
+#ifdef CV_METRICS
+  // work of the slot union-find since the last Finish( )
+  UnionFindCounters counters_;
+#endif
+};
+
+/**
+ * StreamLabelPgm( ) thresholds and labels a pgm file read a row at a
+ * time, as ConvertToBinary( ) and RasterScan( ) would do on the whole
+ * image, without ever holding more than a row of pixels.
+ *
+ * @param {string} filename: gray-level (or pbm) input
+ * @param {int} threshold_value: gray levels above it are object pixels
+ * @param {StreamingLabeler} labeler: receives the rows
+ * @return false (with a message) when the file cannot be read
+ */
+bool StreamLabelPgm(const std::string &filename, int threshold_value,
+                    StreamingLabeler *labeler);
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_STREAMING_LABELING_H_
@@ -0,0 +1,103 @@
+// Persistent worker threads sharing index ranges by work stealing.
+// To be used in Computer Vision class.
+
+#include "work_stealing_pool.h"
+#include "parallel.h"
+
+using namespace std;
+
+namespace ComputerVisionProjects {
+
+WorkStealingPool::WorkStealingPool(size_t num_threads)
+    : num_threads_{num_threads == 0 ? DefaultThreadCount() : num_threads},
+      ranges_{new TaskRange[num_threads_]} {
+  threads_.reserve(num_threads_ - 1);
+  for (size_t worker = 1; worker < num_threads_; ++worker)
+    threads_.emplace_back(&WorkStealingPool::WorkerLoop, this, worker);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (thread &worker : threads_) worker.join();
+}
+
+void WorkStealingPool::Run(size_t num_tasks,
+                           const function<void(size_t, size_t)> &task) {
+  if (num_tasks == 0) return;
+  {
+    lock_guard<mutex> lock(mutex_);
+    // Workers only look at the ranges after seeing the new generation
+    // under mutex_, so plain stores are enough here.
+    for (size_t worker = 0; worker < num_threads_; ++worker) {
+      ranges_[worker].begin = BandBegin(num_tasks, num_threads_, worker);
+      ranges_[worker].end = BandBegin(num_tasks, num_threads_, worker + 1);
+    }
+    task_ = &task;
+    busy_ = num_threads_ - 1;
+    ++generation_;
+  }
+  wake_.notify_all();
+  Drain(0);
+  unique_lock<mutex> lock(mutex_);
+  done_.wait(lock, [this] { return busy_ == 0; });
+  task_ = nullptr;
+}
+
+void WorkStealingPool::WorkerLoop(size_t worker) {
+  size_t seen = 0;
+  for (;;) {
+    {
+      unique_lock<mutex> lock(mutex_);
+      wake_.wait(lock, [this, seen] { return stop_ || generation_ != seen; });
+      if (stop_) return;
+      seen = generation_;
+    }
+    Drain(worker);
+    lock_guard<mutex> lock(mutex_);
+    if (--busy_ == 0) done_.notify_one();
+  }
+}
+
+void WorkStealingPool::Drain(size_t worker) {
+  size_t index;
+  do {
+    while (Pop(worker, &index)) (*task_)(worker, index);
+  } while (Steal(worker));
+}
+
+bool WorkStealingPool::Pop(size_t worker, size_t *index) {
+  TaskRange &range = ranges_[worker];
+  lock_guard<mutex> lock(range.mutex);
+  if (range.begin == range.end) return false;
+  *index = range.begin++;
+  return true;
+}
+
+// Moves the back half of the first non-empty range after worker's own
+// into worker's (empty) range. Returns false when every range is empty:
+// tasks still running are then all owned by the workers running them.
+bool WorkStealingPool::Steal(size_t worker) {
+  for (size_t offset = 1; offset < num_threads_; ++offset) {
+    TaskRange &victim = ranges_[(worker + offset) % num_threads_];
+    size_t begin, end;
+    {
+      lock_guard<mutex> lock(victim.mutex);
+      if (victim.begin == victim.end) continue;
+      begin = victim.begin + (victim.end - victim.begin) / 2;
+      end = victim.end;
+      victim.end = begin;
+    }
+    TaskRange &range = ranges_[worker];
+    lock_guard<mutex> lock(range.mutex);
+    range.begin = begin;
+    range.end = end;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace ComputerVisionProjects
@@ -0,0 +1,85 @@
+// Persistent worker threads sharing index ranges by work stealing.
+// To be used in Computer Vision class.
+
+#ifndef COMPUTER_VISION_WORK_STEALING_POOL_H_
+#define COMPUTER_VISION_WORK_STEALING_POOL_H_
+
+#include "parallel.h"
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ComputerVisionProjects {
+
+// Runs tasks 0..n-1 on a fixed set of workers. Each worker starts on its
+// own contiguous range of tasks and takes them from the front; a worker
+// that runs out steals the back half of the range of another one, so a
+// few slow tasks do not leave the other workers idle. Ranges are pairs of
+// indices, so scheduling allocates nothing.
+// Worker 0 is the thread calling Run( ); the others live as long as the
+// pool, so there is no thread start per batch.
+//
+// Example:
+//   WorkStealingPool pool(4);
+//   pool.Run(files.size(), [&](size_t worker, size_t task) {
+//     Process(files[task], &buffers[worker]);
+//   });
+class WorkStealingPool {
+ public:
+  // Zero threads means DefaultThreadCount( ).
+  explicit WorkStealingPool(size_t num_threads);
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  size_t num_threads() const { return num_threads_; }
+
+  /**
+   * Run( ) calls task(worker, index) once for every index in
+   * [0, num_tasks) and returns when all calls are done. Calls made by
+   * the same worker never overlap, so worker can select per-worker
+   * buffers.
+   *
+   * @param {size_t} num_tasks: number of tasks
+   * @param {function} task: called as task(worker, index)
+   */
+  void Run(size_t num_tasks,
+           const std::function<void(size_t, size_t)> &task);
+
+ private:
+  // Tasks [begin, end) still to run, owned by one worker. Kept on its
+  // own cache line so that workers popping their own ranges do not
+  // contend.
+  struct alignas(kCacheLineSize) TaskRange : CacheLineAligned {
+    std::mutex mutex;
+    size_t begin = 0;
+    size_t end = 0;
+  };
+
+  void WorkerLoop(size_t worker);
+  // Runs tasks of worker's range, then stolen ones, until none are left.
+  void Drain(size_t worker);
+  bool Pop(size_t worker, size_t *index);
+  bool Steal(size_t worker);
+
+  size_t num_threads_;
+  std::unique_ptr<TaskRange[]> ranges_;
+  std::vector<std::thread> threads_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  const std::function<void(size_t, size_t)> *task_ = nullptr;
+  size_t generation_ = 0;
+  size_t busy_ = 0;
+  bool stop_ = false;
+};
+
+}  // namespace ComputerVisionProjects
+
+#endif  // COMPUTER_VISION_WORK_STEALING_POOL_H_